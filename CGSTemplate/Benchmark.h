@@ -0,0 +1,649 @@
+#pragma once
+#include "ObjectManager.h"
+#include "InstanceRenderer.h"
+#include "Fxaa.h"
+#include "DynamicResolution.h"
+#include "GPUStreaming.h"
+#include "GLCompute.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace game {
+
+// Scene benchmarks, run with "--bench" on the command line instead of opening a window.
+// Timings exclude rasterization: no draw callbacks are installed, so renderAll measures
+// visibility, submission and queue sorting only.
+
+struct BenchResult {
+    double updateMs = 0.0;
+    double renderMs = 0.0;
+    double culledRenderMs = 0.0;  // With frustum culling (ObjectManager only)
+    int culled = 0;
+};
+
+// Average milliseconds per call of fn over a number of frames (after one warm-up call)
+template <typename F>
+inline double timeFrames(int frames, F&& fn) {
+    fn();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+// Spread cubes on a square grid centered in front of the camera, each spinning at its own speed
+inline void placeBenchObject(MaterialMesh& mesh, int i, int count) {
+    int side = (int)sqrtf((float)count);
+    mesh.setPosition((float)(i % side - side / 2) * 0.5f, (float)(i / side - side / 2) * 0.5f, 5.0f);
+    mesh.setScale(0.2f);
+    mesh.setRotationSpeed(10.0f + (float)(i % 7));
+}
+
+// The previous layout: one heap allocation per object, virtual update/render per element
+inline BenchResult benchPointerList(int count, int frames) {
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    std::vector<Object*> objects;
+    objects.reserve(count);
+    for (int i = 0; i < count; i++) {
+        MaterialMesh* mesh = new MaterialMesh(verts, inds);
+        placeBenchObject(*mesh, i, count);
+        objects.push_back(mesh);
+    }
+    
+    BenchResult r;
+    r.updateMs = timeFrames(frames, [&]() {
+        for (Object* obj : objects) {
+            obj->savePreviousTransform();
+            obj->update(1.0f / 60.0f);
+        }
+    });
+    r.renderMs = timeFrames(frames, [&]() {
+        g_RenderQueue.begin();
+        for (Object* obj : objects) {
+            if (obj->isVisible()) obj->render();
+        }
+        g_RenderQueue.flush();
+    });
+    
+    for (Object* obj : objects) delete obj;
+    return r;
+}
+
+inline BenchResult benchObjectManager(int count, int frames) {
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        placeBenchObject(*manager.getAs<MaterialMesh>(h), i, count);
+    }
+    
+    BenchResult r;
+    r.updateMs = timeFrames(frames, [&]() { manager.updateAll(1.0f / 60.0f); });
+    manager.setFrustumCulling(false);
+    r.renderMs = timeFrames(frames, [&]() { manager.renderAll(); });
+    manager.setFrustumCulling(true);
+    r.culledRenderMs = timeFrames(frames, [&]() { manager.renderAll(); });
+    r.culled = manager.getLastCulledObjects();
+    return r;
+}
+
+// Draw the same cube grid per object (one DrawTriangles per cube) and as one instanced
+// batch, rasterizing both on the CPU. The instanced path culls each instance's bounding
+// sphere, so per-object drawing is timed without and with that same test: culling and
+// instancing are reported separately.
+inline void benchInstancing(int count, int frames) {
+    MaterialMesh mesh(Mesh::createCubeVertices(), Mesh::createCubeIndices());
+    mesh.setUseTexture(false);
+    std::vector<InstanceTransform> instances(count);
+    for (int i = 0; i < count; i++) {
+        placeBenchObject(mesh, i, count);
+        instances[i].world = mesh.getWorldMatrix();
+        instances[i].color = 0xFF808080 | (unsigned int)(i * 2654435761u & 0x007F7F7F);
+    }
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    g_RenderCallbacks.drawInstanced = DrawInstanced;
+    
+    double perObjectMs = timeFrames(frames, [&]() {
+        clearColorBuffer(0xFF000000);
+        for (const InstanceTransform& inst : instances) {
+            SV_WorldMatrix = inst.world;
+            DrawTriangles(mesh.getVertices().data(), mesh.getIndices().data(), mesh.getIndices().size(),
+                          nullptr, 0, 0, inst.color);
+        }
+    });
+    const vec3& c = mesh.getBoundsCenter();
+    double culledMs = timeFrames(frames, [&]() {
+        clearColorBuffer(0xFF000000);
+        for (const InstanceTransform& inst : instances) {
+            vec4 center = matrixMultiplicationVec(inst.world, vec4{ c.x, c.y, c.z, 1.0f });
+            if (!sphereInViewFrustum({ center.x, center.y, center.z }, mesh.getBoundsRadius() * matrixMaxScale(inst.world))) continue;
+            SV_WorldMatrix = inst.world;
+            DrawTriangles(mesh.getVertices().data(), mesh.getIndices().data(), mesh.getIndices().size(),
+                          nullptr, 0, 0, inst.color);
+        }
+    });
+    double instancedMs = timeFrames(frames, [&]() {
+        clearColorBuffer(0xFF000000);
+        mesh.drawInstanced(instances.data(), instances.size());
+    });
+    
+    const InstanceRenderer::Stats& st = g_InstanceRenderer.getLastStats();
+    char line[256];
+    snprintf(line, sizeof(line), "%6d cubes  per-object %8.3f  culled per-object %8.3f  culled instanced %8.3f  (%d culled, %d vertex transforms)",
+             count, perObjectMs, culledMs, instancedMs, st.culledInstances, st.vertexTransforms);
+    std::cout << line << std::endl;
+    
+    VertexShader = nullptr;
+}
+
+// A wall close to the camera hiding a grid of cubes behind it, drawn through the
+// ObjectManager with and without the occlusion pass, rasterizing on the CPU
+inline void benchOcclusion(int count, int frames) {
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    ObjectHandle wall = manager.create<MaterialMesh>(verts, inds);
+    manager.getAs<MaterialMesh>(wall)->setPosition(0.0f, 0.0f, 2.0f);
+    manager.getAs<MaterialMesh>(wall)->setScale(6.0f, 4.0f, 0.2f);
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        MaterialMesh* mesh = manager.getAs<MaterialMesh>(h);
+        placeBenchObject(*mesh, i, count);
+        mesh->setPosition(mesh->getPosition().x * 0.2f, mesh->getPosition().y * 0.2f, 4.0f + (float)(i % 5));
+        mesh->setScale(0.1f);
+    }
+    manager.forEach([](Object& obj) { static_cast<MaterialMesh&>(obj).setUseTexture(false); });
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    
+    manager.setOcclusionCulling(false);
+    double plainMs = timeFrames(frames, [&]() {
+        clearColorBuffer(0xFF000000);
+        manager.renderAll();
+    });
+    manager.setOcclusionCulling(true);
+    double occludedMs = timeFrames(frames, [&]() {
+        clearColorBuffer(0xFF000000);
+        manager.renderAll();
+    });
+    
+    char line[256];
+    snprintf(line, sizeof(line), "%6d cubes behind a wall  %8.3f -> %8.3f  (%d occluded, %d occluder triangles)",
+             count, plainMs, occludedMs, manager.getLastOccludedObjects(), g_OcclusionBuffer.getOccluderTriangles());
+    std::cout << line << std::endl;
+    
+    g_RenderCallbacks.drawTrianglesCPU = nullptr;
+    VertexShader = nullptr;
+}
+
+// Overlapping textured cubes spread over four textures: the queue sorts by texture first,
+// so depth order is only partial and many pixels are shaded more than once. Drawn in a
+// single pass, with the depth pre-pass and through the visibility buffer, with the
+// overdraw counters on.
+inline void benchOpaqueShading(int count, int frames) {
+    const int TEX_SIZE = 64;
+    std::vector<std::vector<unsigned int>> textures(4, std::vector<unsigned int>(TEX_SIZE * TEX_SIZE));
+    for (int t = 0; t < 4; t++) {
+        for (int i = 0; i < TEX_SIZE * TEX_SIZE; i++) {
+            textures[t][i] = 0xFF000000 | (unsigned int)((i * 2654435761u + t * 40503u) & 0x00FFFFFF);
+        }
+    }
+    
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        MaterialMesh* mesh = manager.getAs<MaterialMesh>(h);
+        placeBenchObject(*mesh, i, count);
+        mesh->setPosition(mesh->getPosition().x * 0.3f, mesh->getPosition().y * 0.3f, 2.0f + (float)(i % 8) * 0.5f);
+        mesh->setScale(0.4f);
+        mesh->setTexture(textures[i % 4].data(), TEX_SIZE, TEX_SIZE);
+    }
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    g_RenderCallbacks.resolveVisibilityCPU = ResolveVisibilityBuffer;
+    EnableOverdrawCounters(true);
+    
+    const char* modeNames[] = { "single", "prepass", "visbuf" };
+    char line[256];
+    for (int mode = 0; mode < 3; mode++) {
+        g_DepthPrepass = mode == 1;
+        g_VisibilityBufferMode = mode == 2;
+        double ms = timeFrames(frames, [&]() {
+            clearColorBuffer(0xFF000000);
+            g_RenderStats.beginFrame();
+            manager.renderAll();
+        });
+        OverdrawStats od = ComputeOverdrawStats();
+        snprintf(line, sizeof(line), "%6d cubes  %-8s %8.3f  (%.2f depth complexity, %llu shaded, %.0f%% overwritten)",
+                 count, modeNames[mode], ms, od.meanDepthComplexity,
+                 (unsigned long long)g_RenderStats.pixelsShaded, od.wastedShadingPercent);
+        std::cout << line << std::endl;
+    }
+    
+    g_DepthPrepass = false;
+    g_VisibilityBufferMode = false;
+    EnableOverdrawCounters(false);
+    g_RenderCallbacks.drawTrianglesCPU = nullptr;
+    g_RenderCallbacks.resolveVisibilityCPU = nullptr;
+    VertexShader = nullptr;
+}
+
+// Untextured cubes under the sun and three point lights: flat lighting (one factor per
+// face), smooth lighting evaluated per vertex every frame, and smooth lighting baked once
+// for static meshes
+inline void benchLighting(int count, int frames) {
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        MaterialMesh* mesh = manager.getAs<MaterialMesh>(h);
+        placeBenchObject(*mesh, i, count);
+        mesh->setUseTexture(false);
+    }
+    
+    Light savedLights[MAX_LIGHTS];
+    std::copy(SV_Lights, SV_Lights + MAX_LIGHTS, savedLights);
+    int savedCount = SV_LightCount;
+    for (int i = 1; i < 4; i++) {
+        SV_Lights[i].type = LIGHT_POINT;
+        SV_Lights[i].position = { (float)(i - 2) * 2.0f, 1.0f, 4.0f };
+        SV_Lights[i].color = { 0.6f, 0.6f, 0.6f };
+        SV_Lights[i].range = 6.0f;
+    }
+    SV_LightCount = 4;
+    SV_LightsVersion++;
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    
+    const char* modeNames[] = { "flat", "smooth", "static" };
+    char line[256];
+    for (int mode = 0; mode < 3; mode++) {
+        g_SmoothLighting = mode != 0;
+        manager.forEach([&](Object& obj) { static_cast<MaterialMesh&>(obj).setStaticLighting(mode == 2); });
+        double ms = timeFrames(frames, [&]() {
+            clearColorBuffer(0xFF000000);
+            g_RenderStats.beginFrame();
+            manager.renderAll();
+        });
+        snprintf(line, sizeof(line), "%6d cubes  %-6s %8.3f  (%llu vertices lit, %llu baked)",
+                 count, modeNames[mode], ms, (unsigned long long)g_RenderStats.vertexLightings,
+                 (unsigned long long)g_RenderStats.vertexLightsBaked);
+        std::cout << line << std::endl;
+    }
+    
+    g_SmoothLighting = true;
+    std::copy(savedLights, savedLights + MAX_LIGHTS, SV_Lights);
+    SV_LightCount = savedCount;
+    SV_LightsVersion++;
+    g_RenderCallbacks.drawTrianglesCPU = nullptr;
+    VertexShader = nullptr;
+}
+
+// Textured cubes drawn without anti-aliasing, with 4x MSAA, with the FXAA post pass and
+// with both
+inline void benchAntialiasing(int count, int frames) {
+    const int TEX_SIZE = 64;
+    std::vector<unsigned int> texture(TEX_SIZE * TEX_SIZE);
+    for (int i = 0; i < TEX_SIZE * TEX_SIZE; i++) {
+        texture[i] = 0xFF000000 | (unsigned int)((i * 2654435761u) & 0x00FFFFFF);
+    }
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        MaterialMesh* mesh = manager.getAs<MaterialMesh>(h);
+        placeBenchObject(*mesh, i, count);
+        mesh->setRotation((float)i * 3.0f, (float)i * 7.0f, 0.0f);
+        mesh->setTexture(texture.data(), TEX_SIZE, TEX_SIZE);
+    }
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    g_RenderCallbacks.resolveMsaaCPU = ResolveMsaaBuffer;
+    
+    const char* modeNames[] = { "none", "msaa4x", "fxaa", "both" };
+    char line[256];
+    for (int mode = 0; mode < 4; mode++) {
+        g_MsaaMode = mode == 1 || mode == 3;
+        bool fxaa = mode >= 2;
+        double ms = timeFrames(frames, [&]() {
+            clearColorBuffer(0xFF000000);
+            g_RenderStats.beginFrame();
+            manager.renderAll();
+            if (fxaa) ApplyFxaa(SCREEN_ARRAY, RASTER_WIDTH, RASTER_HEIGHT);
+        });
+        snprintf(line, sizeof(line), "%6d cubes  %-6s %8.3f  (%llu MSAA edge px, %llu FXAA px)",
+                 count, modeNames[mode], ms, (unsigned long long)g_RenderStats.msaaEdgePixels,
+                 (unsigned long long)g_RenderStats.fxaaPixels);
+        std::cout << line << std::endl;
+    }
+    
+    g_MsaaMode = false;
+    g_RenderCallbacks.drawTrianglesCPU = nullptr;
+    g_RenderCallbacks.resolveMsaaCPU = nullptr;
+    VertexShader = nullptr;
+}
+
+// Fixed internal scales, upscale included; "upscale" times beginScene/endScene alone
+inline void benchDynamicResolution(int count, int frames) {
+    const int TEX_SIZE = 64;
+    std::vector<unsigned int> texture(TEX_SIZE * TEX_SIZE);
+    for (int i = 0; i < TEX_SIZE * TEX_SIZE; i++) {
+        texture[i] = 0xFF000000 | (unsigned int)((i * 2654435761u) & 0x00FFFFFF);
+    }
+    std::vector<vertex> verts = Mesh::createCubeVertices();
+    std::vector<unsigned int> inds = Mesh::createCubeIndices();
+    ObjectManager manager;
+    for (int i = 0; i < count; i++) {
+        ObjectHandle h = manager.create<MaterialMesh>(verts, inds);
+        MaterialMesh* mesh = manager.getAs<MaterialMesh>(h);
+        placeBenchObject(*mesh, i, count);
+        mesh->setRotation((float)i * 3.0f, (float)i * 7.0f, 0.0f);
+        mesh->setTexture(texture.data(), TEX_SIZE, TEX_SIZE);
+    }
+    
+    VertexShader = PS_WVP;
+    g_RenderCallbacks.drawTrianglesCPU = DrawTriangles;
+    bool wasEnabled = g_DynamicResolutionEnabled;
+    g_DynamicResolutionEnabled = true;
+    
+    char line[256];
+    for (float scale : { 1.0f, 0.75f, 0.5f }) {
+        g_DynamicResolution.setScale(scale);
+        double ms = timeFrames(frames, [&]() {
+            g_DynamicResolution.beginScene();
+            clearColorBuffer(0xFF000000);
+            g_RenderStats.beginFrame();
+            manager.renderAll();
+            g_DynamicResolution.endScene();
+        });
+        double upscaleMs = timeFrames(frames, [&]() {
+            g_DynamicResolution.beginScene();
+            g_DynamicResolution.endScene();
+        });
+        snprintf(line, sizeof(line), "%6d cubes  scale %.2f (%4dx%-4d) %8.3f  (upscale %.3f)",
+                 count, scale, g_DynamicResolution.getWidth(), g_DynamicResolution.getHeight(), ms, upscaleMs);
+        std::cout << line << std::endl;
+    }
+    
+    g_DynamicResolution.setScale(1.0f);
+    g_DynamicResolutionEnabled = wasEnabled;
+    g_RenderCallbacks.drawTrianglesCPU = nullptr;
+    VertexShader = nullptr;
+}
+
+// GPU rasterizer frames at each readback latency, as the CPU sees them: at 0 every dispatch
+// waits for its own copy, above 0 it reads an older frame the GPU has finished. Needs an
+// OpenGL 4.3 context and is skipped without one.
+inline void benchGpuReadback(int count, int frames) {
+    if (!g_GLCompute.isInitialized() && !GPU_Init()) {
+        std::cout << "   GPU rasterizer unavailable, skipped" << std::endl;
+        return;
+    }
+    
+    // Solid front-facing triangles scattered over the screen, 8 to 128 pixels across
+    std::vector<GPUVertex> triangles((size_t)count * 3);
+    unsigned int seed = 12345;
+    auto random = [&]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (int i = 0; i < count; i++) {
+        float x = random() * RASTER_WIDTH, y = random() * RASTER_HEIGHT;
+        float size = 4.0f + random() * 60.0f, z = random();
+        unsigned int color = 0xFF000000 | (unsigned int)(random() * 0x00FFFFFF);
+        triangles[i * 3 + 0] = { x, y - size, z, 1.0f, color, 0.0f, 0.0f, 0u };
+        triangles[i * 3 + 1] = { x - size, y + size, z, 1.0f, color, 0.0f, 0.0f, 0u };
+        triangles[i * 3 + 2] = { x + size, y + size, z, 1.0f, color, 0.0f, 0.0f, 0u };
+    }
+    
+    int savedLatency = g_GLCompute.getReadbackLatency();
+    char line[256];
+    for (int latency : { 0, 1, 2 }) {
+        g_GLCompute.setReadbackLatency(latency);
+        double ms = timeFrames(frames, [&]() {
+            GPU_BeginFrame();
+            g_GLCompute.addTriangles(triangles.data(), triangles.size(), false);
+            GPU_Dispatch(SCREEN_ARRAY);
+        });
+        snprintf(line, sizeof(line), "%6d triangles  readback latency %d  %8.3f", count, latency, ms);
+        std::cout << line << std::endl;
+    }
+    g_GLCompute.setReadbackLatency(savedLatency);
+}
+
+// Sample two packed textures at known UVs (corners, clamping, truncation) through
+// TextureTable::sample and sampleForVertex. Returns true on success.
+inline bool checkTextureTable() {
+    // 3x2 and 2x2 textures whose texels encode their own coordinates
+    const unsigned int first[6] = { 0x000, 0x001, 0x002,
+                                    0x010, 0x011, 0x012 };
+    const unsigned int second[4] = { 0x100, 0x101,
+                                     0x110, 0x111 };
+    TextureTable table;
+    bool ok = table.acquire(first, 3, 2) == 0 && table.acquire(second, 2, 2) == 1;
+    ok = ok && table.acquire(first, 3, 2) == 0;  // Already resident: same slot, no new texels
+    ok = ok && table.getTexels().size() == 10 && table.getSlots()[1].offset == 6;
+    
+    struct Case {
+        int slot;
+        float u, v;
+        unsigned int texel;
+    };
+    const Case cases[] = {
+        { 0, 0.0f, 0.0f, 0x000 }, { 0, 1.0f, 1.0f, 0x012 },
+        { 0, 0.49f, 0.0f, 0x000 }, { 0, 0.5f, 0.0f, 0x001 },    // u * (width - 1) truncated
+        { 0, 0.99f, 0.99f, 0x001 }, { 0, -3.0f, 7.0f, 0x010 },  // Clamped to [0, 1]
+        { 1, 0.0f, 1.0f, 0x110 }, { 1, 1.0f, 0.0f, 0x101 }, { 1, 2.0f, 2.0f, 0x111 },
+    };
+    for (const Case& c : cases) {
+        if (table.sample(c.slot, c.u, c.v) != c.texel) ok = false;
+        
+        // Vertices carry the slot 1-based
+        GPUVertex vert = {};
+        vert.texSlot = (unsigned int)c.slot + 1;
+        unsigned int texel = 0;
+        if (!table.sampleForVertex(vert, c.u, c.v, texel) || texel != c.texel) ok = false;
+    }
+    
+    // Untextured (slot 0) and unknown slots are not sampled
+    GPUVertex untextured = {}, unknown = {};
+    unknown.texSlot = 3;
+    unsigned int texel = 0;
+    if (table.sampleForVertex(untextured, 0.5f, 0.5f, texel) || table.sampleForVertex(unknown, 0.5f, 0.5f, texel)) ok = false;
+    return ok;
+}
+
+// Bin a known set of primitives on the GPU and with binPrimitives and compare: both
+// windings (back faces are never binned), off-screen and edge-straddling triangles, a tile
+// over MAX_PRIMS_PER_TILE, and lines including a degenerate one. Returns 1 when the bins
+// match, 0 when they differ and -1 without an OpenGL 4.3 context.
+inline int checkGpuBinning() {
+    if (!g_GLCompute.isInitialized() && !GPU_Init()) return -1;
+    
+    std::vector<GPUVertex> triangles, lines;
+    auto triangle = [&](float x0, float y0, float x1, float y1, float x2, float y2) {
+        triangles.push_back({ x0, y0, 0.5f, 1.0f, 0xFFFFFFFF, 0.0f, 0.0f, 0u });
+        triangles.push_back({ x1, y1, 0.5f, 1.0f, 0xFFFFFFFF, 0.0f, 0.0f, 0u });
+        triangles.push_back({ x2, y2, 0.5f, 1.0f, 0xFFFFFFFF, 0.0f, 0.0f, 0u });
+    };
+    auto line = [&](float x0, float y0, float x1, float y1) {
+        lines.push_back({ x0, y0, 0.5f, 1.0f, 0xFFFFFFFF, 0.0f, 0.0f, 0u });
+        lines.push_back({ x1, y1, 0.5f, 1.0f, 0xFFFFFFFF, 0.0f, 0.0f, 0u });
+    };
+    unsigned int seed = 777;
+    auto random = [&]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) * (1.0f / 16777216.0f);
+    };
+    float w = (float)RASTER_WIDTH, h = (float)RASTER_HEIGHT;
+    for (int i = 0; i < 2000; i++) {
+        // Scattered over and past the screen, half of them wound the other way
+        float x = random() * (w + 200.0f) - 100.0f, y = random() * (h + 200.0f) - 100.0f;
+        float size = 1.0f + random() * 80.0f;
+        if (i & 1) triangle(x, y - size, x - size, y + size, x + size, y + size);
+        else triangle(x, y - size, x + size, y + size, x - size, y + size);
+    }
+    for (int i = 0; i < MAX_PRIMS_PER_TILE + 50; i++) {
+        triangle(20.0f, 20.0f - 3.0f, 20.0f - 3.0f, 20.0f + 3.0f, 20.0f + 3.0f, 20.0f + 3.0f);
+    }
+    triangle(15.5f, 15.5f, 15.6f, 15.9f, 15.9f, 15.9f);  // Covers no pixel center
+    for (int i = 0; i < 200; i++) {
+        line(random() * w, random() * h, random() * w, random() * h);
+    }
+    line(40.0f, 40.0f, 40.01f, 40.01f);
+    line(-5.0f, 8.0f, w + 5.0f, 8.0f);
+    
+    GPU_BeginFrame();
+    g_GLCompute.addTriangles(triangles.data(), triangles.size(), false);
+    for (size_t i = 0; i < lines.size(); i += 2) {
+        g_GLCompute.addLine(lines[i].x, lines[i].y, lines[i].z, lines[i].color,
+                            lines[i + 1].x, lines[i + 1].y, lines[i + 1].z, lines[i + 1].color);
+    }
+    GPU_Dispatch(SCREEN_ARRAY);
+    
+    TileBins gpu, cpu;
+    if (!g_GLCompute.readBins(gpu)) return -1;
+    binPrimitives(triangles.data(), (int)(triangles.size() / 3), lines.data(), (int)(lines.size() / 2),
+                  RASTER_WIDTH, RASTER_HEIGHT, MAX_PRIMS_PER_TILE, cpu);
+    return sameBins(gpu, cpu) ? 1 : 0;
+}
+
+// Drive GLCompute's upload and readback rings with simulated fences and check that no
+// range is handed out while the GPU may still read it, that a lagging GPU causes waits
+// instead, and that readback presents the frame `latency` behind. Returns true on success.
+inline bool checkStreamingRings() {
+    bool ok = true;
+    for (bool gpuKeepsUp : { true, false }) {
+        SimulatedFences gpu;
+        StreamRing ring(gpu.ops());
+        ring.reset(4096, 256);
+        struct Submitted { size_t begin, end, fence; };
+        std::vector<Submitted> submitted;
+        for (int frame = 0; frame < 200; frame++) {
+            size_t bytes = 300 + (size_t)(frame * 97) % 1200;
+            size_t offset = 0;
+            if (!ring.allocate(bytes, offset)) {
+                ok = false;
+                break;
+            }
+            for (const Submitted& s : submitted) {
+                // An overlapping older range must have been retired by the GPU
+                if (s.begin < offset + bytes && offset < s.end && s.fence > gpu.completed) ok = false;
+            }
+            ring.submit();
+            submitted.push_back({ offset, offset + bytes, gpu.issued });
+            if (gpuKeepsUp) gpu.completeAll();
+        }
+        ring.drain();
+        if ((gpu.stalls == 0) != gpuKeepsUp) ok = false;
+        if (gpu.released != (int)gpu.issued) ok = false;
+    }
+    
+    for (int latency : { 0, 1, 2 }) {
+        SimulatedFences gpu;
+        ReadbackRing readback(gpu.ops(), latency);
+        for (int frame = 0; frame < 50; frame++) {
+            int written = readback.writeSlot();
+            readback.submitWrite();
+            if (frame >= latency) {
+                // The GPU finishes each copy within `latency` frames
+                gpu.complete(gpu.issued - latency);
+                int expected = (written + readback.getSlotCount() - latency) % readback.getSlotCount();
+                if (readback.resolve() != expected) ok = false;
+            } else {
+                readback.resolve();
+            }
+        }
+        // Only the very first frame may wait on a copy that is still in flight
+        if (gpu.stalls > (latency > 0 ? 1 : 0)) ok = false;
+        readback.drain();
+        if (gpu.released != (int)gpu.issued) ok = false;
+    }
+    return ok;
+}
+
+// Returns the process exit code
+inline int RunBenchmarks() {
+    // Camera at the origin looking down +Z; no draw callbacks so nothing is rasterized
+    SV_ViewMatrix = MatrixIdentity();
+    SV_ProjectionMatrix = projectionMatrixMath(90.0f, (float)RASTER_HEIGHT / RASTER_WIDTH, 10, 0.1f);
+    RenderCallbacks savedCallbacks = g_RenderCallbacks;
+    g_RenderCallbacks = RenderCallbacks();
+    
+    const int counts[] = { 1000, 10000, 50000 };
+    const int frames = 20;
+    std::cout << "Object storage benchmark (" << frames << " frames, ms per frame, pointer list -> ObjectManager)" << std::endl;
+    for (int count : counts) {
+        BenchResult before = benchPointerList(count, frames);
+        BenchResult after = benchObjectManager(count, frames);
+        
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "%6d objects  update %7.3f -> %7.3f  render %7.3f -> %7.3f  culled render %7.3f (%d culled)",
+                 count, before.updateMs, after.updateMs, before.renderMs, after.renderMs,
+                 after.culledRenderMs, after.culled);
+        std::cout << line << std::endl;
+    }
+    
+    
+    std::cout << "Instanced drawing (CPU raster, ms per frame)" << std::endl;
+    for (int count : { 1000, 10000 }) {
+        benchInstancing(count, 5);
+    }
+    
+    std::cout << "Occlusion culling (CPU raster, ms per frame)" << std::endl;
+    for (int count : { 1000, 10000 }) {
+        benchOcclusion(count, 5);
+    }
+    
+    std::cout << "Opaque shading modes (CPU raster, ms per frame)" << std::endl;
+    for (int count : { 100, 1000 }) {
+        benchOpaqueShading(count, 5);
+    }
+    
+    std::cout << "Lighting (CPU raster, 4 lights, ms per frame)" << std::endl;
+    for (int count : { 1000, 10000 }) {
+        benchLighting(count, 5);
+    }
+    
+    std::cout << "Anti-aliasing (CPU raster, ms per frame)" << std::endl;
+    for (int count : { 100, 1000 }) {
+        benchAntialiasing(count, 5);
+    }
+    
+    std::cout << "Dynamic resolution (CPU raster, ms per frame)" << std::endl;
+    for (int count : { 100, 1000 }) {
+        benchDynamicResolution(count, 5);
+    }
+    
+    std::cout << "GPU readback (compute rasterizer, CPU ms per frame)" << std::endl;
+    for (int count : { 1000, 10000 }) {
+        benchGpuReadback(count, 30);
+    }
+    
+    g_RenderCallbacks = savedCallbacks;
+    
+    bool streamingOk = checkStreamingRings();
+    std::cout << "GPU streaming rings (simulated fences): " << (streamingOk ? "ok" : "FAILED") << std::endl;
+    bool textureTableOk = checkTextureTable();
+    std::cout << "GPU texture table (CPU sample at known UVs): " << (textureTableOk ? "ok" : "FAILED") << std::endl;
+    int binning = checkGpuBinning();
+    std::cout << "GPU tile binning (binning.comp vs binPrimitives): "
+              << (binning > 0 ? "ok" : binning < 0 ? "skipped, no GPU" : "FAILED") << std::endl;
+    return streamingOk && textureTableOk && binning != 0 ? 0 : 1;
+}
+
+} // namespace game
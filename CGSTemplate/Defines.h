@@ -8,9 +8,13 @@ inline int RASTER_WIDTH = 1920;
 inline int RASTER_HEIGHT = 1080;
 inline int NUM_PIXELS = RASTER_HEIGHT * RASTER_WIDTH;
 
+// Entries in the FIFO post-transform vertex cache (DrawTriangles, MeshOptimize.h)
+constexpr int VERTEX_CACHE_SIZE = 16;
+
 // Dynamic screen buffers (allocated at runtime)
 inline unsigned int* SCREEN_ARRAY = nullptr;
 inline float* DEPTH_ARRAY = nullptr;
+inline unsigned int* OVERDRAW_ARRAY = nullptr;  // Optional per-pixel counters (see Overdraw.h)
 
 // Initialize screen buffers to desktop resolution
 inline void InitScreenBuffers() {
@@ -24,8 +28,10 @@ inline void InitScreenBuffers() {
 inline void FreeScreenBuffers() {
     delete[] SCREEN_ARRAY;
     delete[] DEPTH_ARRAY;
+    delete[] OVERDRAW_ARRAY;
     SCREEN_ARRAY = nullptr;
     DEPTH_ARRAY = nullptr;
+    OVERDRAW_ARRAY = nullptr;
 }
 
 #define SWAP_BGRA_TO_ARGB(color) ( ((color & 0xFF000000) >> 24) | ((color & 0x00FF0000) >> 8) | ((color & 0x0000FF00) << 8) | ((color & 0x000000FF) << 24) )
@@ -67,6 +73,7 @@ struct vertex
 	unsigned int color;
 	float u;
 	float v;
+	vec3 normal = { 0.0f, 0.0f, 0.0f };  // Object-space unit normal (zero: none, lit per face)
 
 	vertex() {};
 	vertex(vec4 pos, unsigned int color, float u = 0.0f, float v = 0.0f)
@@ -78,6 +85,11 @@ struct vertex
 	}
 };
 
+inline bool hasNormal(const vertex& v)
+{
+	return v.normal.x != 0.0f || v.normal.y != 0.0f || v.normal.z != 0.0f;
+}
+
 
 struct matrix3x3
 {
@@ -0,0 +1,39 @@
+#pragma once
+#include "Profiler.h"
+
+// ========== DEPTH PRE-PASS ==========
+// Opaque geometry is rasterized twice: first depth only (no UVs, texture or lighting),
+// then shaded with an equal depth test, so each pixel is shaded once by the fragment
+// that ends up visible. Costs a second scan conversion of every triangle; pays off
+// where depth complexity (see Overdraw.h) is high and shading is expensive.
+
+enum class RasterPass {
+    Single,     // Normal depth test and write
+    DepthOnly,  // Opaque draws write depth only; everything else is skipped
+    DepthEqual, // Opaque draws shade only where their depth matches the buffer
+    NonOpaque   // Only the draws the visibility buffer left out (after its resolve)
+};
+
+inline bool g_DepthPrepass = false;                   // Two-pass mode (CPU rasterizer)
+inline RasterPass g_RasterPass = RasterPass::Single;  // Pass currently being drawn
+
+// Issue a set of draws once, or twice around the pre-pass when it is enabled
+template <typename F>
+inline void DrawWithDepthPrepass(F&& draw) {
+    if (!g_DepthPrepass) {
+        draw();
+        return;
+    }
+    PROFILE_SCOPE("DrawWithDepthPrepass");
+    {
+        PROFILE_SCOPE("DepthPrepass::depthOnly");
+        g_RasterPass = RasterPass::DepthOnly;
+        draw();
+    }
+    {
+        PROFILE_SCOPE("DepthPrepass::shade");
+        g_RasterPass = RasterPass::DepthEqual;
+        draw();
+    }
+    g_RasterPass = RasterPass::Single;
+}
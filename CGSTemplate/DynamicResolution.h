@@ -0,0 +1,325 @@
+#pragma once
+#include "Defines.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// ========== DYNAMIC RESOLUTION ==========
+// The 3D pass renders into an internal buffer whose size follows the frame time, and is
+// then upscaled (bilinear, optionally sharpened first) into the present buffer; the UI is
+// drawn afterwards at native resolution. Between beginScene and endScene the raster
+// globals (SCREEN_ARRAY, DEPTH_ARRAY, RASTER_WIDTH/HEIGHT, NUM_PIXELS) describe the
+// internal buffer, so every CPU draw path works unchanged. At full scale nothing is
+// redirected and the upscale is skipped.
+//
+// The controller models the frame as a scene part that goes with the internal area plus
+// a fixed part (HUD, present, ...) and, below full scale, the upscale, which costs per
+// native pixel. A lower scale can therefore be slower than full scale; a step down that
+// doesn't make the frame faster is undone and not retried for a while.
+//
+//   g_DynamicResolution.beginScene();
+//   clearColorBuffer(...); draw the scene ...
+//   g_DynamicResolution.endScene();          // SCREEN_ARRAY is native again
+//   draw the HUD ...
+//   g_DynamicResolution.update(frameWorkMs); // picks the next frame's scale
+
+inline bool g_DynamicResolutionEnabled = false;  // Toggled with F8
+inline bool g_DynamicResolutionSharpen = false;  // Sharpen the internal image before upscaling
+
+constexpr double DYNRES_TARGET_MS = 1000.0 / 60.0;  // Default frame budget
+constexpr float DYNRES_SHARPNESS = 0.5f;            // 0 = plain bilinear, 1 = strong
+
+class DynamicResolution {
+public:
+    static constexpr float MIN_SCALE = 0.5f;    // Of the native width and height
+    static constexpr float SCALE_STEP = 0.05f;  // Scales are multiples of this
+    static constexpr double HEADROOM = 0.9;     // Aim below the target so noise doesn't cross it
+    static constexpr double SMOOTHING = 0.25;   // Weight of the newest frame in the average
+    static constexpr int SETTLE_FRAMES = 8;     // Frames to wait after a change before the next
+    static constexpr int BLOCK_FRAMES = 600;    // Frames a failed step down holds the scale floor
+    
+    void setTargetMs(double ms) { targetMs = ms; }
+    double getTargetMs() const { return targetMs; }
+    
+    // Scale of the next scene (1 while disabled)
+    float getScale() const { return g_DynamicResolutionEnabled ? scale : 1.0f; }
+    // Force a scale (benchmarks; update() takes over again on its next change)
+    void setScale(float s) {
+        scale = (std::min)((std::max)(s, MIN_SCALE), 1.0f);
+        dropFromScale = 0.0f;
+    }
+    
+    // Size of the last scene's internal buffer
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    double getSmoothedMs() const { return smoothedMs; }
+    
+    // Point the raster globals at the internal buffers, sized for this frame's scale
+    void beginScene() {
+        sceneStart = std::chrono::steady_clock::now();
+        nativeWidth = RASTER_WIDTH;
+        nativeHeight = RASTER_HEIGHT;
+        nativeScreen = SCREEN_ARRAY;
+        nativeDepth = DEPTH_ARRAY;
+        
+        float s = getScale();
+        width = (std::max)(1, (int)lroundf(nativeWidth * s));
+        height = (std::max)(1, (int)lroundf(nativeHeight * s));
+        redirected = width != nativeWidth || height != nativeHeight;
+        if (!redirected) return;
+        
+        size_t pixels = (size_t)width * height;
+        color.resize(pixels);
+        depth.resize(pixels);
+        RASTER_WIDTH = width;
+        RASTER_HEIGHT = height;
+        NUM_PIXELS = width * height;
+        SCREEN_ARRAY = color.data();
+        DEPTH_ARRAY = depth.data();
+    }
+    
+    // Restore the native buffers and upscale the scene into SCREEN_ARRAY
+    void endScene() {
+        std::chrono::steady_clock::time_point sceneEnd = std::chrono::steady_clock::now();
+        lastSceneMs = std::chrono::duration<double, std::milli>(sceneEnd - sceneStart).count();
+        if (!redirected) return;
+        redirected = false;
+        RASTER_WIDTH = nativeWidth;
+        RASTER_HEIGHT = nativeHeight;
+        NUM_PIXELS = nativeWidth * nativeHeight;
+        SCREEN_ARRAY = nativeScreen;
+        DEPTH_ARRAY = nativeDepth;
+        upscale(color.data(), width, height, SCREEN_ARRAY, nativeWidth, nativeHeight);
+        double upscaleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sceneEnd).count();
+        smoothedUpscaleMs = smoothedUpscaleMs > 0.0 ? smoothedUpscaleMs + (upscaleMs - smoothedUpscaleMs) * SMOOTHING : upscaleMs;
+    }
+    
+    // Feed the time the frame spent working (excluding pacing waits) and pick the next scale
+    void update(double frameMs) {
+        if (!g_DynamicResolutionEnabled) {
+            scale = 1.0f;
+            smoothedMs = smoothedSceneMs = 0.0;
+            settle = 0;
+            dropFromScale = 0.0f;
+            return;
+        }
+        smoothedMs = smoothedMs > 0.0 ? smoothedMs + (frameMs - smoothedMs) * SMOOTHING : frameMs;
+        smoothedSceneMs = smoothedSceneMs > 0.0 ? smoothedSceneMs + (lastSceneMs - smoothedSceneMs) * SMOOTHING : lastSceneMs;
+        if (blockFrames > 0) blockFrames--;
+        if (settle > 0) {
+            settle--;
+            return;
+        }
+        
+        // The last step down didn't make the frame faster: go back and stay at or above
+        // that scale for a while
+        if (dropFromScale > 0.0f) {
+            float from = dropFromScale;
+            dropFromScale = 0.0f;
+            if (smoothedMs >= dropFromMs) {
+                floorScale = from;
+                blockFrames = BLOCK_FRAMES;
+                changeScale(from);
+                return;
+            }
+        }
+        
+        // Largest scale predicted to fit the budget, or the fastest one if none does. Drops
+        // go straight there, growth a step at a time.
+        const int fullSteps = (int)lroundf(1.0f / SCALE_STEP);
+        int highest = (std::min)((int)lroundf(scale / SCALE_STEP) + 1, fullSteps);
+        int lowest = (int)lroundf((blockFrames > 0 ? floorScale : MIN_SCALE) / SCALE_STEP);
+        float next = scale;
+        double nextMs = predictMs(scale);
+        for (int step = highest; step >= lowest; step--) {
+            float s = (std::min)(step * SCALE_STEP, 1.0f);
+            double ms = predictMs(s);
+            if (ms <= targetMs * HEADROOM) {
+                next = s;
+                break;
+            }
+            if (ms < nextMs) {
+                next = s;
+                nextMs = ms;
+            }
+        }
+        if (fabsf(next - scale) < SCALE_STEP * 0.5f) return;
+        if (next < scale) {
+            dropFromScale = scale;
+            dropFromMs = smoothedMs;
+        }
+        changeScale(next);
+    }
+
+private:
+    static constexpr int ROWS_PER_BAND = 16;
+    
+    // Bilinear tap: two neighboring source indices and the weight of the second (0..256)
+    struct Tap {
+        int first;
+        int second;
+        unsigned int weight;
+    };
+    
+    double targetMs = DYNRES_TARGET_MS;
+    float scale = 1.0f;
+    double smoothedMs = 0.0;         // Whole frame
+    double smoothedSceneMs = 0.0;    // beginScene to endScene
+    double smoothedUpscaleMs = 0.0;  // Last known upscale cost (kept while at full scale)
+    double lastSceneMs = 0.0;
+    std::chrono::steady_clock::time_point sceneStart;
+    int settle = 0;
+    float dropFromScale = 0.0f;      // Scale before the last step down, until it is judged
+    double dropFromMs = 0.0;         // Frame time before that step
+    float floorScale = MIN_SCALE;    // Lowest scale allowed while blockFrames > 0
+    int blockFrames = 0;
+    
+    int width = 0;
+    int height = 0;
+    bool redirected = false;
+    std::vector<unsigned int> color;
+    std::vector<float> depth;
+    std::vector<unsigned int> sharpened;
+    std::vector<Tap> columns;
+    std::vector<Tap> rows;
+    std::vector<unsigned int> resampled;  // Two resampled source rows per band
+    
+    int nativeWidth = 0;
+    int nativeHeight = 0;
+    unsigned int* nativeScreen = nullptr;
+    float* nativeDepth = nullptr;
+    
+    // Frame time expected at scale s: the scene goes with area, the upscale is paid below
+    // full scale, the rest stays as measured
+    double predictMs(float s) const {
+        double upscaleMs = scale < 1.0f ? smoothedUpscaleMs : 0.0;
+        double fixedMs = (std::max)(smoothedMs - smoothedSceneMs - upscaleMs, 0.0);
+        double ratio = (double)s / scale;
+        return fixedMs + smoothedSceneMs * ratio * ratio + (s < 1.0f ? smoothedUpscaleMs : 0.0);
+    }
+    
+    // Switch scales and restart the averages, so the next decision sees only the new scale
+    void changeScale(float s) {
+        scale = s;
+        settle = SETTLE_FRAMES;
+        smoothedMs = smoothedSceneMs = 0.0;
+    }
+    
+    // Source taps for every destination column (or row), pixel centers aligned
+    static void buildTaps(std::vector<Tap>& taps, int sourceSize, int destSize) {
+        taps.resize(destSize);
+        float ratio = (float)sourceSize / destSize;
+        for (int d = 0; d < destSize; d++) {
+            float pos = (std::max)((d + 0.5f) * ratio - 0.5f, 0.0f);
+            int first = (std::min)((int)pos, sourceSize - 1);
+            taps[d].first = first;
+            taps[d].second = (std::min)(first + 1, sourceSize - 1);
+            taps[d].weight = (unsigned int)((pos - first) * 256.0f);
+        }
+    }
+    
+    // a..b by weight/256
+    static unsigned int lerpColor(unsigned int a, unsigned int b, unsigned int weight) {
+        unsigned int inverse = 256 - weight;
+        unsigned int rb = (((a & 0x00FF00FF) * inverse + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+        unsigned int g = (((a & 0x0000FF00) * inverse + (b & 0x0000FF00) * weight) >> 8) & 0x0000FF00;
+        return 0xFF000000 | rb | g;
+    }
+    
+    // Unsharp mask over the four direct neighbors, at the internal resolution (before the
+    // bilinear filter softens the image)
+    static unsigned int sharpenChannel(unsigned int c, unsigned int n, unsigned int s, unsigned int w,
+                                       unsigned int e, int shift, int amount) {
+        int center = (c >> shift) & 0xFF;
+        int around = ((n >> shift) & 0xFF) + ((s >> shift) & 0xFF) + ((w >> shift) & 0xFF) + ((e >> shift) & 0xFF);
+        int value = center + (((center * 4 - around) * amount) >> 8);
+        return (unsigned int)(std::min)((std::max)(value, 0), 255) << shift;
+    }
+    
+    static void sharpenRow(const unsigned int* source, unsigned int* dest, int w, int h, int y) {
+        const unsigned int* rowN = source + (size_t)(std::max)(y - 1, 0) * w;
+        const unsigned int* rowM = source + (size_t)y * w;
+        const unsigned int* rowS = source + (size_t)(std::min)(y + 1, h - 1) * w;
+        const int amount = (int)(DYNRES_SHARPNESS * 64.0f);  // Per neighbor, in 1/256
+        unsigned int* out = dest + (size_t)y * w;
+        for (int x = 0; x < w; x++) {
+            unsigned int c = rowM[x], n = rowN[x], s = rowS[x];
+            unsigned int west = rowM[x > 0 ? x - 1 : 0];
+            unsigned int east = rowM[x < w - 1 ? x + 1 : w - 1];
+            out[x] = 0xFF000000 | sharpenChannel(c, n, s, west, east, 16, amount) |
+                     sharpenChannel(c, n, s, west, east, 8, amount) | sharpenChannel(c, n, s, west, east, 0, amount);
+        }
+    }
+    
+    // One source row resampled to the destination width
+    static void resampleRow(const unsigned int* source, const Tap* taps, unsigned int* out, int destWidth) {
+        for (int x = 0; x < destWidth; x++) {
+            out[x] = lerpColor(source[taps[x].first], source[taps[x].second], taps[x].weight);
+        }
+    }
+    
+    // Separable: each band resamples the source rows it needs horizontally once, keeping
+    // the last two, and blends those vertically per destination row
+    void upscale(const unsigned int* source, int sourceWidth, int sourceHeight,
+                 unsigned int* dest, int destWidth, int destHeight) {
+        PROFILE_SCOPE("DynamicResolution::upscale");
+        StageTimer stage("Upscale");
+        
+        if (g_DynamicResolutionSharpen && DYNRES_SHARPNESS > 0.0f) {
+            sharpened.resize((size_t)sourceWidth * sourceHeight);
+            unsigned int* out = sharpened.data();
+            int sourceBands = (sourceHeight + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+            g_ThreadPool.parallelFor(sourceBands, [=](int band) {
+                int end = (std::min)((band + 1) * ROWS_PER_BAND, sourceHeight);
+                for (int y = band * ROWS_PER_BAND; y < end; y++) {
+                    sharpenRow(source, out, sourceWidth, sourceHeight, y);
+                }
+            });
+            source = out;
+        }
+        
+        buildTaps(columns, sourceWidth, destWidth);
+        buildTaps(rows, sourceHeight, destHeight);
+        const Tap* columnTaps = columns.data();
+        const Tap* rowTaps = rows.data();
+        int bands = (destHeight + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+        resampled.resize((size_t)bands * 2 * destWidth);
+        unsigned int* scratch = resampled.data();
+        g_ThreadPool.parallelFor(bands, [=](int band) {
+            unsigned int* upper = scratch + (size_t)band * 2 * destWidth;
+            unsigned int* lower = upper + destWidth;
+            int upperRow = -1, lowerRow = -1;
+            int end = (std::min)((band + 1) * ROWS_PER_BAND, destHeight);
+            for (int y = band * ROWS_PER_BAND; y < end; y++) {
+                const Tap& tap = rowTaps[y];
+                if (tap.first == lowerRow) {
+                    std::swap(upper, lower);
+                    std::swap(upperRow, lowerRow);
+                }
+                if (tap.first != upperRow) {
+                    resampleRow(source + (size_t)tap.first * sourceWidth, columnTaps, upper, destWidth);
+                    upperRow = tap.first;
+                }
+                unsigned int* out = dest + (size_t)y * destWidth;
+                if (tap.weight == 0) {
+                    std::copy(upper, upper + destWidth, out);
+                    continue;
+                }
+                if (tap.second != lowerRow) {
+                    resampleRow(source + (size_t)tap.second * sourceWidth, columnTaps, lower, destWidth);
+                    lowerRow = tap.second;
+                }
+                for (int x = 0; x < destWidth; x++) {
+                    out[x] = lerpColor(upper[x], lower[x], tap.weight);
+                }
+            }
+        });
+    }
+};
+
+// Global instance (internal buffers persist between frames)
+inline DynamicResolution g_DynamicResolution;
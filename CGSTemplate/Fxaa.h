@@ -0,0 +1,223 @@
+#pragma once
+#include "Defines.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FXAA_SSE2 1
+#endif
+
+// ========== FXAA ==========
+// Post-process anti-aliasing over a finished frame, after FXAA 3.11 (quality preset):
+// find pixels with high local luma contrast, decide whether the edge through them runs
+// horizontally or vertically, walk along it to its ends, and blend each pixel with its
+// neighbor across the edge by how far it sits from the nearer end. Costs one luma pass
+// plus work on edge pixels only, and needs no extra geometry work (compare MSAA, Msaa.h).
+
+inline bool g_FxaaEnabled = false;
+
+constexpr float FXAA_EDGE_THRESHOLD = 0.166f;      // Minimum contrast, relative to the brightest neighbor
+constexpr float FXAA_EDGE_THRESHOLD_MIN = 0.0833f; // ... and absolute (leaves dark noise alone)
+constexpr float FXAA_SUBPIXEL = 0.75f;             // Strength of the blur on single-pixel detail
+constexpr int FXAA_SEARCH_STEPS = 12;              // Pixels walked each way along an edge
+
+class FxaaPass {
+public:
+    // Anti-alias `pixels` in place. Both passes run over bands of rows on the thread pool.
+    void apply(unsigned int* pixels, int width, int height) {
+        PROFILE_SCOPE("FxaaPass::apply");
+        StageTimer stage("FXAA");
+        size_t count = (size_t)width * height;
+        source.resize(count);
+        luma.resize(count);
+        int bands = (height + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+        
+        // Copy the frame and compute its luma (four pixels per step with SSE2; the scalar
+        // loop does the tail with the same operations, so both give identical luma)
+        unsigned int* sourceData = source.data();
+        float* lumaData = luma.data();
+        g_ThreadPool.parallelFor(bands, [=](int band) {
+            size_t i = (size_t)band * ROWS_PER_BAND * width;
+            size_t end = (size_t)(std::min)((band + 1) * ROWS_PER_BAND, height) * width;
+            
+#ifdef FXAA_SSE2
+            const __m128i channel = _mm_set1_epi32(0xFF);
+            const __m128 weightR = _mm_set1_ps(0.299f), weightG = _mm_set1_ps(0.587f), weightB = _mm_set1_ps(0.114f);
+            const __m128 normalize = _mm_set1_ps(1.0f / 255.0f);
+            for (; i + 4 <= end; i += 4) {
+                __m128i c = _mm_loadu_si128((const __m128i*)(pixels + i));
+                _mm_storeu_si128((__m128i*)(sourceData + i), c);
+                __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), channel));
+                __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), channel));
+                __m128 b = _mm_cvtepi32_ps(_mm_and_si128(c, channel));
+                __m128 l = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, weightR), _mm_mul_ps(g, weightG)), _mm_mul_ps(b, weightB));
+                _mm_storeu_ps(lumaData + i, _mm_mul_ps(l, normalize));
+            }
+#endif
+            
+            for (; i < end; i++) {
+                unsigned int c = pixels[i];
+                sourceData[i] = c;
+                lumaData[i] = (((c >> 16) & 0xFF) * 0.299f + ((c >> 8) & 0xFF) * 0.587f + (c & 0xFF) * 0.114f) * (1.0f / 255.0f);
+            }
+        });
+        
+        std::vector<unsigned int> blended(bands, 0);
+        g_ThreadPool.parallelFor(bands, [&](int band) {
+            int end = (std::min)((band + 1) * ROWS_PER_BAND, height);
+            for (int y = band * ROWS_PER_BAND; y < end; y++) {
+                blended[band] += filterRow(pixels, width, height, y);
+            }
+        });
+        for (unsigned int n : blended) g_RenderStats.fxaaPixels += n;
+    }
+
+private:
+    static constexpr int ROWS_PER_BAND = 16;
+    
+    std::vector<unsigned int> source;  // Unfiltered copy of the frame
+    std::vector<float> luma;           // 0..1 per pixel
+    
+    float lumaAt(int x, int y, int width, int height) const {
+        x = (std::max)(0, (std::min)(x, width - 1));
+        y = (std::max)(0, (std::min)(y, height - 1));
+        return luma[(size_t)y * width + x];
+    }
+    
+    unsigned int colorAt(int x, int y, int width, int height) const {
+        x = (std::max)(0, (std::min)(x, width - 1));
+        y = (std::max)(0, (std::min)(y, height - 1));
+        return source[(size_t)y * width + x];
+    }
+    
+    // a..b by t in [0, 1]
+    static unsigned int lerpColor(unsigned int a, unsigned int b, float t) {
+        unsigned int w = (unsigned int)(t * 256.0f);
+        unsigned int iw = 256 - w;
+        unsigned int rb = (((a & 0x00FF00FF) * iw + (b & 0x00FF00FF) * w) >> 8) & 0x00FF00FF;
+        unsigned int g = (((a & 0x0000FF00) * iw + (b & 0x0000FF00) * w) >> 8) & 0x0000FF00;
+        return 0xFF000000 | rb | g;
+    }
+    
+    // Filter one row; returns the number of pixels blended
+    unsigned int filterRow(unsigned int* pixels, int width, int height, int y) const {
+        unsigned int count = 0;
+        // Most pixels fail the contrast test, so it reads the three rows directly
+        const float* rowN = &luma[(size_t)(std::max)(y - 1, 0) * width];
+        const float* rowM = &luma[(size_t)y * width];
+        const float* rowS = &luma[(size_t)(std::min)(y + 1, height - 1) * width];
+        int x = 0;
+        
+#ifdef FXAA_SSE2
+        // Contrast test four pixels at a time (x - 1 and x + 4 stay inside the row); only the
+        // pixels that pass go through filterPixel, which repeats the test exactly
+        const __m128 threshold = _mm_set1_ps(FXAA_EDGE_THRESHOLD);
+        const __m128 thresholdMin = _mm_set1_ps(FXAA_EDGE_THRESHOLD_MIN);
+        if (width >= 6) {
+            count += filterPixel(pixels, width, height, 0, y, rowN, rowM, rowS);
+            for (x = 1; x + 5 <= width; x += 4) {
+                __m128 lM = _mm_loadu_ps(rowM + x);
+                __m128 lN = _mm_loadu_ps(rowN + x);
+                __m128 lS = _mm_loadu_ps(rowS + x);
+                __m128 lW = _mm_loadu_ps(rowM + x - 1);
+                __m128 lE = _mm_loadu_ps(rowM + x + 1);
+                __m128 maxLuma = _mm_max_ps(_mm_max_ps(_mm_max_ps(lN, lS), _mm_max_ps(lW, lE)), lM);
+                __m128 minLuma = _mm_min_ps(_mm_min_ps(_mm_min_ps(lN, lS), _mm_min_ps(lW, lE)), lM);
+                __m128 range = _mm_sub_ps(maxLuma, minLuma);
+                __m128 edge = _mm_max_ps(thresholdMin, _mm_mul_ps(maxLuma, threshold));
+                int passed = _mm_movemask_ps(_mm_cmpge_ps(range, edge));
+                if (passed == 0) continue;  // Flat area
+                for (int i = 0; i < 4; i++) {
+                    if (passed & (1 << i)) count += filterPixel(pixels, width, height, x + i, y, rowN, rowM, rowS);
+                }
+            }
+        }
+#endif
+        
+        for (; x < width; x++) {
+            count += filterPixel(pixels, width, height, x, y, rowN, rowM, rowS);
+        }
+        return count;
+    }
+    
+    // Filter one pixel given its row and the two around it; returns 1 if it was blended
+    unsigned int filterPixel(unsigned int* pixels, int width, int height, int x, int y,
+                             const float* rowN, const float* rowM, const float* rowS) const {
+        float lM = rowM[x];
+        float lN = rowN[x];
+        float lS = rowS[x];
+        float lW = rowM[(std::max)(x - 1, 0)];
+        float lE = rowM[(std::min)(x + 1, width - 1)];
+        float maxLuma = (std::max)((std::max)((std::max)(lN, lS), (std::max)(lW, lE)), lM);
+        float minLuma = (std::min)((std::min)((std::min)(lN, lS), (std::min)(lW, lE)), lM);
+        float range = maxLuma - minLuma;
+        if (range < (std::max)(FXAA_EDGE_THRESHOLD_MIN, maxLuma * FXAA_EDGE_THRESHOLD)) return 0;
+        
+        float lNW = lumaAt(x - 1, y - 1, width, height);
+        float lNE = lumaAt(x + 1, y - 1, width, height);
+        float lSW = lumaAt(x - 1, y + 1, width, height);
+        float lSE = lumaAt(x + 1, y + 1, width, height);
+        
+        // Single-pixel detail: blur by how much the pixel differs from its surroundings
+        float average = (2.0f * (lN + lS + lW + lE) + lNW + lNE + lSW + lSE) * (1.0f / 12.0f);
+        float subpixel = (std::min)(fabsf(average - lM) / range, 1.0f);
+        subpixel = (-2.0f * subpixel + 3.0f) * subpixel * subpixel;
+        subpixel = subpixel * subpixel * FXAA_SUBPIXEL;
+        
+        // Edge direction from second differences (horizontal: blend with N or S)
+        float edgeHorz = fabsf(lNW + lNE - 2.0f * lN) + 2.0f * fabsf(lW + lE - 2.0f * lM) + fabsf(lSW + lSE - 2.0f * lS);
+        float edgeVert = fabsf(lNW + lSW - 2.0f * lW) + 2.0f * fabsf(lN + lS - 2.0f * lM) + fabsf(lNE + lSE - 2.0f * lE);
+        bool horizontal = edgeHorz >= edgeVert;
+        
+        // Neighbor across the edge: the side with the steeper gradient
+        float l1 = horizontal ? lN : lW;
+        float l2 = horizontal ? lS : lE;
+        bool towardFirst = fabsf(l1 - lM) >= fabsf(l2 - lM);
+        float gradient = (std::max)(fabsf(l1 - lM), fabsf(l2 - lM));
+        int across = towardFirst ? -1 : 1;
+        int ax = horizontal ? 0 : across, ay = horizontal ? across : 0;  // Step across the edge
+        int sx = horizontal ? 1 : 0, sy = horizontal ? 0 : 1;            // Step along it
+        float edgeLuma = 0.5f * (lM + (towardFirst ? l1 : l2));
+        float threshold = 0.25f * gradient;
+        
+        // Walk both ways along the edge (between this row and the neighbor's) until the
+        // luma there leaves the edge's
+        auto walk = [&](int dir, float& endDelta) {
+            int k = 1;
+            for (; k <= FXAA_SEARCH_STEPS; k++) {
+                int px = x + sx * k * dir, py = y + sy * k * dir;
+                endDelta = 0.5f * (lumaAt(px, py, width, height) + lumaAt(px + ax, py + ay, width, height)) - edgeLuma;
+                if (fabsf(endDelta) >= threshold) break;
+            }
+            return (float)(std::min)(k, FXAA_SEARCH_STEPS);
+        };
+        float endN = 0.0f, endP = 0.0f;
+        float distN = walk(-1, endN);
+        float distP = walk(1, endP);
+        
+        // Blend only toward the nearer end, and only when the edge bends the right way there
+        bool nearerN = distN < distP;
+        float dist = nearerN ? distN : distP;
+        bool centerBelow = lM - edgeLuma < 0.0f;
+        bool goodSpan = ((nearerN ? endN : endP) < 0.0f) != centerBelow;
+        float offset = goodSpan ? 0.5f - dist / (distN + distP) : 0.0f;
+        offset = (std::max)(offset, subpixel);
+        if (offset <= 0.0f) return 0;
+        
+        unsigned int neighbor = colorAt(x + ax, y + ay, width, height);
+        pixels[(size_t)y * width + x] = lerpColor(source[(size_t)y * width + x], neighbor, (std::min)(offset, 1.0f));
+        return 1;
+    }
+};
+
+// Global pass (scratch buffers persist between frames)
+inline FxaaPass g_FxaaPass;
+
+inline void ApplyFxaa(unsigned int* pixels, int width, int height) {
+    g_FxaaPass.apply(pixels, width, height);
+}
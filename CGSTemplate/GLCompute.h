@@ -2,43 +2,62 @@
 #define GLAD_IMPLEMENTATION
 #include "glad.h"
 #include "Defines.h"
+#include "TextureTable.h"
+#include "TileBinner.h"
+#include "GPUStreaming.h"
+#include "Profiler.h"
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <iostream>
 
-// GPU Vertex structure matching the compute shader
-struct GPUVertex {
-    float x, y, z, w;  // position
-    unsigned int color;
-    float u, v;
-    float pad;
-};
-
 class GLCompute {
 private:
     HWND hwnd = nullptr;
     HDC hdc = nullptr;
     HGLRC hglrc = nullptr;
     
-    GLuint computeProgram = 0;
+    GLuint computeProgram = 0;     // rasterizer.comp (one invocation per pixel)
+    GLuint binningProgram = 0;     // binning.comp (one invocation per primitive)
     GLuint pixelBuffer = 0;
     GLuint depthBuffer = 0;
-    GLuint triangleBuffer = 0;
-    GLuint lineBuffer = 0;
-    GLuint textureBuffer = 0;
+    GLuint streamBuffer = 0;       // Triangles + lines, written through a persistent mapping
+    GLuint textureBuffer = 0;      // Texels of every resident texture
+    GLuint textureSlotBuffer = 0;  // Offset/size table indexed by GPUVertex::texSlot
+    GLuint tileCountBuffer = 0;    // Primitives per 16x16 tile (binning pass output)
+    GLuint tileListBuffer = 0;     // Fixed-capacity primitive list per tile
     
     int width, height;
-    int texW = 0, texH = 0;
+    int tilesX = 0, tilesY = 0;
+    size_t tileCount = 0;
+    
+    // Streaming uploads: each dispatch takes a fenced range of streamBuffer
+    static constexpr size_t INITIAL_STREAM_BYTES = 4 * 1024 * 1024;
+    unsigned char* streamPtr = nullptr;  // Persistent mapping (null when glBufferStorage is missing)
+    size_t streamAlignment = 256;
+    StreamRing streamRing;
+    
+    // Async readback: pixels are copied to a staging buffer and read `readbackLatency` frames later
+    static constexpr int MAX_READBACK_LATENCY = 2;
+    GLuint readbackBuffers[MAX_READBACK_LATENCY + 1] = {};
+    unsigned int* readbackPtrs[MAX_READBACK_LATENCY + 1] = {};
+    ReadbackRing readback;
+    int readbackLatency = 0;       // Synchronous by default (see setReadbackLatency)
+    TextureTable textureTable;
+    size_t textureCapacity = 0;    // Texels allocated in textureBuffer
+    int currentTextureSlot = -1;   // Slot stamped on triangles added without an explicit one
     bool initialized = false;
     bool useTexture = false;
     bool depthCleared = false;
+    bool passWritten = false;  // A pass already wrote the frame (later passes must accumulate)
     
     // Performance counters (per frame)
     int dispatchCount = 0;
     int trianglesRendered = 0;
     int textureUploads = 0;
+    int streamWaits = 0;       // Uploads that had to wait for the GPU to release ring space
     
     std::vector<GPUVertex> triangleData;
     std::vector<GPUVertex> lineData;
@@ -50,6 +69,19 @@ public:
     int getDispatchCount() const { return dispatchCount; }
     int getTrianglesRendered() const { return trianglesRendered; }
     int getTextureUploads() const { return textureUploads; }
+    size_t getResidentTextureCount() const { return textureTable.getTextureCount(); }
+    size_t getTextureMemoryBytes() const { return textureTable.getMemoryBytes(); }
+    int getStreamWaits() const { return streamWaits; }
+    int getReadbackLatency() const { return readbackLatency; }
+    
+    // Frames between rendering and presenting GPU pixels (0 = synchronous readback).
+    // Opt-in: with N > 0, dispatch() stops stalling on the copy but presents the frame
+    // rendered N frames earlier. After a reset the first frame is still read back
+    // synchronously, and repeated until N newer copies are queued.
+    void setReadbackLatency(int frames) {
+        readbackLatency = (frames < 0) ? 0 : (frames > MAX_READBACK_LATENCY ? MAX_READBACK_LATENCY : frames);
+        if (initialized) readback.reset(fenceOps(), readbackLatency);
+    }
     
     ~GLCompute() {
         shutdown();
@@ -102,42 +134,75 @@ public:
             return false;
         }
         
-        // Load and compile compute shader
-        if (!loadComputeShader("CGSTemplate/rasterizer.comp")) {
+        // Load and compile compute shaders (raster pass + binning pass)
+        if (!loadComputeShader("CGSTemplate/rasterizer.comp", computeProgram)) {
             // Try alternate path
-            if (!loadComputeShader("rasterizer.comp")) {
+            if (!loadComputeShader("rasterizer.comp", computeProgram)) {
                 std::cerr << "Failed to load compute shader\n";
                 return false;
             }
         }
+        if (!loadComputeShader("CGSTemplate/binning.comp", binningProgram)) {
+            if (!loadComputeShader("binning.comp", binningProgram)) {
+                std::cerr << "Failed to load binning shader\n";
+                return false;
+            }
+        }
         
         // Create buffers
         glGenBuffers(1, &pixelBuffer);
         glGenBuffers(1, &depthBuffer);
-        glGenBuffers(1, &triangleBuffer);
-        glGenBuffers(1, &lineBuffer);
         
-        // Initialize pixel buffer
+        // Initialize pixel and depth buffers (cleared on the device every frame)
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(unsigned int), nullptr, GL_DYNAMIC_READ);
-        
-        // Initialize depth buffer
+        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, depthBuffer);
-        std::vector<float> depthInit(NUM_PIXELS, 1000000.0f);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(float), depthInit.data(), GL_DYNAMIC_DRAW);
-        
-        // Initialize triangle buffer (will resize as needed)
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 1024 * sizeof(GPUVertex), nullptr, GL_DYNAMIC_DRAW);
-        
-        // Initialize line buffer
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lineBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 1024 * sizeof(GPUVertex), nullptr, GL_DYNAMIC_DRAW);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+        clearDepth();
+        
+        // Initialize the triangle/line stream (grows if a batch does not fit)
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        streamAlignment = (alignment > 0) ? (size_t)alignment : 256;
+        streamRing.setFenceOps(fenceOps());
+        createStreamBuffer(INITIAL_STREAM_BYTES);
+        
+        // Initialize readback staging buffers
+        for (int i = 0; i <= MAX_READBACK_LATENCY; i++) {
+            glGenBuffers(1, &readbackBuffers[i]);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[i]);
+            if (glBufferStorage) {
+                GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_COPY_WRITE_BUFFER, NUM_PIXELS * sizeof(unsigned int), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+                readbackPtrs[i] = (unsigned int*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, NUM_PIXELS * sizeof(unsigned int), flags);
+            } else {
+                glBufferData(GL_COPY_WRITE_BUFFER, NUM_PIXELS * sizeof(unsigned int), nullptr, GL_STREAM_READ);
+                readbackPtrs[i] = nullptr;
+            }
+        }
+        readback.reset(fenceOps(), readbackLatency);
         
-        // Initialize texture buffer
+        // Initialize texture buffers (grow as textures become resident)
         glGenBuffers(1, &textureBuffer);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, textureBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 4, nullptr, GL_STATIC_DRAW); // Will resize when texture uploaded
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 4, nullptr, GL_STATIC_DRAW);
+        glGenBuffers(1, &textureSlotBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, textureSlotBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUTextureSlot), nullptr, GL_STATIC_DRAW);
+        textureTable.clear();
+        textureCapacity = 0;
+        currentTextureSlot = -1;
+        
+        // Initialize tile bins (one tile per 16x16 raster workgroup)
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        tileCount = (size_t)tilesX * tilesY;
+        glGenBuffers(1, &tileCountBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileCountBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileCount * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &tileListBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileCount * MAX_PRIMS_PER_TILE * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
         
         initialized = true;
         std::cout << "GPU Compute initialized successfully!\n";
@@ -145,12 +210,28 @@ public:
     }
     
     void shutdown() {
+        // Let the GPU finish with mapped memory before it goes away
+        if (initialized) {
+            streamRing.drain();
+            readback.drain();
+        }
+        
         if (computeProgram) glDeleteProgram(computeProgram);
+        if (binningProgram) glDeleteProgram(binningProgram);
         if (pixelBuffer) glDeleteBuffers(1, &pixelBuffer);
         if (depthBuffer) glDeleteBuffers(1, &depthBuffer);
-        if (triangleBuffer) glDeleteBuffers(1, &triangleBuffer);
-        if (lineBuffer) glDeleteBuffers(1, &lineBuffer);
+        if (streamBuffer) glDeleteBuffers(1, &streamBuffer);
+        for (int i = 0; i <= MAX_READBACK_LATENCY; i++) {
+            if (readbackBuffers[i]) glDeleteBuffers(1, &readbackBuffers[i]);
+            readbackBuffers[i] = 0;
+            readbackPtrs[i] = nullptr;
+        }
+        streamBuffer = 0;
+        streamPtr = nullptr;
         if (textureBuffer) glDeleteBuffers(1, &textureBuffer);
+        if (textureSlotBuffer) glDeleteBuffers(1, &textureSlotBuffer);
+        if (tileCountBuffer) glDeleteBuffers(1, &tileCountBuffer);
+        if (tileListBuffer) glDeleteBuffers(1, &tileListBuffer);
         
         if (hglrc) {
             wglMakeCurrent(nullptr, nullptr);
@@ -167,35 +248,39 @@ public:
         triangleData.clear();
         lineData.clear();
         depthCleared = false;
+        passWritten = false;
         
         // Reset performance counters
         dispatchCount = 0;
         trianglesRendered = 0;
         textureUploads = 0;
+        streamWaits = 0;
         
         // Reset depth buffer at frame start (not in dispatch)
         if (initialized) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, depthBuffer);
-            std::vector<float> depthReset(NUM_PIXELS, 1000000.0f);
-            glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(float), depthReset.data(), GL_DYNAMIC_DRAW);
+            clearDepth();
             
             // Also clear pixel buffer to background color (black with stars drawn later)
+            unsigned int background = 0xFF000000;
             glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelBuffer);
-            std::vector<unsigned int> pixelClear(NUM_PIXELS, 0xFF000000);
-            glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(unsigned int), pixelClear.data(), GL_DYNAMIC_DRAW);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &background);
             depthCleared = true;
         }
     }
     
-    // Upload texture data (BGRA format)
+    // Make a texture resident (BGRA format) and return its slot in the texture table.
+    // Textures stay resident across frames, so switching textures never forces a flush.
+    int registerTexture(const unsigned int* textureData, int width, int height) {
+        if (!initialized || !textureData || width <= 0 || height <= 0) return -1;
+        return textureTable.acquire(textureData, width, height);
+    }
+    
+    // Select the texture for following addTexturedTriangle calls
     void uploadTexture(const unsigned int* textureData, int width, int height) {
-        if (!initialized) return;
-        texW = width;
-        texH = height;
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, textureBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, width * height * sizeof(unsigned int), textureData, GL_STATIC_DRAW);
+        int slot = registerTexture(textureData, width, height);
+        if (slot < 0) return;
+        currentTextureSlot = slot;
         useTexture = true;
-        textureUploads++;  // Track uploads
     }
     
     // Enable/disable texture sampling (call before adding triangles)
@@ -203,68 +288,67 @@ public:
         useTexture = use;
     }
     
-    // Add a triangle (screen-space vertices) - pad=0 means NOT textured
+    // Add a triangle (screen-space vertices) - texSlot=0 means NOT textured
     void addTriangle(float x0, float y0, float z0, unsigned int c0,
                      float x1, float y1, float z1, unsigned int c1,
                      float x2, float y2, float z2, unsigned int c2) {
-        triangleData.push_back({x0, y0, z0, 1.0f, c0, 0, 0, 0.0f});  // pad=0 = solid color
-        triangleData.push_back({x1, y1, z1, 1.0f, c1, 0, 0, 0.0f});
-        triangleData.push_back({x2, y2, z2, 1.0f, c2, 0, 0, 0.0f});
+        triangleData.push_back({x0, y0, z0, 1.0f, c0, 0, 0, 0u});
+        triangleData.push_back({x1, y1, z1, 1.0f, c1, 0, 0, 0u});
+        triangleData.push_back({x2, y2, z2, 1.0f, c2, 0, 0, 0u});
     }
     
-    // Add a textured triangle (screen-space vertices with UVs) - pad=1 means TEXTURED
+    // Add a textured triangle (screen-space vertices with UVs) using an explicit texture slot
+    void addTexturedTriangle(int slot,
+                              float x0, float y0, float z0, unsigned int c0, float u0, float v0,
+                              float x1, float y1, float z1, unsigned int c1, float u1, float v1,
+                              float x2, float y2, float z2, unsigned int c2, float u2, float v2) {
+        unsigned int texSlot = (slot >= 0) ? (unsigned int)slot + 1 : 0u;
+        triangleData.push_back({x0, y0, z0, 1.0f, c0, u0, v0, texSlot});
+        triangleData.push_back({x1, y1, z1, 1.0f, c1, u1, v1, texSlot});
+        triangleData.push_back({x2, y2, z2, 1.0f, c2, u2, v2, texSlot});
+    }
+    
+    // Add a textured triangle using the texture selected by uploadTexture
     void addTexturedTriangle(float x0, float y0, float z0, unsigned int c0, float u0, float v0,
                               float x1, float y1, float z1, unsigned int c1, float u1, float v1,
                               float x2, float y2, float z2, unsigned int c2, float u2, float v2) {
-        triangleData.push_back({x0, y0, z0, 1.0f, c0, u0, v0, 1.0f});  // pad=1 = textured
-        triangleData.push_back({x1, y1, z1, 1.0f, c1, u1, v1, 1.0f});
-        triangleData.push_back({x2, y2, z2, 1.0f, c2, u2, v2, 1.0f});
+        addTexturedTriangle(currentTextureSlot,
+                            x0, y0, z0, c0, u0, v0,
+                            x1, y1, z1, c1, u1, v1,
+                            x2, y2, z2, c2, u2, v2);
+    }
+    
+    // Append a batch of screen-space triangles (3 vertices each) in one go; textured
+    // triangles use the texture selected by uploadTexture
+    void addTriangles(const GPUVertex* verts, size_t vertexCount, bool textured) {
+        unsigned int texSlot = (textured && currentTextureSlot >= 0) ? (unsigned int)currentTextureSlot + 1 : 0u;
+        size_t start = triangleData.size();
+        triangleData.insert(triangleData.end(), verts, verts + vertexCount);
+        for (size_t i = start; i < triangleData.size(); i++) {
+            triangleData[i].texSlot = texSlot;
+        }
     }
     
     // Add a line (screen-space vertices)
     void addLine(float x0, float y0, float z0, unsigned int c0,
                  float x1, float y1, float z1, unsigned int c1) {
-        lineData.push_back({x0, y0, z0, 1.0f, c0, 0, 0, 0});
-        lineData.push_back({x1, y1, z1, 1.0f, c1, 0, 0, 0});
+        lineData.push_back({x0, y0, z0, 1.0f, c0, 0, 0, 0u});
+        lineData.push_back({x1, y1, z1, 1.0f, c1, 0, 0, 0u});
     }
     
-    // Flush current triangles to the pixel buffer (for multi-texture support)
+    // Rasterize the queued triangles into the GPU pixel buffer (read back by dispatch())
     // Does NOT reset depth buffer, allowing incremental rendering
-    void flushTriangles(unsigned int* outputPixels) {
+    void flushTriangles() {
         if (!initialized || triangleData.empty()) return;
+        PROFILE_SCOPE("GLCompute::flushTriangles");
         
         // Track triangles before clearing
         trianglesRendered += (int)(triangleData.size() / 3);
         dispatchCount++;
         
-        // Upload triangle data
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleBuffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, triangleData.size() * sizeof(GPUVertex), triangleData.data(), GL_DYNAMIC_DRAW);
-        
-        // Bind buffers
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pixelBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, depthBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, triangleBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, lineBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, textureBuffer);
-        
-        // Set uniforms
-        glUseProgram(computeProgram);
-        glUniform1i(glGetUniformLocation(computeProgram, "screenWidth"), width);
-        glUniform1i(glGetUniformLocation(computeProgram, "screenHeight"), height);
-        glUniform1i(glGetUniformLocation(computeProgram, "numTriangles"), (int)(triangleData.size() / 3));
-        glUniform1i(glGetUniformLocation(computeProgram, "numLines"), 0);  // Don't process lines in flush
-        glUniform1i(glGetUniformLocation(computeProgram, "texWidth"), texW);
-        glUniform1i(glGetUniformLocation(computeProgram, "texHeight"), texH);
-        glUniform1i(glGetUniformLocation(computeProgram, "useTexture"), useTexture ? 1 : 0);
-        
-        // Dispatch compute shader
-        GLuint groupsX = (width + 15) / 16;
-        GLuint groupsY = (height + 15) / 16;
-        glDispatchCompute(groupsX, groupsY, 1);
-        
-        // Wait for completion
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        // Upload any newly resident textures, then triangle data (lines are only processed by dispatch())
+        syncTextures();
+        rasterizePasses(triangleData, std::vector<GPUVertex>());
         
         // Clear triangle buffer for next batch (keep depth intact)
         triangleData.clear();
@@ -273,65 +357,218 @@ public:
     // Execute compute shader and read back pixels
     void dispatch(unsigned int* outputPixels) {
         if (!initialized) return;
+        PROFILE_SCOPE("GLCompute::dispatch");
         
         // Only reset depth if not already done in beginFrame
         if (!depthCleared) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, depthBuffer);
-            std::vector<float> depthReset(NUM_PIXELS, 1000000.0f);
-            glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PIXELS * sizeof(float), depthReset.data(), GL_DYNAMIC_DRAW);
+            clearDepth();
         }
         
-        // Upload triangle data
-        if (!triangleData.empty()) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleBuffer);
-            glBufferData(GL_SHADER_STORAGE_BUFFER, triangleData.size() * sizeof(GPUVertex), triangleData.data(), GL_DYNAMIC_DRAW);
-        }
+        // Upload any newly resident textures, then triangle and line data
+        syncTextures();
+        rasterizePasses(triangleData, lineData);
         
-        // Upload line data
-        if (!lineData.empty()) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, lineBuffer);
-            glBufferData(GL_SHADER_STORAGE_BUFFER, lineData.size() * sizeof(GPUVertex), lineData.data(), GL_DYNAMIC_DRAW);
+        // Track performance
+        trianglesRendered += (int)(triangleData.size() / 3);
+        trianglesRendered += (int)(lineData.size() / 2);  // lines too
+        dispatchCount++;
+        
+        // Copy this frame to a staging buffer, then read back the frame that is `readbackLatency` old
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        int slot = readback.writeSlot();
+        glBindBuffer(GL_COPY_READ_BUFFER, pixelBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[slot]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, NUM_PIXELS * sizeof(unsigned int));
+        readback.submitWrite();
+        
+        int ready = readback.resolve();
+        if (ready < 0) return;
+        if (readbackPtrs[ready]) {
+            memcpy(outputPixels, readbackPtrs[ready], NUM_PIXELS * sizeof(unsigned int));
+        } else {
+            glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[ready]);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, NUM_PIXELS * sizeof(unsigned int), outputPixels);
         }
+    }
+    
+    bool isInitialized() const { return initialized; }
+    
+    // Read back the tile bins of the last binning pass (for checking against binPrimitives)
+    bool readBins(TileBins& bins) {
+        if (!initialized) return false;
+        bins.tilesX = tilesX;
+        bins.tilesY = tilesY;
+        bins.maxPerTile = MAX_PRIMS_PER_TILE;
+        bins.counts.resize(tileCount);
+        bins.lists.resize(tileCount * MAX_PRIMS_PER_TILE);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileCountBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tileCount * sizeof(unsigned int), bins.counts.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bins.lists.size() * sizeof(unsigned int), bins.lists.data());
+        return true;
+    }
+
+private:
+    // Stream the primitives, bin them into screen tiles, then rasterize each tile's list
+    void rasterizePasses(const std::vector<GPUVertex>& triangles, const std::vector<GPUVertex>& lines) {
+        int numTriangles = (int)(triangles.size() / 3);
+        int numLines = (int)(lines.size() / 2);
+        
+        // Both arrays share one range of the stream ring (lines start at the next aligned offset)
+        size_t triangleBytes = triangles.size() * sizeof(GPUVertex);
+        size_t lineBytes = lines.size() * sizeof(GPUVertex);
+        size_t lineStart = (triangleBytes + streamAlignment - 1) / streamAlignment * streamAlignment;
+        size_t offset = streamWrite(triangles.data(), triangleBytes, lines.data(), lineBytes, lineStart);
         
         // Bind buffers
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pixelBuffer);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, depthBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, triangleBuffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, lineBuffer);
+        if (triangleBytes) glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, streamBuffer, offset, triangleBytes);
+        else glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, streamBuffer);
+        if (lineBytes) glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, streamBuffer, offset + lineStart, lineBytes);
+        else glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, streamBuffer);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, textureBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, textureSlotBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, tileCountBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, tileListBuffer);
+        
+        // Binning pass: reset tile counts, then one invocation per primitive
+        unsigned int zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileCountBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        
+        int numPrims = numTriangles + numLines;
+        if (numPrims > 0) {
+            glUseProgram(binningProgram);
+            setUniform(binningProgram, "screenWidth", width);
+            setUniform(binningProgram, "screenHeight", height);
+            setUniform(binningProgram, "numTriangles", numTriangles);
+            setUniform(binningProgram, "numLines", numLines);
+            setUniform(binningProgram, "tilesX", tilesX);
+            setUniform(binningProgram, "tilesY", tilesY);
+            setUniform(binningProgram, "maxPrimsPerTile", MAX_PRIMS_PER_TILE);
+            glDispatchCompute((GLuint)(numPrims + 63) / 64, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
         
-        // Set uniforms
+        // Raster pass: each 16x16 workgroup walks only its tile's list
         glUseProgram(computeProgram);
-        glUniform1i(glGetUniformLocation(computeProgram, "screenWidth"), width);
-        glUniform1i(glGetUniformLocation(computeProgram, "screenHeight"), height);
-        glUniform1i(glGetUniformLocation(computeProgram, "numTriangles"), (int)(triangleData.size() / 3));
-        glUniform1i(glGetUniformLocation(computeProgram, "numLines"), (int)(lineData.size() / 2));
-        glUniform1i(glGetUniformLocation(computeProgram, "texWidth"), texW);
-        glUniform1i(glGetUniformLocation(computeProgram, "texHeight"), texH);
-        glUniform1i(glGetUniformLocation(computeProgram, "useTexture"), useTexture ? 1 : 0);
-        
-        // Dispatch compute shader
-        GLuint groupsX = (width + 15) / 16;
-        GLuint groupsY = (height + 15) / 16;
-        glDispatchCompute(groupsX, groupsY, 1);
+        setUniform(computeProgram, "screenWidth", width);
+        setUniform(computeProgram, "screenHeight", height);
+        setUniform(computeProgram, "numTriangles", numTriangles);
+        setUniform(computeProgram, "numLines", numLines);
+        setUniform(computeProgram, "useTexture", useTexture ? 1 : 0);
+        setUniform(computeProgram, "loadExisting", passWritten ? 1 : 0);
+        setUniform(computeProgram, "useBins", 1);
+        setUniform(computeProgram, "tilesX", tilesX);
+        setUniform(computeProgram, "maxPrimsPerTile", MAX_PRIMS_PER_TILE);
+        
+        glDispatchCompute((GLuint)tilesX, (GLuint)tilesY, 1);
+        passWritten = true;
+        
+        // The ring may reuse this range once the GPU has passed this point
+        streamRing.submit();
         
         // Wait for completion
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    
+    // Copy a dispatch's triangles and lines into the next free range of streamBuffer; returns its offset
+    size_t streamWrite(const void* triangles, size_t triangleBytes, const void* lines, size_t lineBytes, size_t lineStart) {
+        size_t total = lineStart + lineBytes;
+        int waitsBefore = streamRing.getWaitCount();
+        size_t offset = 0;
+        if (!streamRing.allocate(total, offset)) {
+            // Batch larger than the whole ring: wait for the GPU, then reallocate bigger
+            streamRing.drain();
+            createStreamBuffer((std::max)(total * 2, streamRing.getCapacity() * 2));
+            streamRing.allocate(total, offset);
+        }
+        streamWaits += streamRing.getWaitCount() - waitsBefore;
+        
+        if (streamPtr) {
+            if (triangleBytes) memcpy(streamPtr + offset, triangles, triangleBytes);
+            if (lineBytes) memcpy(streamPtr + offset + lineStart, lines, lineBytes);
+        } else {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, streamBuffer);
+            if (triangleBytes) glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, triangleBytes, triangles);
+            if (lineBytes) glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + lineStart, lineBytes, lines);
+        }
+        return offset;
+    }
+    
+    // (Re)create the stream buffer, persistently mapped when GL 4.4 buffer storage is available
+    void createStreamBuffer(size_t bytes) {
+        if (streamBuffer) glDeleteBuffers(1, &streamBuffer);
+        glGenBuffers(1, &streamBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, streamBuffer);
+        if (glBufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, flags);
+            streamPtr = (unsigned char*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, bytes, flags);
+        } else {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            streamPtr = nullptr;
+        }
+        streamRing.reset(bytes, streamAlignment);
+    }
+    
+    void clearDepth() {
+        float farDepth = 1000000.0f;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, depthBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, &farDepth);
+    }
+    
+    // GL sync objects behind the FenceOps used by StreamRing/ReadbackRing
+    static FenceOps fenceOps() {
+        FenceOps ops;
+        ops.insert = [](void*) -> GPUFence {
+            return (GPUFence)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        };
+        ops.wait = [](void*, GPUFence fence) {
+            GLenum result;
+            do {
+                result = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);  // 1ms
+            } while (result == GL_TIMEOUT_EXPIRED);
+        };
+        ops.release = [](void*, GPUFence fence) {
+            glDeleteSync((GLsync)fence);
+        };
+        return ops;
+    }
+    
+    void setUniform(GLuint program, const char* name, int value) {
+        glUniform1i(glGetUniformLocation(program, name), value);
+    }
+    
+    // Send texels/slots added since the last dispatch (appends in place while capacity allows)
+    void syncTextures() {
+        if (!textureTable.hasPendingUpload()) return;
         
-        // Track performance
-        trianglesRendered += (int)(triangleData.size() / 3);
-        trianglesRendered += (int)(lineData.size() / 2);  // lines too
-        dispatchCount++;
+        const std::vector<unsigned int>& texels = textureTable.getTexels();
+        const std::vector<GPUTextureSlot>& slots = textureTable.getSlots();
         
-        // Read back pixel data
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelBuffer);
-        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, NUM_PIXELS * sizeof(unsigned int), outputPixels);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, textureBuffer);
+        if (texels.size() > textureCapacity) {
+            // Grow geometrically and re-send everything
+            textureCapacity = (std::max)(texels.size(), textureCapacity * 2);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, textureCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, texels.size() * sizeof(unsigned int), texels.data());
+        } else {
+            size_t first = textureTable.getUploadedTexelCount();
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(unsigned int),
+                            (texels.size() - first) * sizeof(unsigned int), texels.data() + first);
+        }
+        
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, textureSlotBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, slots.size() * sizeof(GPUTextureSlot), slots.data(), GL_STATIC_DRAW);
+        
+        textureTable.markUploaded();
+        textureUploads++;  // Track uploads
     }
     
-    bool isInitialized() const { return initialized; }
-
-private:
-    bool loadComputeShader(const char* filepath) {
+    bool loadComputeShader(const char* filepath, GLuint& program) {
         std::ifstream file(filepath);
         if (!file.is_open()) {
             return false;
@@ -359,15 +596,15 @@ private:
         }
         
         // Create program
-        computeProgram = glCreateProgram();
-        glAttachShader(computeProgram, shader);
-        glLinkProgram(computeProgram);
+        program = glCreateProgram();
+        glAttachShader(program, shader);
+        glLinkProgram(program);
         
         // Check linking
-        glGetProgramiv(computeProgram, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if (!success) {
             char infoLog[512];
-            glGetProgramInfoLog(computeProgram, 512, nullptr, infoLog);
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
             std::cerr << "Compute program linking failed:\n" << infoLog << std::endl;
             glDeleteShader(shader);
             return false;
@@ -407,10 +644,22 @@ inline void GPU_AddTexturedTriangle(const vertex& v0, const vertex& v1, const ve
     );
 }
 
+inline void GPU_AddTexturedTriangle(const vertex& v0, const vertex& v1, const vertex& v2, int textureSlot) {
+    g_GLCompute.addTexturedTriangle(textureSlot,
+        v0.pos.x, v0.pos.y, v0.pos.z, v0.color, v0.u, v0.v,
+        v1.pos.x, v1.pos.y, v1.pos.z, v1.color, v1.u, v1.v,
+        v2.pos.x, v2.pos.y, v2.pos.z, v2.color, v2.u, v2.v
+    );
+}
+
 inline void GPU_UploadTexture(const unsigned int* textureData, int width, int height) {
     g_GLCompute.uploadTexture(textureData, width, height);
 }
 
+inline int GPU_RegisterTexture(const unsigned int* textureData, int width, int height) {
+    return g_GLCompute.registerTexture(textureData, width, height);
+}
+
 inline void GPU_AddLine(const vertex& v0, const vertex& v1, unsigned int color) {
     g_GLCompute.addLine(
         v0.pos.x, v0.pos.y, v0.pos.z, color,
@@ -422,9 +671,9 @@ inline void GPU_Dispatch(unsigned int* pixels) {
     g_GLCompute.dispatch(pixels);
 }
 
-// Flush current triangles (for multi-texture rendering)
-inline void GPU_FlushTriangles(unsigned int* pixels) {
-    g_GLCompute.flushTriangles(pixels);
+// Rasterize the queued triangles now; pixels reach the CPU with the next GPU_Dispatch
+inline void GPU_FlushTriangles() {
+    g_GLCompute.flushTriangles();
 }
 
 inline void GPU_Shutdown() {
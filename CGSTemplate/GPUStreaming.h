@@ -0,0 +1,201 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Buffer-lifetime bookkeeping for GLCompute's streaming uploads and readback.
+// Nothing here touches GL: fences go through FenceOps, so GLCompute plugs in
+// glFenceSync/glClientWaitSync and SimulatedFences drives the same logic headlessly
+// (checkStreamingRings in Benchmark.h, run by "--bench").
+
+typedef void* GPUFence;
+
+struct FenceOps {
+    GPUFence (*insert)(void* user);                // Fence after all commands issued so far
+    void (*wait)(void* user, GPUFence fence);      // Block until the fence has signaled
+    void (*release)(void* user, GPUFence fence);   // Destroy a fence (signaled or not)
+    void* user = nullptr;
+};
+
+// StreamRing - hands out aligned ranges of a persistently mapped buffer.
+// Each dispatch allocates one range, writes it, then calls submit() to fence it.
+// A range is only handed out again once the GPU has passed the fence of every
+// older range that overlaps it, so the CPU never overwrites data still being read.
+class StreamRing {
+private:
+    struct InFlight {
+        size_t begin, end;
+        GPUFence fence;
+    };
+    
+    FenceOps ops;
+    size_t capacity = 0;
+    size_t alignment = 1;
+    size_t head = 0;
+    std::vector<InFlight> inFlight;    // Oldest first
+    bool hasPending = false;
+    size_t pendingBegin = 0, pendingEnd = 0;
+    int waits = 0;                     // Allocations that had to wait on a fence
+    
+public:
+    StreamRing() {}
+    StreamRing(const FenceOps& fenceOps) : ops(fenceOps) {}
+    
+    void setFenceOps(const FenceOps& fenceOps) { ops = fenceOps; }
+    
+    // Start over with a new buffer (call drain() first if the old one was in use)
+    void reset(size_t bytes, size_t align) {
+        capacity = bytes;
+        alignment = align ? align : 1;
+        head = 0;
+        hasPending = false;
+        inFlight.clear();
+    }
+    
+    // Reserve bytes for the next dispatch. Returns false if they can never fit (caller grows the buffer).
+    bool allocate(size_t bytes, size_t& offset) {
+        if (bytes == 0) bytes = 1;
+        if (bytes > capacity || hasPending) return false;
+        
+        size_t begin = (head + alignment - 1) / alignment * alignment;
+        if (begin + bytes > capacity) begin = 0;  // Wrap, skipping the tail
+        size_t end = begin + bytes;
+        
+        // In-flight ranges are oldest first and fences signal in order, so waiting on the
+        // newest overlapping range retires it and everything before it (including a skipped tail)
+        int newest = -1;
+        for (size_t i = 0; i < inFlight.size(); i++) {
+            if (inFlight[i].begin < end && begin < inFlight[i].end) newest = (int)i;
+        }
+        if (newest >= 0) {
+            ops.wait(ops.user, inFlight[newest].fence);
+            for (int i = 0; i <= newest; i++) ops.release(ops.user, inFlight[i].fence);
+            inFlight.erase(inFlight.begin(), inFlight.begin() + newest + 1);
+            waits++;
+        }
+        
+        pendingBegin = begin;
+        pendingEnd = end;
+        hasPending = true;
+        head = end;
+        offset = begin;
+        return true;
+    }
+    
+    // Fence the range returned by the last allocate() (call right after the dispatch that reads it)
+    void submit() {
+        if (!hasPending) return;
+        inFlight.push_back({ pendingBegin, pendingEnd, ops.insert(ops.user) });
+        hasPending = false;
+    }
+    
+    // Wait for every submitted range (before deleting or resizing the buffer)
+    void drain() {
+        if (!inFlight.empty()) ops.wait(ops.user, inFlight.back().fence);
+        for (size_t i = 0; i < inFlight.size(); i++) ops.release(ops.user, inFlight[i].fence);
+        inFlight.clear();
+        hasPending = false;
+    }
+    
+    size_t getCapacity() const { return capacity; }
+    size_t getInFlightCount() const { return inFlight.size(); }
+    int getWaitCount() const { return waits; }
+};
+
+// ReadbackRing - rotates the frame's pixels through latency+1 staging buffers.
+// Frame N copies into one slot and presents the slot copied `latency` frames ago,
+// whose fence has normally signaled already, so the CPU does not stall on the GPU.
+// Until enough frames have been queued the newest slot is read (a synchronous wait).
+class ReadbackRing {
+private:
+    FenceOps ops;
+    std::vector<GPUFence> fences;
+    int latency = 1;
+    long long frame = 0;     // Frames copied so far
+    long long resolved = 0;  // Frames handed back to the CPU so far
+    
+public:
+    ReadbackRing() {}
+    ReadbackRing(const FenceOps& fenceOps, int frameLatency) { reset(fenceOps, frameLatency); }
+    
+    void reset(const FenceOps& fenceOps, int frameLatency) {
+        drain();
+        ops = fenceOps;
+        latency = frameLatency < 0 ? 0 : frameLatency;
+        fences.assign(latency + 1, nullptr);
+        frame = 0;
+        resolved = 0;
+    }
+    
+    int getSlotCount() const { return (int)fences.size(); }
+    
+    // Slot to copy this frame's pixels into
+    int writeSlot() const { return (int)(frame % fences.size()); }
+    
+    // Fence the copy just issued into writeSlot()
+    void submitWrite() {
+        int slot = writeSlot();
+        if (fences[slot]) ops.release(ops.user, fences[slot]);
+        fences[slot] = ops.insert(ops.user);
+        frame++;
+    }
+    
+    // Slot holding the frame to present (waits for its copy); -1 if nothing was written
+    int resolve() {
+        if (frame == 0) return -1;
+        
+        // Present the frame copied `latency` frames ago. While the queue fills, repeat the
+        // last presented frame (only the very first frame waits on a fresh copy).
+        long long target = frame - 1 - latency;
+        if (target < 0) target = (resolved > 0) ? resolved - 1 : frame - 1;
+        
+        int slot = (int)(target % fences.size());
+        if (fences[slot]) {
+            ops.wait(ops.user, fences[slot]);
+            ops.release(ops.user, fences[slot]);
+            fences[slot] = nullptr;
+        }
+        resolved = target + 1;
+        return slot;
+    }
+    
+    // Release every fence (before deleting the staging buffers)
+    void drain() {
+        for (size_t i = 0; i < fences.size(); i++) {
+            if (fences[i]) {
+                ops.wait(ops.user, fences[i]);
+                ops.release(ops.user, fences[i]);
+                fences[i] = nullptr;
+            }
+        }
+    }
+};
+
+// SimulatedFences - CPU stand-in for GL sync objects.
+// Fences are numbered; the "GPU" completes them when complete() is called or when waited on.
+struct SimulatedFences {
+    size_t issued = 0;
+    size_t completed = 0;
+    int stalls = 0;       // Waits on a fence that had not completed yet
+    int released = 0;
+    
+    void complete(size_t upTo) { if (upTo > completed) completed = (upTo < issued) ? upTo : issued; }
+    void completeAll() { completed = issued; }
+    
+    FenceOps ops() {
+        FenceOps f;
+        f.user = this;
+        f.insert = [](void* u) -> GPUFence {
+            SimulatedFences* s = (SimulatedFences*)u;
+            return (GPUFence)(++s->issued);
+        };
+        f.wait = [](void* u, GPUFence fence) {
+            SimulatedFences* s = (SimulatedFences*)u;
+            size_t id = (size_t)fence;
+            if (id > s->completed) { s->stalls++; s->completed = id; }
+        };
+        f.release = [](void* u, GPUFence) {
+            ((SimulatedFences*)u)->released++;
+        };
+        return f;
+    }
+};
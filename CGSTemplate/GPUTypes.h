@@ -0,0 +1,19 @@
+#pragma once
+// Data layouts shared between GLCompute and the compute shaders.
+// Kept free of any GL/Windows dependency so CPU reference code can use them too.
+
+// GPU Vertex structure matching the compute shader (std430, 32 bytes)
+struct GPUVertex {
+    float x, y, z, w;  // position
+    unsigned int color;
+    float u, v;
+    unsigned int texSlot;  // 0 = solid color, otherwise texture table index + 1
+};
+
+// One entry of the texture table (std430, 16 bytes)
+struct GPUTextureSlot {
+    unsigned int offset;  // First texel in the shared texel buffer
+    int width;
+    int height;
+    int pad;
+};
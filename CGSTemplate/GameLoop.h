@@ -0,0 +1,176 @@
+#pragma once
+#include "Windows.h"
+#include <timeapi.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Game loop timing: a fixed-step accumulator for simulation and a frame limiter for pacing.
+//
+//   double dt = timer.Delta();
+//   for (int i = g_FixedStep.advance(dt); i > 0; i--) simulate(g_FixedStep.getStep());
+//   render(g_FixedStep.getAlpha());   // blend previous -> current simulation state
+//   limiter.wait();                   // then present
+
+// Turns variable frame times into a whole number of fixed simulation steps
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double stepSeconds = 1.0 / 60.0, int maxStepsPerFrame = 5)
+        : step(stepSeconds), maxSteps(maxStepsPerFrame) {}
+    
+    // Add a frame's elapsed time and return how many steps to simulate now.
+    // Long stalls (breakpoints, window drags) are clamped to maxSteps so the
+    // simulation slows down instead of spiraling.
+    int advance(double frameSeconds) {
+        if (frameSeconds < 0.0) frameSeconds = 0.0;
+        accumulator += frameSeconds;
+        
+        int steps = (int)(accumulator / step);
+        if (steps > maxSteps) {
+            steps = maxSteps;
+            accumulator = 0.0;
+            clampedFrames++;
+        } else {
+            accumulator -= steps * step;
+        }
+        totalSteps += steps;
+        return steps;
+    }
+    
+    double getStep() const { return step; }
+    void setStep(double stepSeconds) { step = stepSeconds; accumulator = 0.0; }
+    
+    // How far between the last two simulated states the rendered frame is (0..1)
+    float getAlpha() const { return (float)(accumulator / step); }
+    
+    unsigned long long getTotalSteps() const { return totalSteps; }
+    // Frames whose backlog exceeded maxSteps (simulation time was dropped)
+    unsigned long long getClampedFrames() const { return clampedFrames; }
+    
+private:
+    double step;
+    int maxSteps;
+    double accumulator = 0.0;
+    unsigned long long totalSteps = 0;
+    unsigned long long clampedFrames = 0;
+};
+
+// Paces frames to a target rate: sleeps for most of the remaining time, then spins
+// (yielding) for the last stretch, which the scheduler can't hit precisely.
+// The spin margin adapts to how much the OS oversleeps, so the core stays mostly idle.
+class FrameLimiter {
+public:
+    static constexpr double MIN_SPIN_MS = 0.25;
+    static constexpr double MAX_SPIN_MS = 4.0;
+    static constexpr int JITTER_WINDOW = 120;  // Frames in the jitter statistics
+    
+    explicit FrameLimiter(double targetHz = 0.0) { setTargetHz(targetHz); }
+    
+    ~FrameLimiter() {
+        if (timerPeriodRaised) timeEndPeriod(1);
+    }
+    
+    FrameLimiter(const FrameLimiter&) = delete;
+    FrameLimiter& operator=(const FrameLimiter&) = delete;
+    
+    // 0 disables limiting
+    void setTargetHz(double hz) {
+        targetHz = hz > 0.0 ? hz : 0.0;
+        period = targetHz > 0.0 ? toClock(1.0 / targetHz) : Clock::duration::zero();
+        hasDeadline = false;
+        
+        // Default scheduler granularity is 15.6 ms; 1 ms makes the sleep phase usable
+        if (targetHz > 0.0 && !timerPeriodRaised) {
+            timerPeriodRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+        }
+    }
+    double getTargetHz() const { return targetHz; }
+    
+    // Block until the next frame deadline
+    void wait() {
+        if (targetHz <= 0.0) return;
+        
+        Clock::time_point now = Clock::now();
+        if (!hasDeadline) {
+            deadline = now + period;
+            hasDeadline = true;
+        }
+        
+        // Sleep phase: wake up spinMs early
+        Clock::time_point wakeTarget = deadline - toClock(spinMs / 1000.0);
+        if (now < wakeTarget) {
+            std::this_thread::sleep_for(wakeTarget - now);
+            Clock::time_point woke = Clock::now();
+            double overslept = Duration(woke - wakeTarget).count() * 1000.0;
+            adaptSpinMargin(overslept);
+            now = woke;
+        }
+        
+        // Spin phase
+        while (now < deadline) {
+            std::this_thread::yield();
+            now = Clock::now();
+        }
+        
+        double lateMs = Duration(now - deadline).count() * 1000.0;
+        if (now - deadline > period) {
+            // The frame itself overran: restart the schedule instead of rushing to catch up
+            missedFrames++;
+            deadline = now + period;
+        } else {
+            recordJitter(lateMs);
+            deadline += period;
+        }
+    }
+    
+    // Lateness of the release against the deadline (ms)
+    double getAverageJitterMs() const { return jitterCount ? jitterSum / jitterCount : 0.0; }
+    double getMaxJitterMs() const { return jitterMax; }
+    double getSpinMarginMs() const { return spinMs; }
+    unsigned long long getMissedFrames() const { return missedFrames; }
+    
+private:
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::duration<double>;
+    
+    static Clock::duration toClock(double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(Duration(seconds));
+    }
+    
+    void adaptSpinMargin(double oversleptMs) {
+        // Track typical oversleep (slow decay) and keep a margin above it
+        oversleepAvg = oversleepAvg * 0.9 + oversleptMs * 0.1;
+        double target = oversleepAvg * 2.0 + MIN_SPIN_MS;
+        if (oversleptMs > spinMs) target = oversleptMs + MIN_SPIN_MS;  // React fast to a late wake
+        spinMs = (std::min)((std::max)(target, MIN_SPIN_MS), MAX_SPIN_MS);
+    }
+    
+    void recordJitter(double ms) {
+        jitter[jitterPos] = ms;
+        jitterPos = (jitterPos + 1) % JITTER_WINDOW;
+        if (jitterCount < JITTER_WINDOW) jitterCount++;
+        
+        jitterSum = 0.0;
+        jitterMax = 0.0;
+        for (int i = 0; i < jitterCount; i++) {
+            jitterSum += jitter[i];
+            jitterMax = (std::max)(jitterMax, jitter[i]);
+        }
+    }
+    
+    double targetHz = 0.0;
+    Clock::duration period = Clock::duration::zero();
+    Clock::time_point deadline;
+    bool hasDeadline = false;
+    bool timerPeriodRaised = false;
+    
+    double spinMs = 1.0;
+    double oversleepAvg = 0.0;
+    
+    double jitter[JITTER_WINDOW] = {};
+    int jitterPos = 0;
+    int jitterCount = 0;
+    double jitterSum = 0.0;
+    double jitterMax = 0.0;
+    unsigned long long missedFrames = 0;
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include "RasterHelper.h"
+#include "MaterialMesh.h"
+#include "Instancing.h"
+#include "GPUTypes.h"
+#include <vector>
+
+// Executes InstancedDraw batches (see Instancing.h).
+// Per instance: one bounding-sphere frustum test, one world*view*projection matrix,
+// and one transform per unique vertex (a post-transform cache indexed by the mesh's
+// index buffer) instead of three per triangle. Triangles then go straight to the CPU
+// raster variant chosen once per batch, or into a single GLCompute submission.
+class InstanceRenderer {
+public:
+    struct Stats {
+        int instances = 0;
+        int culledInstances = 0;
+        int vertexTransforms = 0;
+        int triangles = 0;
+        int clippedTriangles = 0;  // Touching the near plane (skipped)
+    };
+    
+    void draw(const InstancedDraw& batch) {
+        PROFILE_SCOPE("InstanceRenderer::draw");
+        stats = Stats();
+        stats.instances = (int)batch.instanceCount;
+        
+        bool useGPU = game::g_RenderCallbacks.useGPU;
+        if (useGPU && !game::g_RenderCallbacks.submitTrianglesGPU) return;
+        
+        RasterState rs;
+        rs.texture = batch.texture;
+        rs.texWidth = batch.texWidth;
+        rs.texHeight = batch.texHeight;
+        FillTriangleFn fill = selectFillTriangle(defaultRasterFeatures(batch.texture));
+        
+        matrix4x4 viewProj = matrixMultiplicationMatrix(SV_ViewMatrix, SV_ProjectionMatrix);
+        screen.resize(batch.vertexCount);
+        worldPos.resize(batch.vertexCount);
+        inFront.resize(batch.vertexCount);
+        gpuTriangles.clear();
+        
+        for (size_t n = 0; n < batch.instanceCount; n++) {
+            const InstanceTransform& inst = batch.instances[n];
+            matrix4x4 world = inst.world;
+            
+            // Per-instance culling
+            vec4 center = matrixMultiplicationVec(world, vec4{ batch.boundsCenter.x, batch.boundsCenter.y, batch.boundsCenter.z, 1.0f });
+            if (!sphereInViewFrustum({ center.x, center.y, center.z }, batch.boundsRadius * matrixMaxScale(world))) {
+                stats.culledInstances++;
+                continue;
+            }
+            
+            // Transform each unique vertex once
+            matrix4x4 wvp = matrixMultiplicationMatrix(world, viewProj);
+            for (size_t i = 0; i < batch.vertexCount; i++) {
+                const vertex& src = batch.vertices[i];
+                worldPos[i] = matrixMultiplicationVec(world, src.pos);
+                vec4 clip = matrixMultiplicationVec(wvp, src.pos);
+                inFront[i] = clip.w > SV_NearPlane;
+                
+                vertex ndc;
+                if (inFront[i]) {
+                    ndc.pos = { clip.x / clip.w, clip.y / clip.w, clip.z / clip.w, clip.w };
+                } else {
+                    ndc.pos = clip;
+                }
+                ndc.u = src.u;
+                ndc.v = src.v;
+                ndc.color = inst.color;
+                screen[i] = toScreen(ndc);
+            }
+            stats.vertexTransforms += (int)batch.vertexCount;
+            
+            rs.color = inst.color;
+            for (size_t t = 0; t + 2 < batch.indexCount; t += 3) {
+                unsigned int i0 = batch.indices[t], i1 = batch.indices[t + 1], i2 = batch.indices[t + 2];
+                if (!inFront[i0] || !inFront[i1] || !inFront[i2]) {
+                    stats.clippedTriangles++;
+                    continue;
+                }
+                
+                // Flat face lighting in world space, as drawTriangleWith does
+                float lighting = calculateLighting(calculateFaceNormal(worldPos[i0], worldPos[i1], worldPos[i2]));
+                stats.triangles++;
+                
+                if (useGPU) {
+                    appendGPUTriangle(screen[i0], screen[i1], screen[i2], inst.color, lighting, batch.texture != nullptr);
+                } else {
+                    rs.lighting = lighting;
+                    fill(screen[i0], screen[i1], screen[i2], rs);
+                }
+            }
+        }
+        
+        if (useGPU && !gpuTriangles.empty()) {
+            game::g_RenderCallbacks.submitTrianglesGPU(gpuTriangles.data(), gpuTriangles.size(), batch.texture != nullptr);
+        }
+    }
+    
+    const Stats& getLastStats() const { return stats; }
+
+private:
+    void appendGPUTriangle(const vertex& a, const vertex& b, const vertex& c, unsigned int color, float lighting, bool textured) {
+        // The compute shader reads the lighting of textured triangles from the vertex color
+        unsigned int lit;
+        if (textured) {
+            unsigned int l = (unsigned int)(lighting * 255.0f);
+            lit = 0xFF000000 | (l << 16) | (l << 8) | l;
+        } else {
+            lit = applyLighting(color, lighting);
+        }
+        const vertex* verts[3] = { &a, &b, &c };
+        for (const vertex* v : verts) {
+            gpuTriangles.push_back({ v->pos.x, v->pos.y, v->pos.z, 1.0f, lit, v->u, v->v, 0u });
+        }
+    }
+    
+    // Scratch buffers, reused across batches
+    std::vector<vertex> screen;
+    std::vector<vec4> worldPos;
+    std::vector<unsigned char> inFront;
+    std::vector<GPUVertex> gpuTriangles;
+    Stats stats;
+};
+
+// Global instance renderer
+inline InstanceRenderer g_InstanceRenderer;
+
+// RenderCallbacks::drawInstanced entry point
+inline void DrawInstanced(const InstancedDraw& batch) {
+    g_InstanceRenderer.draw(batch);
+}
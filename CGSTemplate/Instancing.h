@@ -0,0 +1,32 @@
+#pragma once
+#include "Defines.h"
+#include <cstddef>
+
+// Instanced drawing: one mesh, many transforms. MaterialMesh::drawInstanced fills an
+// InstancedDraw and hands it to the engine (InstanceRenderer.h), which transforms each
+// unique vertex once per instance and submits every instance in one batch.
+
+// Per-instance data
+struct InstanceTransform {
+    matrix4x4 world;
+    unsigned int color = 0xFFFFFFFF;
+};
+
+// A mesh plus its instances (non-owning views)
+struct InstancedDraw {
+    const vertex* vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    size_t indexCount = 0;
+    
+    const unsigned int* texture = nullptr;  // nullptr = flat instance color
+    int texWidth = 0;
+    int texHeight = 0;
+    
+    // Local bounding sphere of the mesh, for per-instance frustum culling
+    vec3 boundsCenter = { 0.0f, 0.0f, 0.0f };
+    float boundsRadius = 0.0f;
+    
+    const InstanceTransform* instances = nullptr;
+    size_t instanceCount = 0;
+};
@@ -2,6 +2,15 @@
 #include "Mesh.h"
 #include "Shaders.h"
 #include "Cubemap.h"
+#include "GPUTypes.h"
+#include "Instancing.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "DepthPrepass.h"
+#include "VisibilityBuffer.h"
+#include "Msaa.h"
+#include <algorithm>
+#include <cstring>
 
 namespace game {
 
@@ -11,13 +20,19 @@ struct RenderCallbacks {
     void (*drawTexturedTriangleGPU)(vertex, vertex, vertex) = nullptr;
     void (*drawTriangleGPU)(vertex, vertex, vertex, unsigned int) = nullptr;
     void (*drawTriangleCPU)(vertex&, vertex&, vertex&, const unsigned*, int, int) = nullptr;
+    // Whole-mesh CPU draw (selects the raster variant once per draw)
+    void (*drawTrianglesCPU)(const vertex*, const unsigned int*, size_t, const unsigned*, int, int, unsigned int) = nullptr;
     void (*uploadTextureGPU)(const unsigned int*, int, int) = nullptr;  // Upload texture to GPU
-    void (*flushGPU)(unsigned int*) = nullptr;  // Flush current triangles to pixels
-    bool useGPU = false;
+    void (*flushGPU)() = nullptr;  // Rasterize queued triangles (read back at the next dispatch)
+    void (*drawInstanced)(const InstancedDraw&) = nullptr;  // One mesh, many instances (CPU or GPU)
+    // Append screen-space triangles; textured ones use the current GPU texture
+    void (*submitTrianglesGPU)(const GPUVertex*, size_t, bool) = nullptr;
+    void (*resolveVisibilityCPU)() = nullptr;  // Shade the visibility buffer into the screen
+    void (*resolveMsaaCPU)() = nullptr;        // Average the MSAA samples into the screen
+    bool useGPU = false;  // GPU pixels lag setReadbackLatency() frames behind (0 by default)
     const unsigned int* texture = nullptr;
     int texWidth = 0;
     int texHeight = 0;
-    unsigned int* screenBuffer = nullptr;  // Pointer to screen pixels for flush
     
     // Track currently uploaded GPU texture to avoid redundant uploads
     const unsigned int* currentGPUTexture = nullptr;
@@ -30,11 +45,9 @@ struct RenderCallbacks {
         }
     }
     
-    // Flush triangles with current texture, then allow texture change
+    // Change texture for following GPU triangles. Textures stay resident in the GPU
+    // texture table and each triangle carries its slot, so no flush is needed.
     void flushAndChangeTexture(const unsigned int* newTex, int w, int h) {
-        if (currentGPUTexture && currentGPUTexture != newTex && flushGPU && screenBuffer) {
-            flushGPU(screenBuffer);
-        }
         uploadTextureIfNeeded(newTex, w, h);
     }
     
@@ -47,6 +60,78 @@ struct RenderCallbacks {
 // Global render callbacks (set by engine)
 inline RenderCallbacks g_RenderCallbacks;
 
+// ========== RENDER QUEUE ==========
+// Collects every mesh draw of a frame, sorts by texture, material and depth,
+// then submits them in batches (one texture switch per distinct texture)
+
+class MaterialMesh;
+
+struct DrawItem {
+    MaterialMesh* mesh = nullptr;
+    matrix4x4 world;
+    const unsigned int* texture = nullptr;
+    int texWidth = 0;
+    int texHeight = 0;
+    unsigned int color = 0xFFFFFFFF;
+    float depth = 0.0f;  // View-space Z of the object origin (front-to-back sort)
+    int lod = 0;
+};
+
+class RenderQueue {
+private:
+    struct SortEntry {
+        unsigned int textureGroup;
+        unsigned int color;
+        float depth;
+        unsigned int item;
+    };
+    
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> order;
+    std::vector<const unsigned int*> textureGroups;  // Distinct textures seen this frame
+    bool recording = false;
+    
+    // Stats from the last flush
+    int lastDrawCount = 0;
+    int lastTextureGroups = 0;
+    int lastTextureSwitches = 0;
+    
+    unsigned int textureGroupFor(const unsigned int* tex) {
+        if (!tex) return 0;
+        for (size_t i = 0; i < textureGroups.size(); i++) {
+            if (textureGroups[i] == tex) return (unsigned int)i + 1;
+        }
+        textureGroups.push_back(tex);
+        return (unsigned int)textureGroups.size();
+    }
+
+public:
+    // Start collecting draws for a frame
+    void begin() {
+        items.clear();
+        textureGroups.clear();
+        recording = true;
+    }
+    
+    bool isRecording() const { return recording; }
+    
+    void push(const DrawItem& item) { items.push_back(item); }
+    
+    // Sort and draw everything collected since begin()
+    void flush();
+    
+    size_t size() const { return items.size(); }
+    int getLastDrawCount() const { return lastDrawCount; }
+    int getLastTextureGroups() const { return lastTextureGroups; }
+    int getLastTextureSwitches() const { return lastTextureSwitches; }
+};
+
+// Global render queue
+inline RenderQueue g_RenderQueue;
+
+// Largest on-screen error (pixels) automatic LOD selection accepts
+inline float g_LodErrorPixels = 1.0f;
+
 // MaterialMesh - renderable mesh with texture/material support
 class MaterialMesh : public Mesh {
 private:
@@ -60,6 +145,12 @@ private:
     const Cubemap* envMap = nullptr;     // Environment cubemap for reflections
     float reflectivity = 0.0f;           // 0 = no reflection, 1 = mirror
     float refractiveIndex = 1.0f;        // For refraction (1.0 = no refraction)
+    
+    // Static lighting: per-vertex diffuse light computed once for a mesh that stays put
+    bool staticLighting = false;
+    std::vector<vec3> bakedLight;        // One per vertex (empty: not baked yet)
+    unsigned int bakedVersion = 0;       // SV_LightsVersion it was baked with
+    matrix4x4 bakedWorld;                // World matrix it was baked with
 
 public:
     MaterialMesh() : Mesh() {}
@@ -97,6 +188,15 @@ public:
     void setRefractiveIndex(float ri) { refractiveIndex = ri; }
     float getRefractiveIndex() const { return refractiveIndex; }
     
+    // Fast path for static meshes under static lights: smooth lighting is evaluated per
+    // vertex once and reused until the lights (SV_LightsVersion) or the world matrix
+    // change. Diffuse only, since specular depends on the camera.
+    void setStaticLighting(bool enable) {
+        staticLighting = enable;
+        bakedLight.clear();
+    }
+    bool getStaticLighting() const { return staticLighting; }
+    
     // Update - handle auto rotation
     void update(float dt) override {
         if (rotationSpeed != 0.0f) {
@@ -104,52 +204,176 @@ public:
         }
     }
     
-    // Render the mesh
+    // Render the mesh with its own world matrix
     void render() override {
         if (!visible || indices.empty()) return;
+        PROFILE_SCOPE("MaterialMesh::render");
+        submit(getRenderMatrix());
+    }
+    
+    // Queue (or draw right away when no queue is recording) with a given world matrix.
+    // lod < 0 picks the level from the projected size (see selectLod).
+    void submit(const matrix4x4& world, int lod = -1);
+    
+    // Coarsest LOD whose geometric error projects to under g_LodErrorPixels,
+    // measured at the point of the bounding sphere nearest the camera
+    int selectLod(const matrix4x4& world) const {
+        if (lods.empty()) return 0;
+        float scale = matrixMaxScale(world);
+        vec4 center = matrixMultiplicationVec(world, vec4{ boundsCenter.x, boundsCenter.y, boundsCenter.z, 1.0f });
+        vec4 view = matrixMultiplicationVec(SV_ViewMatrix, center);
+        float nearest = view.z - boundsRadius * scale;
+        if (nearest <= SV_NearPlane) return 0;
         
-        // Set world matrix for this object
-        SV_WorldMatrix = getWorldMatrix();
+        float pixelsPerUnit = SV_ProjectionMatrix.axisY.y * RASTER_HEIGHT * 0.5f * scale / nearest;
+        int lod = 0;
+        while (lod + 1 < getLodCount() && getLodError(lod + 1) * pixelsPerUnit < g_LodErrorPixels) lod++;
+        return lod;
+    }
+    
+    // Draw this mesh once per instance in a single batched call. Instances carry their
+    // own world matrix and color; this object's transform is not applied. Drawn
+    // immediately (not through the render queue).
+    void drawInstanced(const InstanceTransform* instances, size_t count) {
+        if (!visible || indices.empty() || count == 0 || !g_RenderCallbacks.drawInstanced) return;
+        PROFILE_SCOPE("MaterialMesh::drawInstanced");
         
-        // Get color as unsigned int
-        unsigned int meshColor = colorToUint(color);
+        InstancedDraw batch;
+        batch.vertices = vertices.data();
+        batch.vertexCount = vertices.size();
+        batch.indices = indices.data();
+        batch.indexCount = indices.size();
+        if (useTexture) {
+            batch.texture = texture ? texture : g_RenderCallbacks.texture;
+            batch.texWidth = texture ? texWidth : g_RenderCallbacks.texWidth;
+            batch.texHeight = texture ? texHeight : g_RenderCallbacks.texHeight;
+        }
+        batch.boundsCenter = boundsCenter;
+        batch.boundsRadius = boundsRadius;
+        batch.instances = instances;
+        batch.instanceCount = count;
         
-        // Determine texture to use
-        const unsigned int* tex = useTexture ? (texture ? texture : g_RenderCallbacks.texture) : nullptr;
-        int tw = useTexture ? (texture ? texWidth : g_RenderCallbacks.texWidth) : 0;
-        int th = useTexture ? (texture ? texHeight : g_RenderCallbacks.texHeight) : 0;
+        if (g_RenderCallbacks.useGPU && batch.texture) {
+            g_RenderCallbacks.flushAndChangeTexture(batch.texture, batch.texWidth, batch.texHeight);
+        }
+        g_RenderCallbacks.drawInstanced(batch);
+    }
+    
+    // Draw a queued item immediately
+    void draw(const DrawItem& item) {
+        PROFILE_SCOPE("MaterialMesh::draw");
+        SV_WorldMatrix = item.world;
+        const std::vector<unsigned int>& lodIndices = getLodIndices(item.lod);
         
-        // If using GPU and this object has its own texture, flush previous batch and upload new
-        if (g_RenderCallbacks.useGPU && useTexture && tex) {
-            g_RenderCallbacks.flushAndChangeTexture(tex, tw, th);
+        // Baked lighting is read by the CPU rasterizer's indexed path
+        if (staticLighting && g_SmoothLighting && !g_RenderCallbacks.useGPU && !vertices.empty() && hasNormal(vertices[0])) {
+            bakeLighting(item.world);
+            SV_BakedVertexLight = bakedLight.data();
+        }
+        
+        // Full detail with meshlets: only the clusters that survive culling are drawn
+        if (item.lod == 0 && !meshlets.empty()) {
+            cullMeshlets(item.world);
+            for (const IndexRange& r : visibleRanges) {
+                drawIndexRange(item, lodIndices.data() + r.offset, r.count);
+            }
+        } else {
+            drawIndexRange(item, lodIndices.data(), lodIndices.size());
+        }
+        SV_BakedVertexLight = nullptr;
+    }
+    
+private:
+    struct IndexRange {
+        unsigned int offset;
+        unsigned int count;
+    };
+    std::vector<IndexRange> visibleRanges;  // Scratch for draw()
+    
+    // Recompute bakedLight when the lights or the placement changed since the last bake
+    void bakeLighting(const matrix4x4& world) {
+        if (!bakedLight.empty() && bakedVersion == SV_LightsVersion &&
+            memcmp(&bakedWorld, &world, sizeof(matrix4x4)) == 0) {
+            return;
+        }
+        PROFILE_SCOPE("MaterialMesh::bakeLighting");
+        matrix3x3 normalMat = normalMatrix(world);
+        bakedLight.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            vec4 p = matrixMultiplicationVec(world, vertices[i].pos);
+            bakedLight[i] = calculateVertexLighting({ p.x, p.y, p.z }, transformNormal(normalMat, vertices[i].normal), nullptr);
+        }
+        g_RenderStats.vertexLightings += vertices.size();
+        bakedVersion = SV_LightsVersion;
+        bakedWorld = world;
+    }
+    
+    // Frustum (bounding sphere) and back-face (normal cone) tests per meshlet, in world
+    // space. Neighboring survivors are merged into one range.
+    void cullMeshlets(const matrix4x4& world) {
+        visibleRanges.clear();
+        float scale = matrixMaxScale(world);
+        vec3 camera = cameraWorldPosition();
+        int culled = 0;
+        for (const Meshlet& m : meshlets) {
+            vec4 c = matrixMultiplicationVec(world, vec4{ m.center.x, m.center.y, m.center.z, 1.0f });
+            vec3 center = { c.x, c.y, c.z };
+            float radius = m.radius * scale;
+            if (!sphereInViewFrustum(center, radius)) {
+                culled++;
+                continue;
+            }
+            if (m.hasCone) {
+                vec4 a = matrixMultiplicationVec(world, vec4{ m.coneAxis.x, m.coneAxis.y, m.coneAxis.z, 0.0f });
+                vec3 axis = vec3Normalize({ a.x, a.y, a.z });
+                if (meshletBackFacing(m, center, axis, radius, camera)) {
+                    culled++;
+                    continue;
+                }
+            }
+            if (!visibleRanges.empty() && visibleRanges.back().offset + visibleRanges.back().count == m.indexOffset) {
+                visibleRanges.back().count += m.indexCount;
+            } else {
+                visibleRanges.push_back({ m.indexOffset, m.indexCount });
+            }
+        }
+        g_RenderStats.clustersTested += meshlets.size();
+        g_RenderStats.clustersCulled += culled;
+    }
+    
+    void drawIndexRange(const DrawItem& item, const unsigned int* indexList, size_t indexCount) {
+        // CPU path: hand the whole index list over so the rasterizer picks its variant once
+        if (!g_RenderCallbacks.useGPU && g_RenderCallbacks.drawTrianglesCPU) {
+            g_RenderCallbacks.drawTrianglesCPU(vertices.data(), indexList, indexCount,
+                                               item.texture, item.texWidth, item.texHeight, item.color);
+            return;
         }
         
         // Render each triangle
-        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
-            vertex v0 = vertices[indices[i]];
-            vertex v1 = vertices[indices[i + 1]];
-            vertex v2 = vertices[indices[i + 2]];
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            vertex v0 = vertices[indexList[i]];
+            vertex v1 = vertices[indexList[i + 1]];
+            vertex v2 = vertices[indexList[i + 2]];
             
             // Apply mesh color to vertices
-            v0.color = v1.color = v2.color = meshColor;
+            v0.color = v1.color = v2.color = item.color;
             
             if (g_RenderCallbacks.useGPU) {
                 // GPU rendering
-                if (useTexture && tex && g_RenderCallbacks.drawTexturedTriangleGPU) {
+                if (item.texture && g_RenderCallbacks.drawTexturedTriangleGPU) {
                     g_RenderCallbacks.drawTexturedTriangleGPU(v0, v1, v2);
                 } else if (g_RenderCallbacks.drawTriangleGPU) {
-                    g_RenderCallbacks.drawTriangleGPU(v0, v1, v2, meshColor);
+                    g_RenderCallbacks.drawTriangleGPU(v0, v1, v2, item.color);
                 }
             } else {
                 // CPU rendering
                 if (g_RenderCallbacks.drawTriangleCPU) {
-                    g_RenderCallbacks.drawTriangleCPU(v0, v1, v2, tex, tw, th);
+                    g_RenderCallbacks.drawTriangleCPU(v0, v1, v2, item.texture, item.texWidth, item.texHeight);
                 }
             }
         }
     }
     
-private:
     static unsigned int colorToUint(const vec3& c) {
         unsigned int r = static_cast<unsigned int>(c.x * 255.0f);
         unsigned int g = static_cast<unsigned int>(c.y * 255.0f);
@@ -161,73 +385,93 @@ private:
     }
 };
 
-// ========== OBJECT MANAGER ==========
-// Manages all objects in the scene
-
-class ObjectManager {
-private:
-    std::vector<Object*> objects;
+inline void MaterialMesh::submit(const matrix4x4& world, int lod) {
+    if (!visible || indices.empty()) return;
     
-public:
-    ObjectManager() = default;
+    DrawItem item;
+    item.mesh = this;
+    item.world = world;
+    item.lod = lod < 0 ? selectLod(world) : (std::min)(lod, getLodCount() - 1);
+    item.color = colorToUint(color);
     
-    ~ObjectManager() {
-        clear();
+    // Determine texture to use
+    if (useTexture) {
+        item.texture = texture ? texture : g_RenderCallbacks.texture;
+        item.texWidth = texture ? texWidth : g_RenderCallbacks.texWidth;
+        item.texHeight = texture ? texHeight : g_RenderCallbacks.texHeight;
     }
     
-    // Add object (takes ownership)
-    void addObject(Object* obj) {
-        if (obj) {
-            objects.push_back(obj);
-        }
+    if (g_RenderQueue.isRecording()) {
+        vec4 origin = matrixMultiplicationVec(SV_ViewMatrix, world.axisW);
+        item.depth = origin.z;
+        g_RenderQueue.push(item);
+        return;
     }
     
-    // Remove object
-    void removeObject(Object* obj) {
-        auto it = std::find(objects.begin(), objects.end(), obj);
-        if (it != objects.end()) {
-            delete *it;
-            objects.erase(it);
-        }
+    // Immediate mode: switch GPU texture (flushing the previous batch) if needed
+    if (g_RenderCallbacks.useGPU && item.texture) {
+        g_RenderCallbacks.flushAndChangeTexture(item.texture, item.texWidth, item.texHeight);
     }
+    draw(item);
+}
+
+inline void RenderQueue::flush() {
+    PROFILE_SCOPE("RenderQueue::flush");
+    recording = false;
     
-    // Clear all objects
-    void clear() {
-        for (auto* obj : objects) {
-            delete obj;
-        }
-        objects.clear();
+    order.clear();
+    order.reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        const DrawItem& item = items[i];
+        order.push_back({ textureGroupFor(item.texture), item.color, item.depth, (unsigned int)i });
     }
     
-    // Update all objects
-    void updateAll(float dt) {
-        for (auto* obj : objects) {
-            obj->update(dt);
-        }
-    }
+    // Texture first (fewest state changes), then material, then front-to-back
+    std::sort(order.begin(), order.end(), [](const SortEntry& a, const SortEntry& b) {
+        if (a.textureGroup != b.textureGroup) return a.textureGroup < b.textureGroup;
+        if (a.color != b.color) return a.color < b.color;
+        return a.depth < b.depth;
+    });
+    
+    lastDrawCount = (int)items.size();
+    lastTextureGroups = (int)textureGroups.size();
+    lastTextureSwitches = 0;
     
-    // Render all objects
-    void renderAll() {
-        for (auto* obj : objects) {
-            if (obj->isVisible()) {
-                obj->render();
+    if (!g_RenderCallbacks.useGPU) {
+        // CPU: no texture binding; the whole queue runs once per raster pass
+        auto drawAll = [&]() {
+            for (const SortEntry& entry : order) items[entry.item].mesh->draw(items[entry.item]);
+        };
+        if (g_MsaaMode && g_RenderCallbacks.resolveMsaaCPU) {
+            g_MsaaBuffer.begin();
+            drawAll();
+            g_RenderCallbacks.resolveMsaaCPU();
+        } else if (g_VisibilityBufferMode && g_RenderCallbacks.resolveVisibilityCPU) {
+            g_VisibilityBuffer.begin();
+            drawAll();
+            g_RenderCallbacks.resolveVisibilityCPU();
+            if (g_VisibilityBuffer.hasSkippedDraws()) {
+                g_RasterPass = RasterPass::NonOpaque;
+                drawAll();
+                g_RasterPass = RasterPass::Single;
             }
+        } else {
+            DrawWithDepthPrepass(drawAll);
+        }
+    } else {
+        const unsigned int* boundTexture = nullptr;
+        for (const SortEntry& entry : order) {
+            DrawItem& item = items[entry.item];
+            if (item.texture && item.texture != boundTexture) {
+                lastTextureSwitches++;
+                g_RenderCallbacks.flushAndChangeTexture(item.texture, item.texWidth, item.texHeight);
+                boundTexture = item.texture;
+            }
+            item.mesh->draw(item);
         }
     }
     
-    // Get object count
-    size_t getObjectCount() const { return objects.size(); }
-    
-    // Get object by index
-    Object* getObject(size_t index) {
-        return (index < objects.size()) ? objects[index] : nullptr;
-    }
-    
-    // Get all objects (for iteration)
-    const std::vector<Object*>& getObjects() const { return objects; }
-};
-
-// Global object manager
-inline ObjectManager g_ObjectManager;
+    items.clear();
+}
 
 } // namespace game
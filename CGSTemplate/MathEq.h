@@ -1,6 +1,8 @@
 #pragma once
 #include "Defines.h"
 #include "Windows.h"
+#include <algorithm>
+#include <cmath>
 
 float degreetoRadians(float degrees);
 
@@ -167,6 +169,62 @@ matrix4x4 matrixRotationZ(float rotZ) {
     return Z;
 }
 
+// Same result as Scale * RotationX * RotationY * RotationZ * Translation built from the
+// matrices above (angles in degrees), written out in closed form: one sin/cos per axis
+// and no matrix multiplies.
+matrix4x4 matrixComposeSRT(const vec3& pos, const vec3& rotDegrees, const vec3& scale) {
+    float rx = degreetoRadians(rotDegrees.x);
+    float ry = degreetoRadians(rotDegrees.y);
+    float rz = degreetoRadians(rotDegrees.z);
+    float sx = sinf(rx), cx = cosf(rx);
+    float sy = sinf(ry), cy = cosf(ry);
+    float sz = sinf(rz), cz = cosf(rz);
+
+    matrix4x4 m;
+    m.xx = scale.x * (cy * cz);
+    m.xy = scale.x * (-cy * sz);
+    m.xz = scale.x * sy;
+    m.xw = 0;
+    m.yx = scale.y * (sx * sy * cz + cx * sz);
+    m.yy = scale.y * (cx * cz - sx * sy * sz);
+    m.yz = scale.y * (-sx * cy);
+    m.yw = 0;
+    m.zx = scale.z * (sx * sz - cx * sy * cz);
+    m.zy = scale.z * (cx * sy * sz + sx * cz);
+    m.zz = scale.z * (cx * cy);
+    m.zw = 0;
+    m.wx = pos.x;
+    m.wy = pos.y;
+    m.wz = pos.z;
+    m.ww = 1;
+    return m;
+}
+
+// a * b for affine matrices (last column 0,0,0,1): 36 multiplies instead of 64
+matrix4x4 matrixMultiplyAffine(const matrix4x4& a, const matrix4x4& b) {
+    matrix4x4 r;
+    for (int i = 0; i < 4; i++) {
+        float x = a.m[i][0], y = a.m[i][1], z = a.m[i][2];
+        r.m[i][0] = x * b.m[0][0] + y * b.m[1][0] + z * b.m[2][0];
+        r.m[i][1] = x * b.m[0][1] + y * b.m[1][1] + z * b.m[2][1];
+        r.m[i][2] = x * b.m[0][2] + y * b.m[1][2] + z * b.m[2][2];
+        r.m[i][3] = 0;
+    }
+    r.wx += b.wx;
+    r.wy += b.wy;
+    r.wz += b.wz;
+    r.ww = 1;
+    return r;
+}
+
+// Largest axis scale of a matrix (for scaling bounding-sphere radii)
+float matrixMaxScale(const matrix4x4& m) {
+    float sx = m.xx * m.xx + m.xy * m.xy + m.xz * m.xz;
+    float sy = m.yx * m.yx + m.yy * m.yy + m.yz * m.yz;
+    float sz = m.zx * m.zx + m.zy * m.zy + m.zz * m.zz;
+    return sqrtf((std::max)(sx, (std::max)(sy, sz)));
+}
+
 float Lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "Object.h"
 #include "Defines.h"
+#include "MeshOptimize.h"
+#include "Meshlets.h"
+#include "MeshSimplify.h"
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 namespace game {
@@ -11,11 +16,31 @@ protected:
     std::vector<vertex> vertices;
     std::vector<unsigned int> indices;  // Triangles as index triplets
     
+    // Local-space bounding box and sphere (recomputed when the geometry changes)
+    vec3 boundsMin = { 0.0f, 0.0f, 0.0f };
+    vec3 boundsMax = { 0.0f, 0.0f, 0.0f };
+    vec3 boundsCenter = { 0.0f, 0.0f, 0.0f };
+    float boundsRadius = 0.0f;
+    
+    // Simplified levels of detail (LOD 1+); LOD 0 is `indices`. All levels index
+    // the same vertex array.
+    struct LodLevel {
+        std::vector<unsigned int> indices;
+        float error = 0.0f;  // Geometric error in model units
+    };
+    std::vector<LodLevel> lods;
+    
+    // Clusters of the LOD 0 index buffer (empty: the mesh is drawn as one block)
+    std::vector<Meshlet> meshlets;
+    
 public:
     Mesh() : Object() {}
     
     Mesh(const std::vector<vertex>& verts, const std::vector<unsigned int>& inds)
-        : Object(), vertices(verts), indices(inds) {}
+        : Object(), vertices(verts), indices(inds) {
+        computeBounds();
+        if (!hasNormals()) computeNormals();
+    }
     
     virtual ~Mesh() = default;
     
@@ -23,6 +48,11 @@ public:
     void setGeometry(const std::vector<vertex>& verts, const std::vector<unsigned int>& inds) {
         vertices = verts;
         indices = inds;
+        lods.clear();
+        meshlets.clear();
+        computeBounds();
+        markChanged();
+        if (!hasNormals()) computeNormals();
     }
     
     // Get geometry
@@ -33,6 +63,76 @@ public:
     // Get vertex by index
     const vertex& getVertex(size_t idx) const { return vertices[idx]; }
     
+    // Every vertex carries a normal (smooth lighting is used for the mesh)
+    bool hasNormals() const {
+        for (const vertex& v : vertices) {
+            if (!hasNormal(v)) return false;
+        }
+        return !vertices.empty();
+    }
+    
+    // Vertex normals from the faces using each vertex, weighted by face area. Vertices are
+    // not welded first, so split vertices (UV seams, the cube's faces) keep hard edges.
+    void computeNormals() {
+        for (vertex& v : vertices) v.normal = { 0.0f, 0.0f, 0.0f };
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const vec4& a = vertices[indices[i]].pos;
+            const vec4& b = vertices[indices[i + 1]].pos;
+            const vec4& c = vertices[indices[i + 2]].pos;
+            vec3 e1 = { b.x - a.x, b.y - a.y, b.z - a.z }, e2 = { c.x - a.x, c.y - a.y, c.z - a.z };
+            vec3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+            for (int k = 0; k < 3; k++) {
+                vec3& sum = vertices[indices[i + k]].normal;
+                sum = { sum.x + n.x, sum.y + n.y, sum.z + n.z };
+            }
+        }
+        for (vertex& v : vertices) {
+            float len = sqrtf(v.normal.x * v.normal.x + v.normal.y * v.normal.y + v.normal.z * v.normal.z);
+            v.normal = len > 0.0f ? vec3{ v.normal.x / len, v.normal.y / len, v.normal.z / len } : vec3{ 0.0f, 0.0f, 0.0f };
+        }
+    }
+    
+    // Build the LOD chain, each level simplified from the previous one to a fraction
+    // of the full triangle count and reordered for the vertex cache. Levels that fail
+    // to shrink are not kept.
+    void generateLods(const std::vector<float>& ratios = { 0.5f, 0.25f, 0.1f }) {
+        lods.clear();
+        lods.reserve(ratios.size());  // `source` points into lods
+        const std::vector<unsigned int>* source = &indices;
+        float error = 0.0f;
+        for (float ratio : ratios) {
+            size_t target = (size_t)(getTriangleCount() * ratio) * 3;
+            SimplifyResult r = simplifyMesh(vertices.data(), vertices.size(), source->data(), source->size(), target);
+            if (r.indices.empty() || r.indices.size() >= source->size()) break;
+            error = (std::max)(error, r.error);
+            optimizeVertexCache(r.indices.data(), r.indices.size(), vertices.size(), vertices.data());
+            lods.push_back({ std::move(r.indices), error });
+            source = &lods.back().indices;
+        }
+    }
+    
+    // Split LOD 0 into meshlets (regroups the index buffer)
+    void generateMeshlets() {
+        meshlets = buildMeshlets(vertices.data(), vertices.size(), indices);
+    }
+    
+    // Meshlets already built over this mesh's LOD 0 index buffer
+    void setMeshlets(std::vector<Meshlet> built) {
+        meshlets = std::move(built);
+    }
+    
+    const std::vector<Meshlet>& getMeshlets() const { return meshlets; }
+    
+    int getLodCount() const { return 1 + (int)lods.size(); }
+    const std::vector<unsigned int>& getLodIndices(int lod) const { return lod <= 0 ? indices : lods[lod - 1].indices; }
+    size_t getLodTriangleCount(int lod) const { return getLodIndices(lod).size() / 3; }
+    float getLodError(int lod) const { return lod <= 0 ? 0.0f : lods[lod - 1].error; }
+    
+    const vec3& getBoundsCenter() const { return boundsCenter; }
+    float getBoundsRadius() const { return boundsRadius; }
+    const vec3& getBoundsMin() const { return boundsMin; }
+    const vec3& getBoundsMax() const { return boundsMax; }
+    
     // Override in derived classes
     void render() override {
         // Base mesh doesn't render - see MaterialMesh
@@ -42,6 +142,34 @@ public:
         // Default: no-op, override for animated meshes
     }
     
+protected:
+    // Sphere around the AABB center (cheap and tight enough for culling)
+    void computeBounds() {
+        if (vertices.empty()) {
+            boundsMin = boundsMax = { 0.0f, 0.0f, 0.0f };
+            boundsCenter = { 0.0f, 0.0f, 0.0f };
+            boundsRadius = 0.0f;
+            return;
+        }
+        vec3 lo = { vertices[0].pos.x, vertices[0].pos.y, vertices[0].pos.z };
+        vec3 hi = lo;
+        for (const vertex& v : vertices) {
+            lo.x = (std::min)(lo.x, v.pos.x); hi.x = (std::max)(hi.x, v.pos.x);
+            lo.y = (std::min)(lo.y, v.pos.y); hi.y = (std::max)(hi.y, v.pos.y);
+            lo.z = (std::min)(lo.z, v.pos.z); hi.z = (std::max)(hi.z, v.pos.z);
+        }
+        boundsMin = lo;
+        boundsMax = hi;
+        boundsCenter = { (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+        float r2 = 0.0f;
+        for (const vertex& v : vertices) {
+            float dx = v.pos.x - boundsCenter.x, dy = v.pos.y - boundsCenter.y, dz = v.pos.z - boundsCenter.z;
+            r2 = (std::max)(r2, dx * dx + dy * dy + dz * dz);
+        }
+        boundsRadius = sqrtf(r2);
+    }
+    
+public:
     // Static factory methods for common primitives
     static std::vector<vertex> createCubeVertices();
     static std::vector<unsigned int> createCubeIndices();
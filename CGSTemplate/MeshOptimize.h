@@ -0,0 +1,248 @@
+#pragma once
+#include "Defines.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Import-time index/vertex buffer reordering.
+//  - optimizeVertexCache: Tipsify (Sander, Nehab & Barczak 2007) triangle order for a
+//    FIFO post-transform cache of VERTEX_CACHE_SIZE entries (the cache in DrawTriangles),
+//    then clusters of that order sorted outer-surface first so fewer pixels are overdrawn
+//  - sortClustersForOverdraw: that cluster order, also used for meshlets
+//  - optimizeVertexFetch: vertices renumbered in first-use order for linear fetches
+//  - computeACMR: average cache misses per triangle of an index buffer
+//  - weldPositions: one id per distinct vertex position (shared by the mesh tools)
+
+// Cache misses per triangle for a FIFO cache (0.5 is the best a regular grid gets,
+// 3.0 means no reuse at all)
+inline float computeACMR(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                         int cacheSize = VERTEX_CACHE_SIZE) {
+    if (indexCount < 3) return 0.0f;
+    // A vertex is cached while fewer than cacheSize misses happened since its own miss
+    std::vector<size_t> missStamp(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        if (missStamp[v] == 0 || misses - missStamp[v] >= (size_t)cacheSize) {
+            misses++;
+            missStamp[v] = misses;
+        }
+    }
+    return (float)misses / (float)(indexCount / 3);
+}
+
+// Position id of every vertex: vertices at exactly the same position (UV seams, split
+// normals) share one id. positions, when given, receives the position of each id.
+inline std::vector<unsigned int> weldPositions(const vertex* vertices, size_t vertexCount,
+                                               std::vector<vec3>* positions = nullptr) {
+    struct Key {
+        uint32_t bits[3];
+        bool operator==(const Key& o) const { return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2]; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return (size_t)(((uint64_t)k.bits[0] * 73856093u) ^ ((uint64_t)k.bits[1] * 19349663u << 21) ^ ((uint64_t)k.bits[2] * 83492791u << 42));
+        }
+    };
+    std::unordered_map<Key, unsigned int, KeyHash> lookup;
+    lookup.reserve(vertexCount);
+    std::vector<unsigned int> posOf(vertexCount);
+    if (positions) positions->clear();
+    for (size_t v = 0; v < vertexCount; v++) {
+        // + 0.0f turns -0 into +0 so both weld
+        vec3 p = { vertices[v].pos.x + 0.0f, vertices[v].pos.y + 0.0f, vertices[v].pos.z + 0.0f };
+        Key key;
+        memcpy(key.bits, &p, sizeof(key.bits));
+        auto inserted = lookup.emplace(key, (unsigned int)lookup.size());
+        posOf[v] = inserted.first->second;
+        if (positions && inserted.second) positions->push_back(p);
+    }
+    return posOf;
+}
+
+// Draw order for clusters of consecutive triangles (cluster c holds triangles
+// firstTriangle[c] up to firstTriangle[c + 1]): clusters facing away from the mesh center
+// (the outer surface, which occludes the rest) go first. Returns cluster numbers.
+inline std::vector<size_t> sortClustersForOverdraw(const unsigned int* indices, const vertex* vertices,
+                                                   const std::vector<size_t>& firstTriangle) {
+    size_t clusterCount = firstTriangle.empty() ? 0 : firstTriangle.size() - 1;
+    std::vector<vec3> centroid(clusterCount), normal(clusterCount);
+    std::vector<float> occlusion(clusterCount, 0.0f);
+    vec3 meshCenter = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    
+    for (size_t c = 0; c < clusterCount; c++) {
+        vec3 center = { 0.0f, 0.0f, 0.0f }, n = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = firstTriangle[c]; t < firstTriangle[c + 1]; t++) {
+            const vec4& a = vertices[indices[t * 3]].pos;
+            const vec4& b = vertices[indices[t * 3 + 1]].pos;
+            const vec4& d = vertices[indices[t * 3 + 2]].pos;
+            vec3 e1 = { b.x - a.x, b.y - a.y, b.z - a.z }, e2 = { d.x - a.x, d.y - a.y, d.z - a.z };
+            vec3 fn = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+            float w = 0.5f * sqrtf(fn.x * fn.x + fn.y * fn.y + fn.z * fn.z);
+            n.x += fn.x; n.y += fn.y; n.z += fn.z;
+            center.x += w * (a.x + b.x + d.x) / 3.0f;
+            center.y += w * (a.y + b.y + d.y) / 3.0f;
+            center.z += w * (a.z + b.z + d.z) / 3.0f;
+            area += w;
+        }
+        meshCenter.x += center.x; meshCenter.y += center.y; meshCenter.z += center.z;
+        meshArea += area;
+        if (area > 0.0f) center = { center.x / area, center.y / area, center.z / area };
+        float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+        if (len > 0.0f) n = { n.x / len, n.y / len, n.z / len };
+        centroid[c] = center;
+        normal[c] = n;
+    }
+    if (meshArea > 0.0f) meshCenter = { meshCenter.x / meshArea, meshCenter.y / meshArea, meshCenter.z / meshArea };
+    
+    // Winding decides whether face normals point out or in; take the majority
+    float total = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        vec3 d = { centroid[c].x - meshCenter.x, centroid[c].y - meshCenter.y, centroid[c].z - meshCenter.z };
+        occlusion[c] = d.x * normal[c].x + d.y * normal[c].y + d.z * normal[c].z;
+        total += occlusion[c] * (float)(firstTriangle[c + 1] - firstTriangle[c]);
+    }
+    if (total < 0.0f) {
+        for (float& o : occlusion) o = -o;
+    }
+    
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return occlusion[a] > occlusion[b];
+    });
+    return order;
+}
+
+// Reorder triangles in place. vertices supply positions for the overdraw ordering; pass
+// nullptr to keep the pure Tipsify order.
+inline void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                const vertex* vertices = nullptr, int cacheSize = VERTEX_CACHE_SIZE) {
+    size_t triCount = indexCount / 3;
+    if (triCount < 2 || vertexCount == 0) return;
+    
+    // Vertex -> triangle adjacency (CSR) and live triangle counts
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (size_t i = 0; i < triCount * 3; i++) live[indices[i]]++;
+    std::vector<unsigned int> offset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) offset[v + 1] = offset[v] + live[v];
+    std::vector<unsigned int> adjacency(triCount * 3);
+    {
+        std::vector<unsigned int> fill(offset.begin(), offset.end() - 1);
+        for (size_t i = 0; i < triCount * 3; i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+    
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<unsigned char> emitted(triCount, 0);
+    std::vector<unsigned int> deadEnd;    // Recently referenced vertices
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;      // Output triangles
+    std::vector<size_t> clusterStart;     // Positions in order where a cluster begins
+    order.reserve(triCount);
+    
+    int time = cacheSize + 1;
+    size_t cursor = 0;
+    int fanning = 0;
+    
+    // Clusters end where Tipsify has to jump (dead end) or, for overdraw, wherever the
+    // cluster so far already reuses the cache well enough that a split costs little
+    const float SPLIT_ACMR = 0.75f;
+    const size_t MIN_CLUSTER_TRIANGLES = 128;
+    size_t clusterMisses = 0;
+    clusterStart.push_back(0);
+    
+    while (fanning >= 0) {
+        candidates.clear();
+        for (unsigned int k = offset[fanning]; k < offset[fanning + 1]; k++) {
+            unsigned int t = adjacency[k];
+            if (emitted[t]) continue;
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = indices[t * 3 + c];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                    clusterMisses++;
+                }
+            }
+            emitted[t] = 1;
+            order.push_back(t);
+        }
+        
+        // Next fanning vertex: the candidate that stays in the cache longest while its
+        // remaining triangles are emitted
+        int next = -1;
+        int best = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0) continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * (int)live[v] <= cacheSize) priority = time - cacheTime[v];
+            if (priority > best) {
+                best = priority;
+                next = (int)v;
+            }
+        }
+        
+        bool jump = next < 0;
+        if (jump) {
+            while (!deadEnd.empty() && next < 0) {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) next = (int)v;
+            }
+            while (next < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) next = (int)cursor;
+                cursor++;
+            }
+        }
+        
+        size_t clusterTris = order.size() - clusterStart.back();
+        bool cheapSplit = clusterTris >= MIN_CLUSTER_TRIANGLES && (float)clusterMisses / clusterTris < SPLIT_ACMR;
+        if (next >= 0 && clusterTris > 0 && (jump || cheapSplit)) {
+            clusterStart.push_back(order.size());
+            clusterMisses = 0;
+        }
+        fanning = next;
+    }
+    clusterStart.push_back(order.size());
+    
+    std::vector<unsigned int> result(triCount * 3);
+    for (size_t i = 0; i < triCount; i++) {
+        result[i * 3] = indices[order[i] * 3];
+        result[i * 3 + 1] = indices[order[i] * 3 + 1];
+        result[i * 3 + 2] = indices[order[i] * 3 + 2];
+    }
+    std::copy(result.begin(), result.end(), indices);
+    
+    // Overdraw: clusters of the Tipsify order regrouped outer surface first
+    if (vertices && clusterStart.size() > 2) {
+        std::vector<size_t> clusterOrder = sortClustersForOverdraw(indices, vertices, clusterStart);
+        unsigned int* out = indices;
+        for (size_t c : clusterOrder) {
+            out = std::copy(result.begin() + clusterStart[c] * 3, result.begin() + clusterStart[c + 1] * 3, out);
+        }
+    }
+}
+
+// Renumber vertices in the order the index buffer first uses them. Unreferenced
+// vertices are dropped.
+inline void optimizeVertexFetch(std::vector<vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int& idx : indices) {
+        if (remap[idx] == UNUSED) {
+            remap[idx] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[idx]);
+        }
+        idx = remap[idx];
+    }
+    vertices.swap(reordered);
+}
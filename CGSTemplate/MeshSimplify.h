@@ -0,0 +1,263 @@
+#pragma once
+#include "Defines.h"
+#include "MeshOptimize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Quadric edge-collapse simplification (Garland & Heckbert) for LOD generation.
+// Works on the index buffer only: every collapse moves a vertex onto an existing
+// neighbor, so all LODs share the original vertex array (no new vertices, UVs kept).
+// Vertices that share a position (UV seams) are collapsed together, and border or seam
+// positions may only slide along their border/seam so silhouettes and UV islands hold.
+
+struct SimplifyResult {
+    std::vector<unsigned int> indices;
+    float error = 0.0f;  // Largest RMS distance (model units) introduced by any collapse
+};
+
+namespace simplify_detail {
+
+// Symmetric 4x4 quadric plus the total weight of the planes it holds
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double w = 0;
+    
+    void addPlane(double a, double b, double c, double d, double weight) {
+        a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+        b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+        c2 += weight * c * c; cd += weight * c * d;
+        d2 += weight * d * d;
+        w += weight;
+    }
+    
+    // Weighted sum of squared distances from p to the planes
+    double eval(const vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z
+                 + d2;
+        return r > 0 ? r : 0;
+    }
+};
+
+inline vec3 sub(const vec3& a, const vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline vec3 cross(const vec3& a, const vec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline float dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline uint64_t edgeKey(unsigned int a, unsigned int b) {
+    if (a > b) std::swap(a, b);
+    return ((uint64_t)a << 32) | b;
+}
+
+} // namespace simplify_detail
+
+// Simplify to at most targetIndexCount indices (best effort: stops early when no valid
+// collapse is left). Degenerate input triangles are dropped.
+inline SimplifyResult simplifyMesh(const vertex* vertices, size_t vertexCount,
+                                   const unsigned int* indices, size_t indexCount,
+                                   size_t targetIndexCount) {
+    using namespace simplify_detail;
+    const double BORDER_WEIGHT = 10.0;
+    
+    SimplifyResult result;
+    result.indices.assign(indices, indices + indexCount);
+    if (indexCount <= targetIndexCount || vertexCount == 0) return result;
+    
+    // Weld vertices that share a position (UV seams) into position ids
+    std::vector<vec3> positions;
+    std::vector<unsigned int> posOf = weldPositions(vertices, vertexCount, &positions);
+    size_t posCount = positions.size();
+    
+    // Vertices of each position (CSR)
+    std::vector<unsigned int> posVertOffset(posCount + 1, 0), posVerts(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) posVertOffset[posOf[v] + 1]++;
+    for (size_t p = 0; p < posCount; p++) posVertOffset[p + 1] += posVertOffset[p];
+    {
+        std::vector<unsigned int> fill(posVertOffset.begin(), posVertOffset.end() - 1);
+        for (size_t v = 0; v < vertexCount; v++) posVerts[fill[posOf[v]]++] = (unsigned int)v;
+    }
+    
+    std::vector<unsigned int>& tris = result.indices;
+    std::vector<Quadric> quadrics(posCount);
+    std::vector<unsigned int> triOffset(posCount + 1), triList;
+    std::vector<unsigned char> border(posCount), seam(posCount), locked(posCount);
+    std::vector<unsigned int> remap(vertexCount);
+    std::unordered_map<uint64_t, int> edgeUse;
+    
+    struct Candidate {
+        double cost;
+        unsigned int from, to;  // Positions
+    };
+    std::vector<Candidate> candidates;
+    
+    // Drop degenerate triangles (two corners on one position)
+    auto compact = [&]() {
+        size_t out = 0;
+        for (size_t t = 0; t + 2 < tris.size(); t += 3) {
+            unsigned int a = tris[t], b = tris[t + 1], c = tris[t + 2];
+            if (posOf[a] == posOf[b] || posOf[b] == posOf[c] || posOf[a] == posOf[c]) continue;
+            tris[out++] = a; tris[out++] = b; tris[out++] = c;
+        }
+        tris.resize(out);
+    };
+    compact();
+    
+    while (tris.size() > targetIndexCount) {
+        size_t triCount = tris.size() / 3;
+        
+        // Position -> triangle adjacency
+        std::fill(triOffset.begin(), triOffset.end(), 0);
+        for (unsigned int idx : tris) triOffset[posOf[idx] + 1]++;
+        for (size_t p = 0; p < posCount; p++) triOffset[p + 1] += triOffset[p];
+        triList.resize(tris.size());
+        {
+            std::vector<unsigned int> fill(triOffset.begin(), triOffset.end() - 1);
+            for (size_t i = 0; i < tris.size(); i++) triList[fill[posOf[tris[i]]]++] = (unsigned int)(i / 3);
+        }
+        
+        // Border edges are used by one triangle; seam positions carry several vertices
+        edgeUse.clear();
+        for (size_t t = 0; t < triCount; t++) {
+            for (int e = 0; e < 3; e++) {
+                edgeUse[edgeKey(posOf[tris[t * 3 + e]], posOf[tris[t * 3 + (e + 1) % 3]])]++;
+            }
+        }
+        std::fill(border.begin(), border.end(), 0);
+        std::fill(seam.begin(), seam.end(), 0);
+        for (size_t p = 0; p < posCount; p++) {
+            unsigned int used = 0;
+            for (unsigned int k = posVertOffset[p]; k < posVertOffset[p + 1]; k++) {
+                unsigned int v = posVerts[k];
+                for (unsigned int j = triOffset[p]; j < triOffset[p + 1]; j++) {
+                    const unsigned int* t = &tris[triList[j] * 3];
+                    if (t[0] == v || t[1] == v || t[2] == v) { used++; break; }
+                }
+            }
+            seam[p] = used > 1;
+        }
+        
+        // Quadrics: face planes weighted by area, plus perpendicular planes along borders
+        std::fill(quadrics.begin(), quadrics.end(), Quadric());
+        for (size_t t = 0; t < triCount; t++) {
+            unsigned int p[3] = { posOf[tris[t * 3]], posOf[tris[t * 3 + 1]], posOf[tris[t * 3 + 2]] };
+            vec3 n = cross(sub(positions[p[1]], positions[p[0]]), sub(positions[p[2]], positions[p[0]]));
+            float len = sqrtf(dot(n, n));
+            if (len <= 0.0f) continue;
+            vec3 un = { n.x / len, n.y / len, n.z / len };
+            double d = -dot(un, positions[p[0]]);
+            for (int k = 0; k < 3; k++) quadrics[p[k]].addPlane(un.x, un.y, un.z, d, len * 0.5);
+            
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = p[e], b = p[(e + 1) % 3];
+                if (edgeUse[edgeKey(a, b)] != 1) continue;
+                border[a] = border[b] = 1;
+                vec3 edge = sub(positions[b], positions[a]);
+                vec3 m = cross(edge, un);
+                float mlen = sqrtf(dot(m, m));
+                if (mlen <= 0.0f) continue;
+                m = { m.x / mlen, m.y / mlen, m.z / mlen };
+                double md = -dot(m, positions[a]);
+                double weight = dot(edge, edge) * BORDER_WEIGHT;
+                quadrics[a].addPlane(m.x, m.y, m.z, md, weight);
+                quadrics[b].addPlane(m.x, m.y, m.z, md, weight);
+            }
+        }
+        
+        // Border/seam positions only slide along an edge of their own kind
+        auto allowed = [&](unsigned int from, unsigned int to) {
+            if (border[from] && (!border[to] || edgeUse[edgeKey(from, to)] != 1)) return false;
+            if (seam[from] && !seam[to]) return false;
+            return true;
+        };
+        auto cost = [&](unsigned int from, unsigned int to) {
+            const Quadric& q = quadrics[from];
+            return q.w > 0 ? q.eval(positions[to]) / q.w : 0.0;
+        };
+        
+        candidates.clear();
+        for (const auto& edge : edgeUse) {
+            unsigned int a = (unsigned int)(edge.first >> 32), b = (unsigned int)(edge.first & 0xFFFFFFFFu);
+            bool ab = allowed(a, b), ba = allowed(b, a);
+            if (!ab && !ba) continue;
+            double cab = ab ? cost(a, b) : 1e300;
+            double cba = ba ? cost(b, a) : 1e300;
+            if (cab <= cba) candidates.push_back({ cab, a, b });
+            else candidates.push_back({ cba, b, a });
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& x, const Candidate& y) {
+            if (x.cost != y.cost) return x.cost < y.cost;
+            return x.from != y.from ? x.from < y.from : x.to < y.to;
+        });
+        
+        for (size_t v = 0; v < vertexCount; v++) remap[v] = (unsigned int)v;
+        std::fill(locked.begin(), locked.end(), 0);
+        size_t removeBudget = triCount - targetIndexCount / 3;
+        size_t removed = 0;
+        int collapses = 0;
+        
+        for (const Candidate& c : candidates) {
+            if (removed >= removeBudget) break;
+            if (locked[c.from] || locked[c.to]) continue;
+            
+            // Each vertex at `from` moves to a vertex at `to` it shares a triangle with
+            bool ok = true;
+            for (unsigned int k = posVertOffset[c.from]; k < posVertOffset[c.from + 1] && ok; k++) {
+                unsigned int v = posVerts[k];
+                unsigned int target = ~0u;
+                bool used = false;
+                for (unsigned int j = triOffset[c.from]; j < triOffset[c.from + 1]; j++) {
+                    const unsigned int* t = &tris[triList[j] * 3];
+                    if (t[0] != v && t[1] != v && t[2] != v) continue;
+                    used = true;
+                    for (int e = 0; e < 3; e++) {
+                        if (posOf[t[e]] == c.to) { target = t[e]; break; }
+                    }
+                    if (target != ~0u) break;
+                }
+                if (!used) continue;
+                if (target == ~0u) ok = false;
+                else remap[v] = target;
+            }
+            
+            // Reject collapses that flip a surviving triangle
+            unsigned int collapsing = 0;
+            for (unsigned int j = triOffset[c.from]; j < triOffset[c.from + 1] && ok; j++) {
+                const unsigned int* t = &tris[triList[j] * 3];
+                unsigned int p[3] = { posOf[t[0]], posOf[t[1]], posOf[t[2]] };
+                if (p[0] == c.to || p[1] == c.to || p[2] == c.to) { collapsing++; continue; }
+                vec3 before = cross(sub(positions[p[1]], positions[p[0]]), sub(positions[p[2]], positions[p[0]]));
+                vec3 q[3] = { positions[p[0]], positions[p[1]], positions[p[2]] };
+                for (int e = 0; e < 3; e++) if (p[e] == c.from) q[e] = positions[c.to];
+                vec3 after = cross(sub(q[1], q[0]), sub(q[2], q[0]));
+                if (dot(before, after) <= 1e-2f * sqrtf(dot(before, before) * dot(after, after))) ok = false;
+            }
+            
+            if (!ok) {
+                for (unsigned int k = posVertOffset[c.from]; k < posVertOffset[c.from + 1]; k++) remap[posVerts[k]] = posVerts[k];
+                continue;
+            }
+            
+            // Lock the 1-ring so later collapses this pass see valid geometry
+            for (unsigned int j = triOffset[c.from]; j < triOffset[c.from + 1]; j++) {
+                const unsigned int* t = &tris[triList[j] * 3];
+                for (int e = 0; e < 3; e++) locked[posOf[t[e]]] = 1;
+            }
+            result.error = (std::max)(result.error, (float)sqrt(c.cost));
+            removed += collapsing;
+            collapses++;
+        }
+        
+        if (collapses == 0) break;
+        for (unsigned int& idx : tris) idx = remap[idx];
+        compact();
+    }
+    
+    return result;
+}
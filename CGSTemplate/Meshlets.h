@@ -0,0 +1,231 @@
+#pragma once
+#include "Defines.h"
+#include "MeshOptimize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Meshlets: a mesh split into small spatially compact clusters so whole clusters can be
+// culled against the frustum (bounding sphere) and for back-facing (normal cone) before
+// any per-triangle work. Each meshlet is a contiguous range of the mesh's index buffer.
+
+constexpr int MESHLET_MAX_TRIANGLES = 128;
+
+struct Meshlet {
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    vec3 center = { 0.0f, 0.0f, 0.0f };  // Bounding sphere (mesh space)
+    float radius = 0.0f;
+    vec3 coneAxis = { 0.0f, 0.0f, 0.0f };  // Average front-facing normal
+    float coneCutoff = 1.0f;               // Sine of the cone half-angle
+    bool hasCone = false;                  // Normals too spread (or mesh open): never back-face culled
+};
+
+namespace meshlet_detail {
+
+inline vec3 faceNormal(const vec4& a, const vec4& b, const vec4& c) {
+    vec3 e1 = { b.x - a.x, b.y - a.y, b.z - a.z }, e2 = { c.x - a.x, c.y - a.y, c.z - a.z };
+    return { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+}
+
+inline float length(const vec3& v) { return sqrtf(v.x * v.x + v.y * v.y + v.z * v.z); }
+
+// Front side of the winding: +1 when cross(b-a, c-a) points out of the volume, -1 when in,
+// 0 when the mesh is too open (more than 1% border edges) for the front side to mean much
+inline float frontFacingSign(const vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    // Weld UV seams so edges across them count as shared
+    std::vector<unsigned int> posOf = weldPositions(vertices, vertexCount);
+    
+    std::unordered_map<uint64_t, int> edges;
+    double volume = 0.0;
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const vec4& a = vertices[indices[t]].pos;
+        const vec4& b = vertices[indices[t + 1]].pos;
+        const vec4& c = vertices[indices[t + 2]].pos;
+        volume += (double)a.x * (b.y * c.z - b.z * c.y) + (double)a.y * (b.z * c.x - b.x * c.z) + (double)a.z * (b.x * c.y - b.y * c.x);
+        for (int e = 0; e < 3; e++) {
+            unsigned int p0 = posOf[indices[t + e]], p1 = posOf[indices[t + (e + 1) % 3]];
+            if (p0 > p1) std::swap(p0, p1);
+            edges[((uint64_t)p0 << 32) | p1]++;
+        }
+    }
+    size_t border = 0;
+    for (const auto& e : edges) border += e.second == 1;
+    if (edges.empty() || border * 100 > edges.size() || volume == 0.0) return 0.0f;
+    return volume > 0.0 ? 1.0f : -1.0f;
+}
+
+} // namespace meshlet_detail
+
+// Split a triangle list into meshlets of up to maxTriangles. Triangles are regrouped
+// in place (each meshlet contiguous, Tipsify order inside it, meshlets ordered for
+// overdraw).
+inline std::vector<Meshlet> buildMeshlets(const vertex* vertices, size_t vertexCount,
+                                          std::vector<unsigned int>& indices,
+                                          int maxTriangles = MESHLET_MAX_TRIANGLES) {
+    using namespace meshlet_detail;
+    std::vector<Meshlet> meshlets;
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0 || vertexCount == 0) return meshlets;
+    
+    float front = frontFacingSign(vertices, vertexCount, indices.data(), indices.size());
+    
+    // Per-triangle unit normals (front side) and centroids
+    std::vector<vec3> normal(triCount), centroid(triCount);
+    for (size_t t = 0; t < triCount; t++) {
+        const vec4& a = vertices[indices[t * 3]].pos;
+        const vec4& b = vertices[indices[t * 3 + 1]].pos;
+        const vec4& c = vertices[indices[t * 3 + 2]].pos;
+        vec3 n = faceNormal(a, b, c);
+        float len = length(n);
+        normal[t] = len > 0.0f ? vec3{ n.x / len * front, n.y / len * front, n.z / len * front } : vec3{ 0.0f, 0.0f, 0.0f };
+        centroid[t] = { (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f };
+    }
+    
+    // Vertex -> triangle adjacency (CSR)
+    std::vector<unsigned int> offset(vertexCount + 1, 0);
+    for (unsigned int idx : indices) offset[idx + 1]++;
+    for (size_t v = 0; v < vertexCount; v++) offset[v + 1] += offset[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(offset.begin(), offset.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+    
+    std::vector<unsigned char> used(triCount, 0);
+    std::vector<unsigned int> inCandidates(triCount, 0);  // Meshlet number + 1 that listed it
+    std::vector<unsigned int> candidates, members, grouped;
+    grouped.reserve(indices.size());
+    size_t cursor = 0;
+    
+    while (true) {
+        // Seed with a free neighbor of the previous meshlet, else the next free triangle
+        int seed = -1;
+        for (unsigned int t : candidates) {
+            if (!used[t]) { seed = (int)t; break; }
+        }
+        while (seed < 0 && cursor < triCount) {
+            if (!used[cursor]) seed = (int)cursor;
+            cursor++;
+        }
+        if (seed < 0) break;
+        
+        unsigned int stamp = (unsigned int)meshlets.size() + 1;
+        members.clear();
+        candidates.clear();
+        vec3 center = centroid[seed], normalSum = { 0.0f, 0.0f, 0.0f };
+        float spread = 0.0f;  // Farthest member centroid from the running center
+        
+        auto add = [&](unsigned int t) {
+            used[t] = 1;
+            members.push_back(t);
+            float k = 1.0f / members.size();
+            center = { center.x + (centroid[t].x - center.x) * k, center.y + (centroid[t].y - center.y) * k, center.z + (centroid[t].z - center.z) * k };
+            normalSum = { normalSum.x + normal[t].x, normalSum.y + normal[t].y, normalSum.z + normal[t].z };
+            vec3 d = { centroid[t].x - center.x, centroid[t].y - center.y, centroid[t].z - center.z };
+            spread = (std::max)(spread, length(d));
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = indices[t * 3 + c];
+                for (unsigned int k2 = offset[v]; k2 < offset[v + 1]; k2++) {
+                    unsigned int n = adjacency[k2];
+                    if (!used[n] && inCandidates[n] != stamp) {
+                        inCandidates[n] = stamp;
+                        candidates.push_back(n);
+                    }
+                }
+            }
+        };
+        add((unsigned int)seed);
+        
+        // Grow with the neighbor that keeps the meshlet round and its normals together
+        while ((int)members.size() < maxTriangles) {
+            float nlen = length(normalSum);
+            vec3 axis = nlen > 0.0f ? vec3{ normalSum.x / nlen, normalSum.y / nlen, normalSum.z / nlen } : vec3{ 0.0f, 0.0f, 0.0f };
+            int best = -1;
+            float bestScore = 1e30f;
+            for (size_t i = 0; i < candidates.size(); i++) {
+                unsigned int t = candidates[i];
+                if (used[t]) continue;
+                vec3 d = { centroid[t].x - center.x, centroid[t].y - center.y, centroid[t].z - center.z };
+                float distance = length(d) / (spread + 1e-6f);
+                float bend = 1.0f - (normal[t].x * axis.x + normal[t].y * axis.y + normal[t].z * axis.z);
+                float score = distance + 2.0f * bend;
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = (int)i;
+                }
+            }
+            if (best < 0) break;
+            unsigned int t = candidates[best];
+            candidates[best] = candidates.back();
+            candidates.pop_back();
+            add(t);
+        }
+        
+        // Emit the meshlet, Tipsify-ordered inside
+        Meshlet m;
+        m.indexOffset = (unsigned int)grouped.size();
+        m.indexCount = (unsigned int)members.size() * 3;
+        for (unsigned int t : members) {
+            grouped.insert(grouped.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+        }
+        optimizeVertexCache(grouped.data() + m.indexOffset, m.indexCount, vertexCount);
+        
+        vec3 lo = { 1e30f, 1e30f, 1e30f }, hi = { -1e30f, -1e30f, -1e30f };
+        for (unsigned int i = m.indexOffset; i < m.indexOffset + m.indexCount; i++) {
+            const vec4& p = vertices[grouped[i]].pos;
+            lo = { (std::min)(lo.x, p.x), (std::min)(lo.y, p.y), (std::min)(lo.z, p.z) };
+            hi = { (std::max)(hi.x, p.x), (std::max)(hi.y, p.y), (std::max)(hi.z, p.z) };
+        }
+        m.center = { (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+        for (unsigned int i = m.indexOffset; i < m.indexOffset + m.indexCount; i++) {
+            const vec4& p = vertices[grouped[i]].pos;
+            m.radius = (std::max)(m.radius, length(vec3{ p.x - m.center.x, p.y - m.center.y, p.z - m.center.z }));
+        }
+        
+        // Normal cone: usable while every normal is within 90 degrees of the axis
+        float nlen = length(normalSum);
+        if (front != 0.0f && nlen > 0.0f) {
+            m.coneAxis = { normalSum.x / nlen, normalSum.y / nlen, normalSum.z / nlen };
+            float minDot = 1.0f;
+            for (unsigned int t : members) {
+                minDot = (std::min)(minDot, normal[t].x * m.coneAxis.x + normal[t].y * m.coneAxis.y + normal[t].z * m.coneAxis.z);
+            }
+            if (minDot > 0.0f) {
+                m.coneCutoff = sqrtf(1.0f - minDot * minDot);
+                m.hasCone = true;
+            }
+        }
+        meshlets.push_back(m);
+    }
+    
+    // Meshlets outer surface first, as optimizeVertexCache orders its clusters, so the
+    // overdraw order survives the regrouping
+    std::vector<size_t> firstTriangle;
+    firstTriangle.reserve(meshlets.size() + 1);
+    for (const Meshlet& m : meshlets) firstTriangle.push_back(m.indexOffset / 3);
+    firstTriangle.push_back(grouped.size() / 3);
+    std::vector<size_t> order = sortClustersForOverdraw(grouped.data(), vertices, firstTriangle);
+    std::vector<Meshlet> sorted;
+    sorted.reserve(meshlets.size());
+    indices.clear();
+    for (size_t c : order) {
+        Meshlet m = meshlets[c];
+        m.indexOffset = (unsigned int)indices.size();
+        indices.insert(indices.end(), grouped.begin() + meshlets[c].indexOffset,
+                       grouped.begin() + meshlets[c].indexOffset + meshlets[c].indexCount);
+        sorted.push_back(m);
+    }
+    return sorted;
+}
+
+// True when every triangle of the meshlet faces away from the camera. center, axis and
+// cameraPos in the same space; radius already scaled to it.
+inline bool meshletBackFacing(const Meshlet& m, const vec3& center, const vec3& axis, float radius, const vec3& cameraPos) {
+    if (!m.hasCone) return false;
+    vec3 d = { center.x - cameraPos.x, center.y - cameraPos.y, center.z - cameraPos.z };
+    float dist = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+    return d.x * axis.x + d.y * axis.y + d.z * axis.z >= m.coneCutoff * dist + radius;
+}
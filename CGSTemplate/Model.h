@@ -6,6 +6,7 @@
 #include <assimp/postprocess.h>
 
 #include "MaterialMesh.h"
+#include "OcclusionBuffer.h"
 #include "stb_image.h"
 #include <string>
 #include <vector>
@@ -35,6 +36,10 @@ private:
     bool useTextures = true;  // Can disable for performance
     int texturesLoaded = 0;   // Count of successfully loaded textures
     int texturesFailed = 0;   // Count of failed texture loads
+    double cacheMissesBefore = 0.0;  // Vertex cache misses of the file order (all meshes)
+    double cacheMissesAfter = 0.0;   // ... and after optimization
+    
+    static constexpr size_t MIN_LOD_TRIANGLES = 256;  // Meshes below this get no LOD chain
     
     void processNode(aiNode* node, const aiScene* scene);
     MaterialMesh* processMesh(aiMesh* mesh, const aiScene* scene);
@@ -68,6 +73,7 @@ public:
     
     // Get mesh count
     size_t getMeshCount() const { return meshes.size(); }
+    MaterialMesh* getMesh(size_t i) { return meshes[i].get(); }
     
     // Get total triangle count
     size_t getTotalTriangles() const {
@@ -92,7 +98,8 @@ public:
     void update(float dt) override;
     
     // Render with triangle budget - returns number of triangles rendered
-    // Pass remaining budget, returns actual triangles drawn
+    // Pass remaining budget, returns actual triangles drawn. Meets the budget by
+    // lowering mesh LODs; meshes are only skipped once all are at their coarsest.
     int renderWithBudget(int remainingBudget);
 };
 
@@ -125,12 +132,17 @@ inline bool Model::loadModel(const std::string& path) {
     loadedTextures.clear();
     texturesLoaded = 0;
     texturesFailed = 0;
+    cacheMissesBefore = cacheMissesAfter = 0.0;
     
     // Process the scene graph
     processNode(scene->mRootNode, scene);
     
     std::cout << "Model loaded: " << name << " (" << meshes.size() << " meshes, " 
               << getTotalTriangles() << " triangles)" << std::endl;
+    if (getTotalTriangles() > 0) {
+        std::cout << "  Vertex cache ACMR " << cacheMissesBefore / getTotalTriangles() << " -> "
+                  << cacheMissesAfter / getTotalTriangles() << std::endl;
+    }
     
     // Note: Model is loaded at origin - user can rotate via UI if needed
     // FBX files often need X-90 rotation to convert from Z-up to Y-up
@@ -144,6 +156,7 @@ inline void Model::processNode(aiNode* node, const aiScene* scene) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         MaterialMesh* processed = processMesh(mesh, scene);
         if (processed) {
+            processed->setParent(this);
             meshes.emplace_back(processed);
         }
     }
@@ -182,6 +195,11 @@ inline MaterialMesh* Model::processMesh(aiMesh* mesh, const aiScene* scene) {
             v.v = 0.0f;
         }
         
+        // Normal (from the file, or generated by aiProcess_GenNormals)
+        if (mesh->mNormals) {
+            v.normal = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+        }
+        
         vertices.push_back(v);
     }
     
@@ -193,8 +211,27 @@ inline MaterialMesh* Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         }
     }
     
+    // Reorder for the post-transform cache and overdraw, split into meshlets (clusters for
+    // per-meshlet culling, once there is more than one), then renumber vertices for fetch
+    // locality. The ACMR after is measured on the index buffer that is actually drawn.
+    size_t triangles = indices.size() / 3;
+    cacheMissesBefore += computeACMR(indices.data(), indices.size(), vertices.size()) * triangles;
+    optimizeVertexCache(indices.data(), indices.size(), vertices.size(), vertices.data());
+    std::vector<Meshlet> meshlets;
+    if (triangles > MESHLET_MAX_TRIANGLES) {
+        meshlets = buildMeshlets(vertices.data(), vertices.size(), indices);
+    }
+    optimizeVertexFetch(vertices, indices);
+    cacheMissesAfter += computeACMR(indices.data(), indices.size(), vertices.size()) * triangles;
+    
     // Create the material mesh
     MaterialMesh* matMesh = new MaterialMesh(vertices, indices);
+    matMesh->setMeshlets(std::move(meshlets));
+    
+    // Simplified levels for distant draws; tiny meshes are not worth it
+    if (matMesh->getTriangleCount() >= MIN_LOD_TRIANGLES) {
+        matMesh->generateLods();
+    }
     
     // Process material / textures
     if (mesh->mMaterialIndex >= 0) {
@@ -315,44 +352,60 @@ inline ModelTexture* Model::loadTexture(const std::string& path) {
 inline void Model::render() {
     if (!visible) return;
     
-    // Apply model transform to all child meshes
-    matrix4x4 modelMatrix = getWorldMatrix();
-    
+    // Meshes are children of the model, so their cached world matrices already include it
     for (auto& mesh : meshes) {
-        // Combine this model's transform with mesh transform
-        matrix4x4 originalWorld = SV_WorldMatrix;
-        matrix4x4 meshWorld = mesh->getWorldMatrix();
-        SV_WorldMatrix = matrixMultiplicationMatrix(modelMatrix, meshWorld);
-        
-        mesh->render();
-        
-        SV_WorldMatrix = originalWorld;
+        matrix4x4 world = mesh->getRenderMatrix();
+        if (!g_OcclusionBuffer.testAABB(mesh->getBoundsMin(), mesh->getBoundsMax(), world)) continue;
+        mesh->submit(world);
     }
 }
 
 inline int Model::renderWithBudget(int remainingBudget) {
     if (!visible) return 0;
     
+    // Start from the screen-size LOD of each mesh, then coarsen the mesh that gives back
+    // the most triangles until the model fits
+    std::vector<int> lod(meshes.size());
+    int total = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        matrix4x4 world = meshes[i]->getRenderMatrix();
+        if (!g_OcclusionBuffer.testAABB(meshes[i]->getBoundsMin(), meshes[i]->getBoundsMax(), world)) {
+            lod[i] = -1;  // Hidden
+            continue;
+        }
+        lod[i] = meshes[i]->selectLod(world);
+        total += (int)meshes[i]->getLodTriangleCount(lod[i]);
+    }
+    
+    while (total > remainingBudget) {
+        int best = -1;
+        int bestSaving = 0;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            if (lod[i] < 0 || lod[i] + 1 >= meshes[i]->getLodCount()) continue;
+            int saving = (int)meshes[i]->getLodTriangleCount(lod[i]) - (int)meshes[i]->getLodTriangleCount(lod[i] + 1);
+            if (saving > bestSaving) {
+                bestSaving = saving;
+                best = (int)i;
+            }
+        }
+        if (best < 0) break;  // Everything is at its coarsest level
+        lod[best]++;
+        total -= bestSaving;
+    }
+    
     int trianglesRendered = 0;
-    matrix4x4 modelMatrix = getWorldMatrix();
     
-    for (auto& mesh : meshes) {
-        int meshTriangles = (int)mesh->getTriangleCount();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (lod[i] < 0) continue;
+        int meshTriangles = (int)meshes[i]->getLodTriangleCount(lod[i]);
         
-        // Skip this mesh if it would exceed budget
+        // Last resort once no LOD is left to lower: skip meshes that do not fit
         if (trianglesRendered + meshTriangles > remainingBudget) {
-            continue;  // Skip this mesh, try next (smaller meshes might fit)
+            continue;
         }
         
-        // Combine this model's transform with mesh transform
-        matrix4x4 originalWorld = SV_WorldMatrix;
-        matrix4x4 meshWorld = mesh->getWorldMatrix();
-        SV_WorldMatrix = matrixMultiplicationMatrix(modelMatrix, meshWorld);
-        
-        mesh->render();
+        meshes[i]->submit(meshes[i]->getRenderMatrix(), lod[i]);
         trianglesRendered += meshTriangles;
-        
-        SV_WorldMatrix = originalWorld;
     }
     
     return trianglesRendered;
@@ -360,6 +413,7 @@ inline int Model::renderWithBudget(int remainingBudget) {
 
 inline void Model::update(float dt) {
     for (auto& mesh : meshes) {
+        mesh->savePreviousTransform();
         mesh->update(dt);
     }
 }
@@ -0,0 +1,62 @@
+#pragma once
+#include "Defines.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// ========== 4x MSAA ==========
+// Coverage-mask multisampling for the CPU rasterizer. Each pixel has four depth/color
+// samples; a triangle tests coverage and depth per sample but is shaded once per pixel,
+// and that color goes to every sample it won. ResolveMsaaBuffer (RasterHelper.h) then
+// averages the samples into SCREEN_ARRAY. Samples of a pixel are stored together and
+// pixels in screen order, so a row band of the image is one contiguous block of every
+// sample buffer.
+
+constexpr int MSAA_SAMPLES = 4;
+// log2(MSAA_SAMPLES): the resolve divides its channel sums by shifting
+constexpr int MSAA_SAMPLE_SHIFT = MSAA_SAMPLES == 8 ? 3 : MSAA_SAMPLES == 4 ? 2 : MSAA_SAMPLES == 2 ? 1 : 0;
+static_assert((1 << MSAA_SAMPLE_SHIFT) == MSAA_SAMPLES, "MSAA_SAMPLES must be 1, 2, 4 or 8 (one written bit per sample)");
+
+// Rotated-grid sample positions relative to the pixel center, in 1/16 pixel (the
+// rasterizer's subpixel units)
+constexpr int MSAA_SAMPLE_X[MSAA_SAMPLES] = { -2, 6, -6, 2 };
+constexpr int MSAA_SAMPLE_Y[MSAA_SAMPLES] = { -6, -2, 2, 6 };
+constexpr int MSAA_SAMPLE_REACH = 6;  // Farthest sample from the center on either axis
+
+inline bool g_MsaaMode = false;  // Opaque and blended CPU draws go through the sample buffers
+
+class MsaaBuffer {
+public:
+    // Start a pass: samples inherit the depth already in DEPTH_ARRAY, none written yet
+    void begin() {
+        size_t pixels = (size_t)NUM_PIXELS;
+        if (written.size() != pixels) {  // Only when the raster size changed
+            depth.resize(pixels * MSAA_SAMPLES);
+            color.resize(pixels * MSAA_SAMPLES);
+            written.resize(pixels);
+        }
+        std::fill(written.begin(), written.end(), (uint8_t)0);
+        for (size_t i = 0; i < pixels; i++) {
+            float z = DEPTH_ARRAY[i];
+            float* d = &depth[i * MSAA_SAMPLES];
+            for (int s = 0; s < MSAA_SAMPLES; s++) d[s] = z;
+        }
+        active = true;
+    }
+    
+    void end() { active = false; }
+    bool isActive() const { return active; }
+    
+    float* getDepth() { return depth.data(); }          // MSAA_SAMPLES per pixel
+    unsigned int* getColor() { return color.data(); }   // MSAA_SAMPLES per pixel
+    uint8_t* getWritten() { return written.data(); }    // Per pixel, bit s: sample s has a color
+
+private:
+    std::vector<float> depth;
+    std::vector<unsigned int> color;
+    std::vector<uint8_t> written;  // Unwritten samples resolve to what SCREEN_ARRAY already holds
+    bool active = false;
+};
+
+// Global sample buffers (begun by whoever draws the multisampled pass)
+inline MsaaBuffer g_MsaaBuffer;
@@ -1,10 +1,26 @@
 #pragma once
 #include "MathEq.h"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 namespace game {
 
-// Base class for all renderable objects in the scene
+// Blend factor between the previous and current fixed-step transforms used while
+// rendering (set by ObjectManager::renderAll; 1 = current state only)
+inline float g_RenderAlpha = 1.0f;
+
+// Fixed simulation steps started so far, and whether one is running (set by
+// ObjectManager::updateAll). Transform changes inside a step are interpolated across it;
+// changes outside one (spawning, teleports, editor moves) show up at once.
+inline uint64_t g_FixedStepIndex = 0;
+inline bool g_InFixedStep = false;
+
+// Base class for all renderable objects in the scene.
+// Objects form a parent/child hierarchy (non-owning links): the local matrix comes from
+// position/rotation/scale, the world matrix is local * parent world. Both are cached and
+// only rebuilt after a transform change, which marks the whole subtree dirty, so a static
+// hierarchy costs nothing per frame.
 class Object {
 protected:
     vec3 position = { 0.0f, 0.0f, 0.0f };
@@ -13,13 +29,48 @@ protected:
     vec3 color = { 1.0f, 1.0f, 1.0f };
     bool visible = true;
     
-    // Cached world matrix
+    // Transform before the fixed step it last changed in (for render interpolation)
+    vec3 prevPosition;
+    vec3 prevRotation;
+    vec3 prevScale;
+    uint64_t snapshotStep = 0;  // Step the snapshot was taken in (0: not moving)
+    uint64_t spawnStep = 0;     // Step the object was created in (0: outside a step)
+    
+    // Hierarchy
+    Object* parent = nullptr;
+    std::vector<Object*> children;
+    
+    // Cached matrices
+    matrix4x4 localMatrix;
     matrix4x4 worldMatrix;
-    bool matrixDirty = true;
+    bool localDirty = true;
+    bool worldDirty = true;
+    
+    // Set to 1 when the world transform, bounds or visibility change (owned by whoever
+    // keeps a copy of them, e.g. ObjectManager's cull arrays)
+    unsigned char* changeFlag = nullptr;
 
 public:
-    Object() { worldMatrix = MatrixIdentity(); }
-    virtual ~Object() = default;
+    Object() {
+        localMatrix = MatrixIdentity();
+        worldMatrix = MatrixIdentity();
+        prevPosition = position;
+        prevRotation = rotation;
+        prevScale = scale;
+        if (g_InFixedStep) spawnStep = g_FixedStepIndex;
+    }
+    
+    virtual ~Object() {
+        setParent(nullptr);
+        for (Object* child : children) {
+            child->parent = nullptr;
+            child->markWorldDirty();
+        }
+    }
+    
+    // Hierarchy links are identity-based, so objects are not copyable
+    Object(const Object&) = delete;
+    Object& operator=(const Object&) = delete;
     
     // Pure virtual methods - must be implemented by derived classes
     virtual void render() = 0;
@@ -27,38 +78,45 @@ public:
     
     // Transform setters
     void setPosition(const vec3& pos) {
+        beginTransformChange();
         position = pos;
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setPosition(float x, float y, float z) {
+        beginTransformChange();
         position = { x, y, z };
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setRotation(const vec3& rot) {
+        beginTransformChange();
         rotation = rot;
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setRotation(float x, float y, float z) {
+        beginTransformChange();
         rotation = { x, y, z };
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setScale(const vec3& s) {
+        beginTransformChange();
         scale = s;
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setScale(float x, float y, float z) {
+        beginTransformChange();
         scale = { x, y, z };
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setScale(float uniform) {
+        beginTransformChange();
         scale = { uniform, uniform, uniform };
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     void setColor(const vec3& c) {
@@ -69,7 +127,13 @@ public:
         color = { r, g, b };
     }
     
-    void setVisible(bool v) { visible = v; }
+    void setVisible(bool v) {
+        visible = v;
+        markChanged();
+    }
+    
+    // Flag to raise on every change copied elsewhere (nullptr: none)
+    void setChangeFlag(unsigned char* flag) { changeFlag = flag; }
     
     // Transform getters
     const vec3& getPosition() const { return position; }
@@ -78,58 +142,142 @@ public:
     const vec3& getColor() const { return color; }
     bool isVisible() const { return visible; }
     
-    // Get world matrix (recalculates if dirty)
+    // Attach under a new parent (nullptr detaches). The local transform is kept,
+    // so the object moves with its new parent.
+    void setParent(Object* newParent) {
+        if (newParent == parent || newParent == this) return;
+        for (Object* p = newParent; p; p = p->parent) {
+            if (p == this) return;  // Would create a cycle
+        }
+        
+        if (parent) {
+            std::vector<Object*>& siblings = parent->children;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+        }
+        parent = newParent;
+        if (parent) {
+            parent->children.push_back(this);
+        }
+        markWorldDirty();
+    }
+    
+    Object* getParent() const { return parent; }
+    const std::vector<Object*>& getChildren() const { return children; }
+    
+    // Local matrix from position/rotation/scale (recalculates if dirty)
+    const matrix4x4& getLocalMatrix() {
+        if (localDirty) {
+            localMatrix = matrixComposeSRT(position, rotation, scale);
+            localDirty = false;
+        }
+        return localMatrix;
+    }
+    
+    // Get world matrix (recalculates if this object or an ancestor changed)
     const matrix4x4& getWorldMatrix() {
-        if (matrixDirty) {
-            updateWorldMatrix();
+        if (worldDirty) {
+            if (parent) {
+                worldMatrix = matrixMultiplyAffine(getLocalMatrix(), parent->getWorldMatrix());
+            } else {
+                worldMatrix = getLocalMatrix();
+            }
+            worldDirty = false;
         }
         return worldMatrix;
     }
     
+    // Drop the interpolation of the current step, so an object moved inside a fixed update
+    // jumps instead of sliding (changes outside a step already do)
+    void savePreviousTransform() {
+        prevPosition = position;
+        prevRotation = rotation;
+        prevScale = scale;
+        snapshotStep = 0;
+    }
+    
+    // World matrix blended between the last two fixed updates (alpha 0 = previous, 1 = current)
+    matrix4x4 getInterpolatedWorldMatrix(float alpha) {
+        if (alpha >= 1.0f || !isMovingInHierarchy()) {
+            return getWorldMatrix();
+        }
+        matrix4x4 local = getLocalMatrix();
+        if (movedInLastStep()) {
+            local = matrixComposeSRT(lerp3(prevPosition, position, alpha),
+                                     lerp3(prevRotation, rotation, alpha),
+                                     lerp3(prevScale, scale, alpha));
+        }
+        return parent ? matrixMultiplyAffine(local, parent->getInterpolatedWorldMatrix(alpha)) : local;
+    }
+    
+    // Matrix to render with this frame
+    matrix4x4 getRenderMatrix() {
+        return getInterpolatedWorldMatrix(g_RenderAlpha);
+    }
+    
     // Rotate by delta amounts (degrees)
     void rotate(float dx, float dy, float dz) {
+        beginTransformChange();
         rotation.x += dx;
         rotation.y += dy;
         rotation.z += dz;
-        matrixDirty = true;
+        markTransformChanged();
     }
     
     // Translate by delta amounts
     void translate(float dx, float dy, float dz) {
+        beginTransformChange();
         position.x += dx;
         position.y += dy;
         position.z += dz;
-        matrixDirty = true;
+        markTransformChanged();
     }
 
 protected:
-    void updateWorldMatrix() {
-        // Build world matrix: Scale * RotationZ * RotationY * RotationX * Translation
-        // Start with identity
-        worldMatrix = MatrixIdentity();
-        
-        // Apply scale
-        worldMatrix.axisX.x = scale.x;
-        worldMatrix.axisY.y = scale.y;
-        worldMatrix.axisZ.z = scale.z;
-        
-        // Apply rotation X (pitch)
-        matrix4x4 rotX = matrixRotationX(rotation.x);
-        worldMatrix = matrixMultiplicationMatrix(worldMatrix, rotX);
-        
-        // Apply rotation Y (yaw)
-        worldMatrix = matrixRotationY(worldMatrix, rotation.y);
-        
-        // Apply rotation Z (roll)
-        matrix4x4 rotZ = matrixRotationZ(rotation.z);
-        worldMatrix = matrixMultiplicationMatrix(worldMatrix, rotZ);
-        
-        // Apply translation
-        vec4 transVec = { position.x, position.y, position.z, 1.0f };
-        matrix4x4 transMat = matrixTranslation(transVec);
-        worldMatrix = matrixMultiplicationMatrix(worldMatrix, transMat);
-        
-        matrixDirty = false;
+    // Before a transform change: the first change inside a step snapshots the pre-step
+    // transform, so objects that updateAll never reaches (model parts) interpolate too
+    void beginTransformChange() {
+        if (g_InFixedStep && spawnStep != g_FixedStepIndex && snapshotStep != g_FixedStepIndex) {
+            prevPosition = position;
+            prevRotation = rotation;
+            prevScale = scale;
+            snapshotStep = g_FixedStepIndex;
+        }
+    }
+    
+    void markTransformChanged() {
+        localDirty = true;
+        // Outside a step, and in the step that created the object, a change is a teleport
+        if (!g_InFixedStep || spawnStep == g_FixedStepIndex) savePreviousTransform();
+        markWorldDirty();
+    }
+    
+    void markChanged() {
+        if (changeFlag) *changeFlag = 1;
+    }
+    
+    bool movedInLastStep() const {
+        return snapshotStep != 0 && snapshotStep == g_FixedStepIndex;
+    }
+    
+    // A dirty node always has a dirty subtree, so propagation stops at the first dirty child
+    void markWorldDirty() {
+        if (worldDirty) return;
+        worldDirty = true;
+        markChanged();
+        for (Object* child : children) {
+            child->markWorldDirty();
+        }
+    }
+    
+    bool isMovingInHierarchy() const {
+        for (const Object* o = this; o; o = o->parent) {
+            if (o->movedInLastStep()) return true;
+        }
+        return false;
+    }
+    
+    static vec3 lerp3(const vec3& a, const vec3& b, float t) {
+        return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
     }
 };
 
@@ -0,0 +1,427 @@
+#pragma once
+#include "MaterialMesh.h"
+#include "Model.h"
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace game {
+
+// ========== OBJECT HANDLES ==========
+// Stable reference to an object owned by the ObjectManager. The generation changes
+// when a slot is reused, so a handle to a destroyed object never resolves again.
+
+struct ObjectHandle {
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+    
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+    
+    bool isValid() const { return index != INVALID_INDEX; }
+    bool operator==(const ObjectHandle& o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const ObjectHandle& o) const { return !(*this == o); }
+};
+
+// ========== OBJECT POOL ==========
+// Objects of one type constructed in place in fixed-size blocks: contiguous in memory
+// for linear sweeps, and never moved, so hierarchy links and handles stay valid.
+// Freed slots are reused before a new block is allocated.
+
+template <typename T>
+class ObjectPool {
+public:
+    static constexpr uint32_t BLOCK_SIZE = 256;
+    
+    ObjectPool() = default;
+    ~ObjectPool() { clear(); }
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    
+    template <typename... Args>
+    uint32_t create(Args&&... args) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = capacity++;
+            if (slot % BLOCK_SIZE == 0) blocks.push_back(std::make_unique<Block>());
+        }
+        new (slotPtr(slot)) T(std::forward<Args>(args)...);
+        blocks[slot / BLOCK_SIZE]->alive[slot % BLOCK_SIZE] = true;
+        live++;
+        return slot;
+    }
+    
+    void destroy(uint32_t slot) {
+        Block& block = *blocks[slot / BLOCK_SIZE];
+        if (!block.alive[slot % BLOCK_SIZE]) return;
+        get(slot)->~T();
+        block.alive[slot % BLOCK_SIZE] = false;
+        freeSlots.push_back(slot);
+        live--;
+    }
+    
+    T* get(uint32_t slot) { return reinterpret_cast<T*>(slotPtr(slot)); }
+    
+    // Visit every live object in memory order
+    template <typename F>
+    void forEach(F&& fn) {
+        for (size_t b = 0; b < blocks.size(); b++) {
+            Block& block = *blocks[b];
+            uint32_t base = (uint32_t)b * BLOCK_SIZE;
+            uint32_t count = (std::min)(BLOCK_SIZE, capacity - base);
+            T* objects = reinterpret_cast<T*>(block.storage);
+            for (uint32_t i = 0; i < count; i++) {
+                if (block.alive[i]) fn(objects[i]);
+            }
+        }
+    }
+    
+    void clear() {
+        forEach([](T& obj) { obj.~T(); });
+        blocks.clear();
+        freeSlots.clear();
+        capacity = 0;
+        live = 0;
+    }
+    
+    size_t size() const { return live; }
+    uint32_t getCapacity() const { return capacity; }  // Slots ever handed out (live + free)
+
+private:
+    struct Block {
+        alignas(T) unsigned char storage[sizeof(T) * BLOCK_SIZE];
+        bool alive[BLOCK_SIZE] = {};
+    };
+    
+    unsigned char* slotPtr(uint32_t slot) {
+        return blocks[slot / BLOCK_SIZE]->storage + sizeof(T) * (slot % BLOCK_SIZE);
+    }
+    
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<uint32_t> freeSlots;
+    uint32_t capacity = 0;  // Slots ever handed out (live + free)
+    size_t live = 0;
+};
+
+// ========== OBJECT MANAGER ==========
+// Owns every object in the scene. MaterialMesh and Model live in their own pools and are
+// swept per type with direct (non-virtual) calls; any other Object type goes into a
+// generic list and keeps virtual dispatch.
+
+class ObjectManager {
+private:
+    enum class Group : uint8_t { MaterialMesh, Model, Custom };
+    
+    struct Record {
+        uint32_t generation = 1;
+        Group group = Group::Custom;
+        bool alive = false;
+        uint32_t slot = 0;         // Pool slot, or index into custom
+        Object* object = nullptr;
+    };
+    
+    std::vector<Record> records;
+    std::vector<uint32_t> freeRecords;
+    
+    ObjectPool<MaterialMesh> meshes;
+    ObjectPool<Model> models;
+    
+    // What renderAll's cull pass reads, split out of the pooled meshes into parallel
+    // arrays by pool slot, so culled meshes are never touched. An entry is refreshed
+    // from its mesh only after the mesh raised its change flag.
+    struct MeshCullBlock {
+        vec3 center[ObjectPool<MaterialMesh>::BLOCK_SIZE];   // World bounding sphere
+        float radius[ObjectPool<MaterialMesh>::BLOCK_SIZE];
+        unsigned char visible[ObjectPool<MaterialMesh>::BLOCK_SIZE] = {};  // 0 for free slots
+        unsigned char changed[ObjectPool<MaterialMesh>::BLOCK_SIZE] = {};
+    };
+    std::vector<std::unique_ptr<MeshCullBlock>> meshCull;
+    std::vector<std::unique_ptr<Object>> custom;
+    std::vector<uint32_t> customRecords;  // Record index of each custom object
+    
+    bool frustumCulling = true;
+    bool occlusionCulling = false;
+    int lastCulledObjects = 0;
+    int lastOccludedObjects = 0;
+    
+    // Occluder pass: the MAX_OCCLUDERS meshes with the largest projected bounding
+    // sphere, up to OCCLUDER_TRIANGLE_BUDGET triangles in total
+    static constexpr int MAX_OCCLUDERS = 8;
+    static constexpr size_t OCCLUDER_TRIANGLE_BUDGET = 20000;
+    static constexpr float MIN_OCCLUDER_SIZE = 0.05f;  // Projected radius / view depth
+    
+    struct OccluderCandidate {
+        MaterialMesh* mesh;
+        matrix4x4 world;
+        float size;
+    };
+    std::vector<OccluderCandidate> occluderCandidates;
+    
+    void buildOcclusionBuffer() {
+        PROFILE_SCOPE("ObjectManager::buildOcclusionBuffer");
+        occluderCandidates.clear();
+        auto consider = [&](MaterialMesh& mesh, const matrix4x4& world) {
+            if (!mesh.isVisible() || mesh.getTriangleCount() == 0) return;
+            const vec3& c = mesh.getBoundsCenter();
+            vec4 center = matrixMultiplicationVec(world, vec4{ c.x, c.y, c.z, 1.0f });
+            vec4 view = matrixMultiplicationVec(SV_ViewMatrix, center);
+            float radius = mesh.getBoundsRadius() * matrixMaxScale(world);
+            if (view.z <= SV_NearPlane) return;
+            if (!sphereInViewFrustum({ center.x, center.y, center.z }, radius)) return;
+            float size = radius / view.z;  // Large walls near the camera rank first
+            if (size >= MIN_OCCLUDER_SIZE) occluderCandidates.push_back({ &mesh, world, size });
+        };
+        meshes.forEach([&](MaterialMesh& mesh) { consider(mesh, mesh.getRenderMatrix()); });
+        models.forEach([&](Model& model) {
+            if (!model.isVisible()) return;
+            for (size_t i = 0; i < model.getMeshCount(); i++) {
+                MaterialMesh* mesh = model.getMesh(i);
+                consider(*mesh, mesh->getRenderMatrix());
+            }
+        });
+        
+        size_t count = (std::min)(occluderCandidates.size(), (size_t)MAX_OCCLUDERS);
+        std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + count, occluderCandidates.end(),
+                          [](const OccluderCandidate& a, const OccluderCandidate& b) { return a.size > b.size; });
+        
+        g_OcclusionBuffer.begin(matrixMultiplicationMatrix(SV_ViewMatrix, SV_ProjectionMatrix));
+        size_t triangles = 0;
+        for (size_t i = 0; i < count; i++) {
+            MaterialMesh& mesh = *occluderCandidates[i].mesh;
+            if (triangles + mesh.getTriangleCount() > OCCLUDER_TRIANGLE_BUDGET) continue;
+            const std::vector<vertex>& verts = mesh.getVertices();
+            const std::vector<unsigned int>& inds = mesh.getIndices();
+            g_OcclusionBuffer.addOccluder(verts.data(), verts.size(), inds.data(), inds.size(), occluderCandidates[i].world);
+            triangles += mesh.getTriangleCount();
+        }
+    }
+    
+    // Copy a changed mesh's world bounding sphere and visibility into the cull arrays
+    static void refreshMeshCull(MaterialMesh& mesh, MeshCullBlock& cull, uint32_t i) {
+        worldBoundingSphere(mesh, cull.center[i], cull.radius[i]);
+        cull.visible[i] = mesh.isVisible() ? 1 : 0;
+        cull.changed[i] = 0;
+    }
+    
+    ObjectHandle addRecord(Group group, uint32_t slot, Object* obj) {
+        uint32_t index;
+        if (!freeRecords.empty()) {
+            index = freeRecords.back();
+            freeRecords.pop_back();
+        } else {
+            index = (uint32_t)records.size();
+            records.emplace_back();
+        }
+        Record& rec = records[index];
+        rec.group = group;
+        rec.slot = slot;
+        rec.object = obj;
+        rec.alive = true;
+        return { index, rec.generation };
+    }
+    
+    const Record* resolve(ObjectHandle h) const {
+        if (h.index >= records.size()) return nullptr;
+        const Record& rec = records[h.index];
+        return (rec.alive && rec.generation == h.generation) ? &rec : nullptr;
+    }
+
+public:
+    ObjectManager() = default;
+    
+    ~ObjectManager() {
+        clear();
+    }
+    
+    ObjectManager(const ObjectManager&) = delete;
+    ObjectManager& operator=(const ObjectManager&) = delete;
+    
+    // Construct an object in the manager's storage
+    template <typename T, typename... Args>
+    ObjectHandle create(Args&&... args) {
+        static_assert(std::is_base_of<Object, T>::value, "ObjectManager stores Object types");
+        if constexpr (std::is_same<T, MaterialMesh>::value) {
+            uint32_t slot = meshes.create(std::forward<Args>(args)...);
+            const uint32_t BLOCK = ObjectPool<MaterialMesh>::BLOCK_SIZE;
+            while (meshCull.size() <= slot / BLOCK) meshCull.push_back(std::make_unique<MeshCullBlock>());
+            unsigned char& changed = meshCull[slot / BLOCK]->changed[slot % BLOCK];
+            changed = 1;
+            meshes.get(slot)->setChangeFlag(&changed);
+            return addRecord(Group::MaterialMesh, slot, meshes.get(slot));
+        } else if constexpr (std::is_same<T, Model>::value) {
+            uint32_t slot = models.create(std::forward<Args>(args)...);
+            return addRecord(Group::Model, slot, models.get(slot));
+        } else {
+            return addObject(new T(std::forward<Args>(args)...));
+        }
+    }
+    
+    // Add a heap object (takes ownership; kept in the generic list)
+    ObjectHandle addObject(Object* obj) {
+        if (!obj) return {};
+        ObjectHandle h = addRecord(Group::Custom, (uint32_t)custom.size(), obj);
+        custom.emplace_back(obj);
+        customRecords.push_back(h.index);
+        return h;
+    }
+    
+    // Destroy an object; its handle (and any copies) stop resolving
+    void removeObject(ObjectHandle h) {
+        if (!resolve(h)) return;
+        Record& rec = records[h.index];
+        switch (rec.group) {
+        case Group::MaterialMesh: {
+            const uint32_t BLOCK = ObjectPool<MaterialMesh>::BLOCK_SIZE;
+            meshes.destroy(rec.slot);
+            meshCull[rec.slot / BLOCK]->visible[rec.slot % BLOCK] = 0;
+            meshCull[rec.slot / BLOCK]->changed[rec.slot % BLOCK] = 0;
+            break;
+        }
+        case Group::Model:
+            models.destroy(rec.slot);
+            break;
+        case Group::Custom: {
+            // Swap-remove, then repoint the record of the object that moved
+            uint32_t last = (uint32_t)custom.size() - 1;
+            if (rec.slot != last) {
+                std::swap(custom[rec.slot], custom[last]);
+                customRecords[rec.slot] = customRecords[last];
+                records[customRecords[rec.slot]].slot = rec.slot;
+            }
+            custom.pop_back();
+            customRecords.pop_back();
+            break;
+        }
+        }
+        rec.alive = false;
+        rec.object = nullptr;
+        rec.generation++;
+        freeRecords.push_back(h.index);
+    }
+    
+    // Clear all objects
+    void clear() {
+        meshes.clear();
+        meshCull.clear();
+        models.clear();
+        custom.clear();
+        customRecords.clear();
+        for (uint32_t i = 0; i < records.size(); i++) {
+            if (records[i].alive) {
+                records[i].alive = false;
+                records[i].object = nullptr;
+                records[i].generation++;
+                freeRecords.push_back(i);
+            }
+        }
+    }
+    
+    bool isAlive(ObjectHandle h) const { return resolve(h) != nullptr; }
+    
+    Object* get(ObjectHandle h) {
+        const Record* rec = resolve(h);
+        return rec ? rec->object : nullptr;
+    }
+    
+    template <typename T>
+    T* getAs(ObjectHandle h) {
+        return dynamic_cast<T*>(get(h));
+    }
+    
+    // Advance every object by one fixed simulation step (see FixedTimestep in GameLoop.h).
+    // Objects moved during the step keep their pre-step transform so rendering can
+    // interpolate between the two (see Object::beginTransformChange).
+    void updateAll(float dt) {
+        g_FixedStepIndex++;
+        g_InFixedStep = true;
+        meshes.forEach([dt](MaterialMesh& mesh) {
+            mesh.MaterialMesh::update(dt);
+        });
+        models.forEach([dt](Model& model) {
+            model.Model::update(dt);
+        });
+        for (auto& obj : custom) {
+            obj->update(dt);
+        }
+        g_InFixedStep = false;
+    }
+    
+    // Render all objects (collected into the render queue, then drawn sorted).
+    // alpha blends each transform between the last two fixed updates.
+    // Pooled meshes outside the view frustum are skipped using their bounding sphere;
+    // with occlusion culling, meshes hidden behind the largest occluders are skipped too
+    // (model meshes are tested in Model::render).
+    void renderAll(float alpha = 1.0f) {
+        g_RenderAlpha = alpha;
+        g_RenderQueue.begin();
+        
+        int culled = 0;
+        uint64_t occludedBefore = g_RenderStats.occlusionCulled;
+        if (occlusionCulling) buildOcclusionBuffer();
+        
+        const uint32_t BLOCK = ObjectPool<MaterialMesh>::BLOCK_SIZE;
+        uint32_t slots = meshes.getCapacity();
+        for (uint32_t slot = 0; slot < slots; slot++) {
+            MeshCullBlock& cull = *meshCull[slot / BLOCK];
+            uint32_t i = slot % BLOCK;
+            if (cull.changed[i]) refreshMeshCull(*meshes.get(slot), cull, i);
+            if (!cull.visible[i]) continue;
+            if (frustumCulling && !sphereInViewFrustum(cull.center[i], cull.radius[i])) {
+                culled++;
+                continue;
+            }
+            MaterialMesh& mesh = *meshes.get(slot);
+            if (!g_OcclusionBuffer.testAABB(mesh.getBoundsMin(), mesh.getBoundsMax(), mesh.getRenderMatrix())) continue;
+            mesh.MaterialMesh::render();
+        }
+        models.forEach([](Model& model) {
+            if (model.isVisible()) model.Model::render();
+        });
+        for (auto& obj : custom) {
+            if (obj->isVisible()) obj->render();
+        }
+        
+        lastCulledObjects = culled;
+        lastOccludedObjects = (int)(g_RenderStats.occlusionCulled - occludedBefore);
+        g_OcclusionBuffer.end();
+        g_RenderQueue.flush();
+        g_RenderAlpha = 1.0f;
+    }
+    
+    // Get object count
+    size_t getObjectCount() const { return meshes.size() + models.size() + custom.size(); }
+    int getLastCulledObjects() const { return lastCulledObjects; }
+    int getLastOccludedObjects() const { return lastOccludedObjects; }
+    void setFrustumCulling(bool enable) { frustumCulling = enable; }
+    void setOcclusionCulling(bool enable) { occlusionCulling = enable; }
+    
+    // Bounding sphere of a mesh in world space
+    static void worldBoundingSphere(MaterialMesh& mesh, vec3& center, float& radius) {
+        const matrix4x4& world = mesh.getWorldMatrix();
+        const vec3& c = mesh.getBoundsCenter();
+        vec4 p = matrixMultiplicationVec(world, vec4{ c.x, c.y, c.z, 1.0f });
+        center = { p.x, p.y, p.z };
+        radius = mesh.getBoundsRadius() * matrixMaxScale(world);
+    }
+    
+    // Visit every object (pools first, in memory order)
+    template <typename F>
+    void forEach(F&& fn) {
+        meshes.forEach([&](MaterialMesh& mesh) { fn(static_cast<Object&>(mesh)); });
+        models.forEach([&](Model& model) { fn(static_cast<Object&>(model)); });
+        for (auto& obj : custom) fn(*obj);
+    }
+};
+
+// Global object manager
+inline ObjectManager g_ObjectManager;
+
+} // namespace game
@@ -0,0 +1,149 @@
+#pragma once
+#include "Defines.h"
+#include "Shaders.h"
+#include "RenderStats.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// ========== SOFTWARE OCCLUSION CULLING ==========
+// The largest occluders of a frame are rasterized depth-only into a small buffer
+// (256x144), then object bounding boxes are tested against it before they are submitted.
+// Both sides are conservative: an occluder only writes pixels its triangle covers
+// completely, with the farthest depth inside the pixel, and a box is hidden only when its
+// nearest depth is behind every pixel its screen rectangle touches.
+
+class OcclusionBuffer {
+public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 144;
+    
+    // Start a frame: clear the buffer and keep the camera
+    void begin(const matrix4x4& viewProjection) {
+        PROFILE_SCOPE("OcclusionBuffer::begin");
+        depth.assign(WIDTH * HEIGHT, 1.0f);
+        viewProj = viewProjection;
+        active = true;
+        occluderTriangles = 0;
+    }
+    
+    // Stop testing (everything counts as visible until the next begin)
+    void end() { active = false; }
+    
+    bool isActive() const { return active; }
+    int getOccluderTriangles() const { return occluderTriangles; }
+    const float* getDepth() const { return depth.data(); }
+    
+    // Rasterize an indexed mesh as an occluder
+    void addOccluder(const vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                     matrix4x4 world) {
+        PROFILE_SCOPE("OcclusionBuffer::addOccluder");
+        matrix4x4 wvp = matrixMultiplicationMatrix(world, viewProj);
+        projected.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            projected[i] = matrixMultiplicationVec(wvp, vertices[i].pos);
+        }
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            const vec4& a = projected[indices[i]];
+            const vec4& b = projected[indices[i + 1]];
+            const vec4& c = projected[indices[i + 2]];
+            // Triangles crossing the near plane are left out (less occlusion, never wrong)
+            if (a.w <= SV_NearPlane || b.w <= SV_NearPlane || c.w <= SV_NearPlane) continue;
+            fillDepthTriangle(toBuffer(a), toBuffer(b), toBuffer(c));
+            occluderTriangles++;
+        }
+    }
+    
+    // Is any part of a mesh-space box possibly visible?
+    bool testAABB(const vec3& lo, const vec3& hi, matrix4x4 world) {
+        if (!active) return true;
+        g_RenderStats.occlusionTested++;
+        
+        matrix4x4 wvp = matrixMultiplicationMatrix(world, viewProj);
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+        for (int i = 0; i < 8; i++) {
+            vec4 corner = { (i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z, 1.0f };
+            vec4 clip = matrixMultiplicationVec(wvp, corner);
+            if (clip.w <= SV_NearPlane) return true;  // Reaches the camera
+            vec3 p = toBuffer(clip);
+            minX = (std::min)(minX, p.x); maxX = (std::max)(maxX, p.x);
+            minY = (std::min)(minY, p.y); maxY = (std::max)(maxY, p.y);
+            nearest = (std::min)(nearest, p.z);
+        }
+        
+        int x0 = (std::max)((int)floorf(minX), 0), x1 = (std::min)((int)floorf(maxX), WIDTH - 1);
+        int y0 = (std::max)((int)floorf(minY), 0), y1 = (std::min)((int)floorf(maxY), HEIGHT - 1);
+        if (x0 > x1 || y0 > y1) return true;  // Off-screen: the frustum test decides
+        
+        for (int y = y0; y <= y1; y++) {
+            const float* row = &depth[y * WIDTH];
+            for (int x = x0; x <= x1; x++) {
+                if (nearest <= row[x]) return true;
+            }
+        }
+        g_RenderStats.occlusionCulled++;
+        return false;
+    }
+
+private:
+    // Clip space -> buffer pixels (x, y) and NDC depth (z)
+    static vec3 toBuffer(const vec4& clip) {
+        float invW = 1.0f / clip.w;
+        return { (clip.x * invW + 1.0f) * 0.5f * WIDTH, (1.0f - clip.y * invW) * 0.5f * HEIGHT, clip.z * invW };
+    }
+    
+    // Depth-only fillTriangle: pixels fully inside the triangle keep the nearer of their
+    // depth and the triangle's farthest depth over the pixel
+    void fillDepthTriangle(const vec3& v0, const vec3& v1, const vec3& v2) {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (area == 0.0f) return;
+        float invArea = 1.0f / area;
+        
+        int minX = (std::max)((int)floorf((std::min)((std::min)(v0.x, v1.x), v2.x)), 0);
+        int minY = (std::max)((int)floorf((std::min)((std::min)(v0.y, v1.y), v2.y)), 0);
+        int maxX = (std::min)((int)floorf((std::max)((std::max)(v0.x, v1.x), v2.x)), WIDTH - 1);
+        int maxY = (std::min)((int)floorf((std::max)((std::max)(v0.y, v1.y), v2.y)), HEIGHT - 1);
+        if (minX > maxX || minY > maxY) return;
+        
+        // Barycentric edge functions, as in fillTriangleT
+        float a0 = (v1.y - v2.y) * invArea, c0 = (v2.x - v1.x) * invArea;
+        float a1 = (v2.y - v0.y) * invArea, c1 = (v0.x - v2.x) * invArea;
+        float a2 = (v0.y - v1.y) * invArea, c2 = (v1.x - v0.x) * invArea;
+        float k0 = (v1.x * v2.y - v2.x * v1.y) * invArea;
+        float k1 = (v2.x * v0.y - v0.x * v2.y) * invArea;
+        float k2 = (v0.x * v1.y - v1.x * v0.y) * invArea;
+        
+        // Sampled at pixel centers; shifting each edge in by half its extent over a pixel
+        // turns "center inside" into "whole pixel inside"
+        float m0 = 0.5f * (fabsf(a0) + fabsf(c0));
+        float m1 = 0.5f * (fabsf(a1) + fabsf(c1));
+        float m2 = 0.5f * (fabsf(a2) + fabsf(c2));
+        float dzdx = v0.z * a0 + v1.z * a1 + v2.z * a2;
+        float dzdy = v0.z * c0 + v1.z * c1 + v2.z * c2;
+        float zPad = 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+        
+        for (int y = minY; y <= maxY; y++) {
+            float fy = y + 0.5f;
+            float fx = minX + 0.5f;
+            float b0 = a0 * fx + c0 * fy + k0;
+            float b1 = a1 * fx + c1 * fy + k1;
+            float b2 = a2 * fx + c2 * fy + k2;
+            float* row = &depth[y * WIDTH];
+            for (int x = minX; x <= maxX; x++, b0 += a0, b1 += a1, b2 += a2) {
+                if (b0 < m0 || b1 < m1 || b2 < m2) continue;
+                float z = v0.z * b0 + v1.z * b1 + v2.z * b2 + zPad;
+                if (z < row[x]) row[x] = z;
+            }
+        }
+    }
+    
+    std::vector<float> depth;
+    std::vector<vec4> projected;  // Scratch, one per occluder vertex
+    matrix4x4 viewProj;
+    bool active = false;
+    int occluderTriangles = 0;
+};
+
+// Global occlusion buffer (filled by ObjectManager::renderAll when enabled)
+inline OcclusionBuffer g_OcclusionBuffer;
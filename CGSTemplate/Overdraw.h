@@ -0,0 +1,92 @@
+#pragma once
+#include "Defines.h"
+#include <algorithm>
+#include <cstdint>
+
+// Per-pixel overdraw / depth-complexity counters.
+// When enabled, OVERDRAW_ARRAY holds one packed counter per pixel next to DEPTH_ARRAY:
+// the low 16 bits count depth tests (fragments that covered the pixel) and the high
+// 16 bits count color writes, so the rasterizer bumps either with a single add.
+// Counts above 65535 per pixel per frame are not expected and wrap into the next lane.
+
+constexpr unsigned int OVERDRAW_TEST = 1u;
+constexpr unsigned int OVERDRAW_WRITE = 1u << 16;
+
+inline unsigned int OverdrawTests(unsigned int counter) { return counter & 0xFFFF; }
+inline unsigned int OverdrawWrites(unsigned int counter) { return counter >> 16; }
+
+// Allocate or free the counter buffer (the rasterizer only counts while it exists)
+inline void EnableOverdrawCounters(bool enable) {
+    if (enable && !OVERDRAW_ARRAY) {
+        OVERDRAW_ARRAY = new unsigned int[NUM_PIXELS]();
+    } else if (!enable && OVERDRAW_ARRAY) {
+        delete[] OVERDRAW_ARRAY;
+        OVERDRAW_ARRAY = nullptr;
+    }
+}
+
+inline bool OverdrawCountersEnabled() { return OVERDRAW_ARRAY != nullptr; }
+
+// Reset at the start of a frame (clearColorBuffer does this)
+inline void ClearOverdrawCounters() {
+    if (OVERDRAW_ARRAY) std::fill(OVERDRAW_ARRAY, OVERDRAW_ARRAY + NUM_PIXELS, 0u);
+}
+
+// Aggregates over one frame's counters
+struct OverdrawStats {
+    uint64_t tests = 0;            // Fragments that reached the depth test
+    uint64_t writes = 0;           // Color writes
+    uint64_t coveredPixels = 0;    // Pixels with at least one fragment
+    uint64_t writtenPixels = 0;    // Pixels with at least one write
+    unsigned int maxDepthComplexity = 0;
+    double meanDepthComplexity = 0.0;   // Fragments per covered pixel
+    double wastedShadingPercent = 0.0;  // Writes later overwritten by a nearer fragment
+};
+
+// `pixels`: counters in use (the scene's size when it rendered below native resolution)
+inline OverdrawStats ComputeOverdrawStats(int pixels = NUM_PIXELS) {
+    OverdrawStats stats;
+    if (!OVERDRAW_ARRAY) return stats;
+    
+    for (int i = 0; i < pixels; i++) {
+        unsigned int tests = OverdrawTests(OVERDRAW_ARRAY[i]);
+        unsigned int writes = OverdrawWrites(OVERDRAW_ARRAY[i]);
+        stats.tests += tests;
+        stats.writes += writes;
+        stats.coveredPixels += tests != 0;
+        stats.writtenPixels += writes != 0;
+        stats.maxDepthComplexity = (std::max)(stats.maxDepthComplexity, tests);
+    }
+    
+    if (stats.coveredPixels) {
+        stats.meanDepthComplexity = (double)stats.tests / stats.coveredPixels;
+    }
+    // Only the last write of each pixel survives; every earlier one was shaded for nothing
+    if (stats.writes) {
+        stats.wastedShadingPercent = 100.0 * (double)(stats.writes - stats.writtenPixels) / stats.writes;
+    }
+    return stats;
+}
+
+enum class OverdrawView {
+    DepthComplexity,  // Fragments tested per pixel
+    Writes            // Color writes per pixel
+};
+
+// Heat ramp: 0 = black, 1 = blue, 2 = cyan, 3 = green, 4 = yellow, 5 = orange, 6 = red, 7+ = white
+inline unsigned int OverdrawHeatColor(unsigned int count) {
+    static const unsigned int ramp[8] = {
+        0xFF000000, 0xFF0000C0, 0xFF00C0C0, 0xFF00C000,
+        0xFFE0E000, 0xFFFF8000, 0xFFFF0000, 0xFFFFFFFF
+    };
+    return ramp[(std::min)(count, 7u)];
+}
+
+// Replace the frame with a heatmap of the counters (debug view; draw the HUD afterwards)
+inline void DrawOverdrawHeatmap(unsigned int* dest, OverdrawView view = OverdrawView::DepthComplexity) {
+    if (!OVERDRAW_ARRAY) return;
+    for (int i = 0; i < NUM_PIXELS; i++) {
+        unsigned int counter = OVERDRAW_ARRAY[i];
+        dest[i] = OverdrawHeatColor(view == OverdrawView::Writes ? OverdrawWrites(counter) : OverdrawTests(counter));
+    }
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "Defines.h"
+#include "Shaders.h"
+#include "RenderStats.h"
+#include "Overdraw.h"
+#include "Msaa.h"
+#include "Fxaa.h"
+#include "DynamicResolution.h"
+#include "GameLoop.h"
+#include "ThreadPool.h"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_sw.h"
+#include <chrono>
+
+namespace game {
+
+// Live performance overlay drawn with the software ImGui backend.
+// Stats are sampled every frame but the panel is rebuilt only REFRESH_INTERVAL apart;
+// in between, the previous ImGui draw data is replayed, which the retained UI layer
+// turns into a composite with no re-rasterization.
+class PerfHud {
+public:
+    static constexpr int HISTORY = 240;               // Frames in the rolling graph
+    static constexpr double REFRESH_INTERVAL = 0.1;   // Seconds between panel rebuilds
+    
+    bool init() {
+        if (initialized) return true;
+        if (!ImGui::GetCurrentContext()) {
+            ImGui::CreateContext();
+            ownsContext = true;
+        }
+        ImGuiIO& io = ImGui::GetIO();
+        io.IniFilename = nullptr;
+        ImGui_ImplSW_Init();
+        ImGui_ImplSW_CreateFontsTexture();
+        lastFrame = std::chrono::steady_clock::now();
+        lastRefresh = lastFrame;
+        initialized = true;
+        return true;
+    }
+    
+    void shutdown() {
+        if (!initialized) return;
+        ImGui_ImplSW_Shutdown();
+        if (ownsContext) ImGui::DestroyContext();
+        ownsContext = false;
+        initialized = false;
+    }
+    
+    void setVisible(bool show) { visible = show; }
+    
+    // Show pacing stats of the loop's limiter (optional)
+    void setFrameLimiter(const FrameLimiter* frameLimiter) { limiter = frameLimiter; }
+    bool isVisible() const { return visible; }
+    
+    // Milliseconds the HUD itself took last frame
+    double getHudMs() const { return hudMs; }
+    
+    // Record the frame that just finished (call once per frame, after rendering and present)
+    void endFrame() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        float ms = std::chrono::duration<float, std::milli>(now - lastFrame).count();
+        lastFrame = now;
+        
+        frameTimes[historyPos] = ms;
+        historyPos = (historyPos + 1) % HISTORY;
+        if (historyCount < HISTORY) historyCount++;
+        
+        double busy = g_ThreadPool.takeBusyMs();
+        int threads = g_ThreadPool.getThreadCount();
+        utilization = (ms > 0.0f) ? busy / (ms * threads) : 0.0;
+        
+        // Keep the last full frame's counters for display (g_RenderStats is reset every frame)
+        shown = g_RenderStats;
+    }
+    
+    // Draw the overlay into a pixel buffer (ARGB, width*height)
+    void render(unsigned int* pixels, int width, int height) {
+        if (!initialized || !visible) return;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        
+        bool refresh = !hasDrawData ||
+            std::chrono::duration<double>(start - lastRefresh).count() >= REFRESH_INTERVAL;
+        if (refresh) {
+            lastRefresh = start;
+            buildPanel((float)width, (float)height);
+            hasDrawData = true;
+        }
+        ImGui_ImplSW_RenderDrawData(ImGui::GetDrawData(), pixels, width, height);
+        
+        hudMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+private:
+    void buildPanel(float width, float height) {
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(width, height);
+        io.DeltaTime = (float)REFRESH_INTERVAL;
+        ImGui::NewFrame();
+        
+        // Frame-time summary over the history
+        float minMs = 1e9f, maxMs = 0.0f, sumMs = 0.0f;
+        for (int i = 0; i < historyCount; i++) {
+            float ms = frameTimes[i];
+            minMs = ms < minMs ? ms : minMs;
+            maxMs = ms > maxMs ? ms : maxMs;
+            sumMs += ms;
+        }
+        float avgMs = historyCount ? sumMs / historyCount : 0.0f;
+        if (!historyCount) minMs = 0.0f;
+        float lastMs = frameTimes[(historyPos + HISTORY - 1) % HISTORY];
+        
+        ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoInputs |
+                                 ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+                                 ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+        ImGui::SetNextWindowPos(ImVec2(10, 10));
+        ImGui::SetNextWindowBgAlpha(0.75f);
+        ImGui::Begin("Performance", nullptr, flags);
+        
+        ImGui::Text("Frame %.2f ms (%.0f fps)", lastMs, lastMs > 0.0f ? 1000.0f / lastMs : 0.0f);
+        ImGui::Text("min %.2f  avg %.2f  max %.2f ms", minMs, avgMs, maxMs);
+        ImGui::PlotLines("##frametimes", frameTimes, historyCount < HISTORY ? historyCount : HISTORY,
+                         historyCount < HISTORY ? 0 : historyPos, nullptr, 0.0f, maxMs * 1.2f, ImVec2(260, 60));
+        
+        ImGui::Separator();
+        for (int i = 0; i < shown.stageCount; i++) {
+            ImGui::Text("%-12s %7.2f ms", shown.stages[i].name, shown.stages[i].ms);
+        }
+        
+        ImGui::Separator();
+        ImGui::Text("Triangles  %llu submitted", (unsigned long long)shown.trianglesSubmitted);
+        ImGui::Text("           %llu culled, %llu drawn", (unsigned long long)shown.trianglesCulled, (unsigned long long)shown.trianglesDrawn);
+        if (shown.clustersTested) {
+            ImGui::Text("Clusters   %llu of %llu culled", (unsigned long long)shown.clustersCulled,
+                        (unsigned long long)shown.clustersTested);
+        }
+        if (shown.occlusionTested) {
+            ImGui::Text("Occluded   %llu of %llu objects", (unsigned long long)shown.occlusionCulled,
+                        (unsigned long long)shown.occlusionTested);
+        }
+        if (shown.gpuReadbackLatency >= 0) {
+            ImGui::Text("GPU        readback %d frame%s behind%s", shown.gpuReadbackLatency,
+                        shown.gpuReadbackLatency == 1 ? "" : "s", shown.gpuReadbackLatency ? "" : " (stalls on the copy)");
+        }
+        uint64_t corners = shown.vertexTransforms + shown.vertexCacheHits;
+        ImGui::Text("Vertices   %llu transformed (%.0f%% cache hits)", (unsigned long long)shown.vertexTransforms,
+                    corners ? shown.vertexCacheHits * 100.0 / corners : 0.0);
+        if (shown.vertexLightings || shown.vertexLightsBaked) {
+            ImGui::Text("Lighting   %d lights, %llu vertices lit, %llu baked", SV_LightCount,
+                        (unsigned long long)shown.vertexLightings, (unsigned long long)shown.vertexLightsBaked);
+        }
+        // Per-pixel ratios are against the scene's resolution, which may be below native
+        int scenePixels = shown.sceneWidth * shown.sceneHeight;
+        if (!scenePixels) scenePixels = NUM_PIXELS;
+        if (g_DynamicResolutionEnabled) {
+            ImGui::Text("Resolution %dx%d (%.0f%%), target %.1f ms%s", shown.sceneWidth, shown.sceneHeight,
+                        NUM_PIXELS ? scenePixels * 100.0 / NUM_PIXELS : 0.0, g_DynamicResolution.getTargetMs(),
+                        g_DynamicResolutionSharpen ? ", sharpened" : "");
+        }
+        ImGui::Text("Pixels     %llu shaded", (unsigned long long)shown.pixelsShaded);
+        double overdraw = (double)shown.pixelsShaded / scenePixels;
+        double depthReject = shown.pixelsTested ? 1.0 - (double)shown.pixelsShaded / shown.pixelsTested : 0.0;
+        ImGui::Text("Overdraw   %.2fx  (%.0f%% depth rejected)", overdraw, depthReject * 100.0);
+        if (shown.prepassTriangles) {
+            ImGui::Text("Prepass    %llu tris, %.2fx depth only", (unsigned long long)shown.prepassTriangles,
+                        (double)shown.prepassPixels / scenePixels);
+        }
+        if (shown.visibilityTriangles) {
+            ImGui::Text("Vis buffer %llu tris, %.2fx id writes", (unsigned long long)shown.visibilityTriangles,
+                        (double)shown.visibilityWrites / scenePixels);
+        }
+        if (g_MsaaMode || g_FxaaEnabled) {
+            ImGui::Text("AA         %s%s  (%llu MSAA edge px, %llu FXAA px)", g_MsaaMode ? "MSAA 4x " : "",
+                        g_FxaaEnabled ? "FXAA" : "", (unsigned long long)shown.msaaEdgePixels,
+                        (unsigned long long)shown.fxaaPixels);
+        }
+        if (OverdrawCountersEnabled()) {
+            OverdrawStats od = ComputeOverdrawStats(g_RenderStats.sceneWidth * g_RenderStats.sceneHeight);
+            ImGui::Text("Depth cx   %.2f avg, %u max", od.meanDepthComplexity, od.maxDepthComplexity);
+            ImGui::Text("           %.0f%% of shading overwritten", od.wastedShadingPercent);
+        }
+        ImGui::Text("Textures   %.1f MB", shown.textureBytes / (1024.0 * 1024.0));
+        if (limiter && limiter->getTargetHz() > 0.0) {
+            ImGui::Text("Pacing     %.0f Hz, jitter %.3f avg %.3f max ms", limiter->getTargetHz(),
+                        limiter->getAverageJitterMs(), limiter->getMaxJitterMs());
+        }
+        ImGui::Text("Threads    %d  (%.0f%% busy)", g_ThreadPool.getThreadCount(), utilization * 100.0);
+        ImGui::Text("HUD        %.2f ms (%.1f%%)", hudMs, avgMs > 0.0f ? hudMs / avgMs * 100.0 : 0.0);
+        
+        ImGui::End();
+        ImGui::Render();
+    }
+    
+    bool initialized = false;
+    bool ownsContext = false;
+    bool visible = true;
+    const FrameLimiter* limiter = nullptr;
+    bool hasDrawData = false;
+    
+    float frameTimes[HISTORY] = {};
+    int historyPos = 0;
+    int historyCount = 0;
+    double utilization = 0.0;
+    double hudMs = 0.0;
+    RenderStats shown;
+    
+    std::chrono::steady_clock::time_point lastFrame;
+    std::chrono::steady_clock::time_point lastRefresh;
+};
+
+// Global instance
+inline PerfHud g_PerfHud;
+
+} // namespace game
@@ -0,0 +1,165 @@
+#pragma once
+// Frame profiler: scoped zones recorded into per-thread ring buffers, exported as
+// Chrome trace JSON (open in chrome://tracing or ui.perfetto.dev).
+//
+// Zones are only compiled in when ENABLE_PROFILER is defined; otherwise every
+// PROFILE_* macro expands to nothing and costs nothing.
+//
+//   PROFILE_SCOPE("name");          // zone from here to the end of the enclosing block
+//   PROFILE_FUNCTION();             // zone named after the enclosing function
+//   PROFILE_THREAD_NAME("Worker");  // label the calling thread in the trace
+//   PROFILE_DUMP("trace.json");     // write every recorded zone
+
+#ifdef ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Profiler {
+public:
+    struct Zone {
+        const char* name;   // Must be a string literal (stored by pointer)
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+    
+    // Single-producer ring owned by one thread. The owner appends without locks;
+    // readers take a snapshot and drop anything overwritten while they copied.
+    struct ThreadBuffer {
+        static constexpr size_t CAPACITY = 1 << 16;  // Zones kept per thread (oldest are overwritten)
+        std::vector<Zone> zones;
+        std::atomic<uint64_t> written{0};
+        uint32_t threadId = 0;
+        std::string threadName;
+        
+        ThreadBuffer() : zones(CAPACITY) {}
+        
+        void push(const char* name, uint64_t startNs, uint64_t endNs) {
+            uint64_t index = written.load(std::memory_order_relaxed);
+            Zone& z = zones[index & (CAPACITY - 1)];
+            z.name = name;
+            z.startNs = startNs;
+            z.endNs = endNs;
+            written.store(index + 1, std::memory_order_release);
+        }
+    };
+    
+    static Profiler& get() {
+        static Profiler instance;
+        return instance;
+    }
+    
+    static uint64_t nowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // Buffer of the calling thread (registered on first use; never freed so dumps stay valid)
+    ThreadBuffer& threadBuffer() {
+        static thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.emplace_back(new ThreadBuffer());
+            buffer = buffers.back().get();
+            buffer->threadId = (uint32_t)buffers.size();
+        }
+        return *buffer;
+    }
+    
+    void setThreadName(const char* name) {
+        threadBuffer().threadName = name;
+    }
+    
+    // Copy out the zones currently held by every thread
+    void snapshot(std::vector<std::pair<uint32_t, Zone>>& out) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (size_t b = 0; b < buffers.size(); b++) {
+            ThreadBuffer& tb = *buffers[b];
+            uint64_t end = tb.written.load(std::memory_order_acquire);
+            uint64_t begin = (end > ThreadBuffer::CAPACITY) ? end - ThreadBuffer::CAPACITY : 0;
+            size_t first = out.size();
+            for (uint64_t i = begin; i < end; i++) {
+                out.push_back(std::make_pair(tb.threadId, tb.zones[i & (ThreadBuffer::CAPACITY - 1)]));
+            }
+            
+            // Entries the owner overwrote during the copy are unreliable
+            uint64_t after = tb.written.load(std::memory_order_acquire);
+            uint64_t valid = (after > ThreadBuffer::CAPACITY) ? after - ThreadBuffer::CAPACITY : 0;
+            if (valid > begin) {
+                size_t drop = (size_t)((valid - begin < end - begin) ? valid - begin : end - begin);
+                out.erase(out.begin() + first, out.begin() + first + drop);
+            }
+        }
+    }
+    
+    // Write a Chrome trace ("X" complete events, microsecond timestamps)
+    bool writeChromeTrace(const char* path) {
+        std::vector<std::pair<uint32_t, Zone>> zones;
+        snapshot(zones);
+        
+        FILE* file = fopen(path, "w");
+        if (!file) return false;
+        
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (size_t b = 0; b < buffers.size(); b++) {
+                if (buffers[b]->threadName.empty()) continue;
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", buffers[b]->threadId, buffers[b]->threadName.c_str());
+                first = false;
+            }
+        }
+        for (size_t i = 0; i < zones.size(); i++) {
+            const Zone& z = zones[i].second;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", z.name, zones[i].first,
+                    (z.startNs - epochNs) / 1000.0, (z.endNs - z.startNs) / 1000.0);
+            first = false;
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        fclose(file);
+        return true;
+    }
+    
+private:
+    Profiler() : epochNs(nowNs()) {}
+    
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    uint64_t epochNs;
+};
+
+// Records one zone for the lifetime of the object
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* zoneName) : name(zoneName), startNs(Profiler::nowNs()) {}
+    ~ProfileScope() { Profiler::get().threadBuffer().push(name, startNs, Profiler::nowNs()); }
+    
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) Profiler::get().setThreadName(name)
+#define PROFILE_DUMP(path) Profiler::get().writeChromeTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_DUMP(path) ((void)0)
+
+#endif
@@ -2,6 +2,18 @@
 #include "Defines.h"
 #include "Shaders.h"
 #include "celestial.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "Overdraw.h"
+#include "DepthPrepass.h"
+#include "VisibilityBuffer.h"
+#include "Msaa.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
 
 // Function declarations
 int coordinateTranslation2D(int x, int y, int Width);
@@ -13,10 +25,14 @@ void clearColorBuffer(unsigned int color);
 void LineDrawer(vertex start, vertex end, unsigned int color);
 void fillTriangle(vertex v0, vertex v1, vertex v2, const unsigned* texture, int texWidth, int texHeight);
 vertex toScreen(vertex inp);
+bool projectLine(const vertex& Start, const vertex& End, vertex& screenStart, vertex& screenEnd);
 void drawLine(const vertex& Start, const vertex& End, unsigned color);
 void DrawTriangle(vertex& v0, vertex& v1, vertex& v2, const unsigned* texture, int texWidth, int texHeight);
+void DrawTriangles(const vertex* vertices, const unsigned int* indices, size_t indexCount, const unsigned* texture, int texWidth, int texHeight, unsigned int color);
 unsigned sampleTexture(const unsigned* texture, int texWidth, int texHeight, float u, float v);
 void Blit(const unsigned int* source, int srcWidth, int srcHeight, unsigned int* dest, int destWidth, int destHeight, int cubeFace, float scale);
+void ResolveVisibilityBuffer();
+void ResolveMsaaBuffer();
 
 // Function implementations
 int coordinateTranslation2D(int x, int y, int Width)
@@ -58,31 +74,34 @@ void pixelDrawer(int x, int y, float z, unsigned int color)
 	int index = coordinateTranslation2D(x, y, RASTER_WIDTH);
 	if (index < NUM_PIXELS && x < RASTER_WIDTH && y < RASTER_HEIGHT)
 	{
+		g_RenderStats.pixelsTested++;
+		if (OVERDRAW_ARRAY) OVERDRAW_ARRAY[index] += OVERDRAW_TEST;
 		if (z < DEPTH_ARRAY[index])
 		{
 			DEPTH_ARRAY[index] = z;
 			SCREEN_ARRAY[index] = color;
+			g_RenderStats.pixelsShaded++;
+			if (OVERDRAW_ARRAY) OVERDRAW_ARRAY[index] += OVERDRAW_WRITE;
 		}
 	}
 }
 
-// Star field data (generated once)
-unsigned int STAR_BUFFER[NUM_PIXELS];
+// Star field data (generated once per resolution)
+std::vector<unsigned int> STAR_BUFFER;
 bool starsGenerated = false;
 
 void generateStarField() {
-	if (starsGenerated) return;
+	if (starsGenerated && STAR_BUFFER.size() == (size_t)NUM_PIXELS) return;
 	
 	// Fill with black space
-	for (unsigned int i = 0; i < NUM_PIXELS; i++) {
-		STAR_BUFFER[i] = 0xFF000008; // Very dark blue-black
-	}
+	STAR_BUFFER.assign(NUM_PIXELS, 0xFF000008); // Very dark blue-black
 	
-	// Add random stars
+	// Add random stars (placed relative to the screen, so they stay put when the
+	// dynamic resolution changes)
 	srand(42); // Fixed seed for consistent stars
 	for (int s = 0; s < 300; s++) {
-		int x = rand() % RASTER_WIDTH;
-		int y = rand() % RASTER_HEIGHT;
+		int x = (int)((long long)rand() * RASTER_WIDTH / ((long long)RAND_MAX + 1));
+		int y = (int)((long long)rand() * RASTER_HEIGHT / ((long long)RAND_MAX + 1));
 		int brightness = 100 + (rand() % 155); // 100-255
 		int index = y * RASTER_WIDTH + x;
 		
@@ -103,12 +122,13 @@ void generateStarField() {
 
 void clearColorBuffer(unsigned int color)
 {
+	PROFILE_SCOPE("clearColorBuffer");
 	generateStarField();
-	for (unsigned int i = 0; i < NUM_PIXELS; i++)
-	{
-		SCREEN_ARRAY[i] = STAR_BUFFER[i]; // Copy star field
-		DEPTH_ARRAY[i] = 1.0f;
-	}
+	std::copy(STAR_BUFFER.begin(), STAR_BUFFER.end(), SCREEN_ARRAY); // Copy star field
+	std::fill(DEPTH_ARRAY, DEPTH_ARRAY + NUM_PIXELS, 1.0f);
+	ClearOverdrawCounters();
+	g_RenderStats.sceneWidth = RASTER_WIDTH;
+	g_RenderStats.sceneHeight = RASTER_HEIGHT;
 }
 
 void LineDrawer(vertex start, vertex end, unsigned int color)
@@ -155,9 +175,6 @@ unsigned sampleTexture(const unsigned* texture, int texWidth, int texHeight, flo
 	return texture[y * texWidth + x];
 }
 
-// Global lighting factor for current triangle (set by DrawTriangle)
-float g_currentLightingFactor = 1.0f;
-
 // Apply sun lighting to a color with warm tint
 unsigned int applyLighting(unsigned int color, float lighting) {
     unsigned int a = (color >> 24) & 0xFF;
@@ -178,63 +195,514 @@ unsigned int applyLighting(unsigned int color, float lighting) {
     return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-void fillTriangle(vertex v0, vertex v1, vertex v2, const unsigned* texture, int texWidth, int texHeight)
+// Apply per-channel light (smooth lighting; the tint is part of the light)
+inline unsigned int applyLightingRGB(unsigned int color, const vec3& light) {
+    unsigned int r = (unsigned int)(((color >> 16) & 0xFF) * light.x);
+    unsigned int g = (unsigned int)(((color >> 8) & 0xFF) * light.y);
+    unsigned int b = (unsigned int)((color & 0xFF) * light.z);
+    r = (r > 255) ? 255 : r;
+    g = (g > 255) ? 255 : g;
+    b = (b > 255) ? 255 : b;
+    return (color & 0xFF000000) | (r << 16) | (g << 8) | b;
+}
+
+// ========== FIXED-POINT EDGES ==========
+// Screen positions live on a 28.4 fixed-point grid (1/16 pixel; toScreen snaps them).
+// Coverage is decided by exact integer edge functions sampled at pixel centers with the
+// top-left rule, so a pixel on an edge shared by two triangles belongs to exactly one:
+// no cracks and no pixel shaded twice.
+
+constexpr int SUBPIXEL_BITS = 4;
+constexpr int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+constexpr float SUBPIXEL_GUARD = 16777216.0f;  // Corners are clamped to +-2^24 pixels (edge products stay in 64 bits)
+
+inline float snapSubpixel(float v)
+{
+	return roundf(v * SUBPIXEL_ONE) * (1.0f / SUBPIXEL_ONE);
+}
+
+inline int64_t toFixed(float v)
+{
+	v = (std::max)(-SUBPIXEL_GUARD, (std::min)(v, SUBPIXEL_GUARD));
+	return static_cast<int64_t>(llrintf(v * SUBPIXEL_ONE));
+}
+
+// Integer edge functions of a screen triangle, oriented so covered pixels are >= minimum.
+// Edge i is the one opposite corner i, and its value over area is corner i's barycentric.
+struct TriangleEdges
 {
-	// Calculate reciprocal of linear Z for each vertex
-	float w0 = 1.0f / v0.pos.z;
-	float w1 = 1.0f / v1.pos.z;
-	float w2 = 1.0f / v2.pos.z;
-
-	// Adjust UV coordinates by the linear Z value
-	float u0 = v0.u * w0;
-	float v0_u = v0.v * w0;
-	float u1 = v1.u * w1;
-	float v1_u = v1.v * w1;
-	float u2 = v2.u * w2;
-	float v2_u = v2.v * w2;
-
-	float startX = min(min(v0.pos.x, v1.pos.x), v2.pos.x);
-	float startY = min(min(v0.pos.y, v1.pos.y), v2.pos.y);
-	float endX = max(max(v0.pos.x, v1.pos.x), v2.pos.x);
-	float endY = max(max(v0.pos.y, v1.pos.y), v2.pos.y);
-
-	for (int y = static_cast<int>(startY); y <= static_cast<int>(endY); y++)
+	int64_t area;        // Twice the area, in subpixel units squared (always positive)
+	int64_t stepX[3];    // Change per pixel to the right
+	int64_t stepY[3];    // ... per pixel down
+	int64_t origin[3];   // At the center of pixel (0, 0)
+	int64_t minimum[3];  // 0 on top and left edges, 1 on the others (top-left rule)
+	int minX, minY, maxX, maxY;  // Pixels whose centers can be covered, clamped to the screen
+
+	// False when the triangle covers no sample on screen (reach: farthest sample from the
+	// pixel center, in subpixels)
+	bool setup(const vertex& v0, const vertex& v1, const vertex& v2, int64_t reach = 0)
+	{
+		int64_t x[3] = { toFixed(v0.pos.x), toFixed(v1.pos.x), toFixed(v2.pos.x) };
+		int64_t y[3] = { toFixed(v0.pos.y), toFixed(v1.pos.y), toFixed(v2.pos.y) };
+		area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (area == 0) return false;
+		int64_t sign = area > 0 ? 1 : -1;  // Both windings are drawn
+		area *= sign;
+
+		const int64_t half = SUBPIXEL_ONE / 2;
+		for (int i = 0; i < 3; i++)
+		{
+			int a = (i + 1) % 3, b = (i + 2) % 3;
+			int64_t dx = (x[b] - x[a]) * sign, dy = (y[b] - y[a]) * sign;
+			stepX[i] = -dy * SUBPIXEL_ONE;
+			stepY[i] = dx * SUBPIXEL_ONE;
+			origin[i] = dx * (half - y[a]) - dy * (half - x[a]);
+			// Top: horizontal and walked rightward; left: walked upward (y points down)
+			minimum[i] = (dy < 0 || (dy == 0 && dx > 0)) ? 0 : 1;
+		}
+
+		// Pixel x is sampled at x * 16 + 8 subpixels
+		int64_t loX = (std::min)((std::min)(x[0], x[1]), x[2]) - reach, hiX = (std::max)((std::max)(x[0], x[1]), x[2]) + reach;
+		int64_t loY = (std::min)((std::min)(y[0], y[1]), y[2]) - reach, hiY = (std::max)((std::max)(y[0], y[1]), y[2]) + reach;
+		minX = static_cast<int>((std::max)((loX - half + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS, (int64_t)0));
+		minY = static_cast<int>((std::max)((loY - half + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS, (int64_t)0));
+		maxX = static_cast<int>((std::min)((hiX - half) >> SUBPIXEL_BITS, (int64_t)RASTER_WIDTH - 1));
+		maxY = static_cast<int>((std::min)((hiY - half) >> SUBPIXEL_BITS, (int64_t)RASTER_HEIGHT - 1));
+		return minX <= maxX && minY <= maxY;
+	}
+
+	int64_t at(int i, int x, int y) const
 	{
-		for (int x = static_cast<int>(startX); x <= static_cast<int>(endX); x++)
+		return origin[i] + x * stepX[i] + y * stepY[i];
+	}
+};
+
+// ========== SPECIALIZED RASTER VARIANTS ==========
+// The inner loop is a template over a feature mask so every combination compiles
+// to its own straight-line loop: no function pointers and no per-pixel branches
+// on features that are switched off. selectFillTriangle picks the variant once.
+
+enum RasterFeature : unsigned int {
+	RF_Textured    = 1u << 0,  // sample texture (otherwise flat vertex color)
+	RF_Lit         = 1u << 1,  // multiply by the triangle lighting factor
+	RF_DepthTest   = 1u << 2,  // depth test + depth write
+	RF_Blend       = 1u << 3,  // alpha blend source over destination
+	RF_Perspective = 1u << 4,  // perspective-correct UVs (otherwise affine)
+	RF_Overdraw    = 1u << 5,  // bump OVERDRAW_ARRAY counters (set automatically while enabled)
+	RF_DepthEqual  = 1u << 6,  // shade only where z equals the depth buffer (second pass after a pre-pass)
+	RF_Smooth      = 1u << 7,  // with RF_Lit: interpolate the corners' light (Gouraud) instead
+	RF_VariantCount = 1u << 8,
+	// Outside the table: z-only loops that leave shading to a later pass
+	RF_DepthOnly   = 1u << 8,  // depth pre-pass
+	RF_Visibility  = 1u << 9,  // depth test + triangle id into the visibility buffer
+	RF_Msaa        = 1u << 10, // coverage and depth per sample into the MSAA buffers, shaded per pixel
+	RF_MsaaFeatures = RF_Textured | RF_Lit | RF_DepthTest | RF_Blend | RF_Perspective | RF_Smooth
+};
+
+// Per-draw constants handed to a raster variant
+struct RasterState {
+	const unsigned* texture = nullptr;
+	int texWidth = 0;
+	int texHeight = 0;
+	float lighting = 1.0f;
+	vec3 vertexLight[3];  // RF_Smooth: per-corner light of the current triangle
+	unsigned int color = 0xFFFFFFFF;
+	unsigned int visibilityId = 0;  // RF_Visibility: id written to covered pixels
+};
+
+typedef void (*FillTriangleFn)(const vertex&, const vertex&, const vertex&, const RasterState&);
+
+// Blend src over dst using the source alpha
+inline unsigned int blendOver(unsigned int dst, unsigned int src)
+{
+	unsigned int a = src >> 24;
+	unsigned int ia = 255 - a;
+	unsigned int rb = ((src & 0x00FF00FF) * a + (dst & 0x00FF00FF) * ia) >> 8;
+	unsigned int g = ((src & 0x0000FF00) * a + (dst & 0x0000FF00) * ia) >> 8;
+	return 0xFF000000 | (rb & 0x00FF00FF) | (g & 0x0000FF00);
+}
+
+// Depth at barycentrics (b0, b1, b2). The z-only and shading loops of fillTriangleT both
+// call this, since RF_DepthEqual compares their results bit for bit; the project builds
+// with /fp:precise so the expression is not contracted into FMAs differently per variant.
+inline float interpolateDepth(const vertex& v0, const vertex& v1, const vertex& v2, float b0, float b1, float b2)
+{
+	return (v0.pos.z * b0) + (v1.pos.z * b1) + (v2.pos.z * b2);
+}
+
+template <unsigned int F>
+void fillTriangleT(const vertex& v0, const vertex& v1, const vertex& v2, const RasterState& rs)
+{
+	// No profiler zone here: triangles are too many and too short; zones sit at batch level
+	constexpr bool depthOnly = (F & RF_DepthOnly) != 0;
+	constexpr bool msaa = (F & RF_Msaa) != 0;
+	if constexpr (!depthOnly) g_RenderStats.trianglesSubmitted++;
+
+	// Zero-area and off-screen triangles never cover a pixel center (or sample)
+	TriangleEdges edges;
+	if (!edges.setup(v0, v1, v2, msaa ? MSAA_SAMPLE_REACH : 0)) { if constexpr (!depthOnly) g_RenderStats.trianglesCulled++; return; }
+	if constexpr (depthOnly) g_RenderStats.prepassTriangles++;
+	else g_RenderStats.trianglesDrawn++;
+	const int minX = edges.minX, minY = edges.minY, maxX = edges.maxX, maxY = edges.maxY;
+
+	// Integer edges decide coverage. Over the area they are the barycentrics (b0 weights
+	// v0, b1 weights v1, b2 weights v2), converted once per row and stepped in float.
+	const int64_t s0 = edges.stepX[0], s1 = edges.stepX[1], s2 = edges.stepX[2];
+	const int64_t m0 = edges.minimum[0], m1 = edges.minimum[1], m2 = edges.minimum[2];
+	const float invArea = 1.0f / static_cast<float>(edges.area);
+	const float a0 = s0 * invArea, a1 = s1 * invArea, a2 = s2 * invArea;
+
+	// Z-only loops, with the same coverage and z (interpolateDepth) as the shading loop below,
+	// so equal-depth tests after the pre-pass match exactly. The pre-pass keeps the nearest
+	// depth; the visibility buffer also keeps the id of the triangle that owns it.
+	if constexpr (depthOnly || (F & RF_Visibility) != 0) {
+		unsigned int covered = 0, written = 0;
+		unsigned int* ids = g_VisibilityBuffer.getIds();
+		for (int y = minY; y <= maxY; y++)
 		{
-			Triangle tri = baryRatio(v0, v1, v2, static_cast<float>(x), static_cast<float>(y));
-			if (tri.b >= 0 && tri.b <= 1 && tri.y >= 0 && tri.y <= 1 && tri.a >= 0 && tri.a <= 1)
+			int64_t e0 = edges.at(0, minX, y), e1 = edges.at(1, minX, y), e2 = edges.at(2, minX, y);
+			float b0 = e0 * invArea, b1 = e1 * invArea, b2 = e2 * invArea;
+			int row = y * RASTER_WIDTH;
+
+			for (int x = minX; x <= maxX; x++, e0 += s0, e1 += s1, e2 += s2, b0 += a0, b1 += a1, b2 += a2)
 			{
-				// Interpolate adjusted values
-				float wInterp = (w0 * tri.a) + (w1 * tri.b) + (w2 * tri.y);
-				float uInterp = (u0 * tri.a) + (u1 * tri.b) + (u2 * tri.y);
-				float vInterp = (v0_u * tri.a) + (v1_u * tri.b) + (v2_u * tri.y);
+				if (e0 < m0 || e1 < m1 || e2 < m2) continue;
+				int index = row + x;
+				float z = interpolateDepth(v0, v1, v2, b0, b1, b2);
+				covered++;
+				if constexpr ((F & RF_Overdraw) != 0) {
+					OVERDRAW_ARRAY[index] += OVERDRAW_TEST;
+				}
+				if (!(z < DEPTH_ARRAY[index])) continue;
+				DEPTH_ARRAY[index] = z;
+				if constexpr (!depthOnly) {
+					ids[index] = rs.visibilityId;
+					written++;
+				}
+			}
+		}
+		if constexpr (depthOnly) {
+			g_RenderStats.prepassPixels += covered;
+		} else {
+			g_RenderStats.pixelsTested += covered;
+			g_RenderStats.visibilityWrites += written;
+		}
+		return;
+	}
 
-				// Final correction
-				float u = uInterp / wInterp;
-				float v = vInterp / wInterp;
-				float z = (v0.pos.z * tri.a) + (v1.pos.z * tri.b) + (v2.pos.z * tri.y);
+	// Attributes to interpolate (divided by z when perspective-correct)
+	float w0 = 1.0f, w1 = 1.0f, w2 = 1.0f;
+	if constexpr ((F & RF_Perspective) != 0) {
+		w0 = 1.0f / v0.pos.z;
+		w1 = 1.0f / v1.pos.z;
+		w2 = 1.0f / v2.pos.z;
+	}
+	float u0 = v0.u * w0, u1 = v1.u * w1, u2 = v2.u * w2;
+	float t0 = v0.v * w0, t1 = v1.v * w1, t2 = v2.v * w2;
 
-				// Sample texture color
-				unsigned int texColor = sampleTexture(texture, texWidth, texHeight, u, v);
+	constexpr bool flatLit = (F & RF_Lit) != 0 && (F & RF_Smooth) == 0;
+	constexpr bool smoothLit = (F & RF_Lit) != 0 && (F & RF_Smooth) != 0;
+	unsigned int flatColor = rs.color;
+	if constexpr ((F & RF_Textured) == 0 && flatLit) {
+		flatColor = applyLighting(flatColor, rs.lighting);
+	}
+	const vec3* light = rs.vertexLight;
 
-				// Apply lighting to the texture color
-				texColor = applyLighting(texColor, g_currentLightingFactor);
+	// Texture and lighting at one point of the triangle
+	auto shade = [&](float b0, float b1, float b2)
+	{
+		unsigned int color = flatColor;
+		if constexpr ((F & RF_Textured) != 0) {
+			float u = (u0 * b0) + (u1 * b1) + (u2 * b2);
+			float v = (t0 * b0) + (t1 * b1) + (t2 * b2);
+			if constexpr ((F & RF_Perspective) != 0) {
+				float invW = 1.0f / ((w0 * b0) + (w1 * b1) + (w2 * b2));
+				u *= invW;
+				v *= invW;
+			}
+			color = sampleTexture(rs.texture, rs.texWidth, rs.texHeight, u, v);
+			if constexpr (flatLit) {
+				color = applyLighting(color, rs.lighting);
+			}
+		}
+		if constexpr (smoothLit) {
+			vec3 l = { light[0].x * b0 + light[1].x * b1 + light[2].x * b2,
+			           light[0].y * b0 + light[1].y * b1 + light[2].y * b2,
+			           light[0].z * b0 + light[1].z * b1 + light[2].z * b2 };
+			color = applyLightingRGB(color, l);
+		}
+		return color;
+	};
 
-				// Draw the pixel with the sampled texture color
-				pixelDrawer(x, y, z, texColor);
+	// Multisampled: coverage and depth per sample, shaded once per pixel at its center
+	// (attributes extrapolate slightly on pixels whose center is outside)
+	if constexpr (msaa) {
+		int64_t sampleEdge[3][MSAA_SAMPLES];
+		float sampleZ[MSAA_SAMPLES];
+		const float zx = v0.pos.z * a0 + v1.pos.z * a1 + v2.pos.z * a2;
+		const float zy = (v0.pos.z * edges.stepY[0] + v1.pos.z * edges.stepY[1] + v2.pos.z * edges.stepY[2]) * invArea;
+		for (int s = 0; s < MSAA_SAMPLES; s++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				sampleEdge[i][s] = (MSAA_SAMPLE_X[s] * edges.stepX[i] + MSAA_SAMPLE_Y[s] * edges.stepY[i]) / SUBPIXEL_ONE;
+			}
+			sampleZ[s] = (MSAA_SAMPLE_X[s] * zx + MSAA_SAMPLE_Y[s] * zy) * (1.0f / SUBPIXEL_ONE);
+		}
+		float* sampleDepth = g_MsaaBuffer.getDepth();
+		unsigned int* sampleColor = g_MsaaBuffer.getColor();
+		uint8_t* written = g_MsaaBuffer.getWritten();
+		unsigned int tested = 0, shaded = 0, partial = 0;
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			int64_t e0 = edges.at(0, minX, y), e1 = edges.at(1, minX, y), e2 = edges.at(2, minX, y);
+			float b0 = e0 * invArea, b1 = e1 * invArea, b2 = e2 * invArea;
+			int row = y * RASTER_WIDTH;
+
+			for (int x = minX; x <= maxX; x++, e0 += s0, e1 += s1, e2 += s2, b0 += a0, b1 += a1, b2 += a2)
+			{
+				unsigned int covered = 0;
+				for (int s = 0; s < MSAA_SAMPLES; s++)
+				{
+					if (e0 + sampleEdge[0][s] >= m0 && e1 + sampleEdge[1][s] >= m1 && e2 + sampleEdge[2][s] >= m2)
+						covered |= 1u << s;
+				}
+				if (!covered) continue;
+
+				int index = row + x;
+				float zCenter = (v0.pos.z * b0) + (v1.pos.z * b1) + (v2.pos.z * b2);
+				float* depth = sampleDepth + index * MSAA_SAMPLES;
+				unsigned int passed = covered;
+				if constexpr ((F & RF_DepthTest) != 0) {
+					for (int s = 0; s < MSAA_SAMPLES; s++)
+					{
+						if (!(zCenter + sampleZ[s] < depth[s])) passed &= ~(1u << s);
+					}
+				}
+				tested++;
+				partial += covered != (1u << MSAA_SAMPLES) - 1;
+				if (!passed) continue;
+
+				unsigned int color = shade(b0, b1, b2);
+				unsigned int* samples = sampleColor + index * MSAA_SAMPLES;
+				for (int s = 0; s < MSAA_SAMPLES; s++)
+				{
+					if (!(passed & (1u << s))) continue;
+					if constexpr ((F & RF_DepthTest) != 0) {
+						depth[s] = zCenter + sampleZ[s];
+					}
+					if constexpr ((F & RF_Blend) != 0) {
+						samples[s] = blendOver((written[index] >> s) & 1 ? samples[s] : SCREEN_ARRAY[index], color);
+					} else {
+						samples[s] = color;
+					}
+				}
+				written[index] |= static_cast<uint8_t>(passed);
+				shaded++;
+			}
+		}
+		g_RenderStats.pixelsTested += tested;
+		g_RenderStats.pixelsShaded += shaded;
+		g_RenderStats.msaaEdgePixels += partial;
+		return;
+	}
+
+	// Counted locally and added once, so the stats stay out of the inner loop's memory traffic
+	unsigned int tested = 0, shaded = 0;
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		int64_t e0 = edges.at(0, minX, y), e1 = edges.at(1, minX, y), e2 = edges.at(2, minX, y);
+		float b0 = e0 * invArea, b1 = e1 * invArea, b2 = e2 * invArea;
+		int row = y * RASTER_WIDTH;
+
+		for (int x = minX; x <= maxX; x++, e0 += s0, e1 += s1, e2 += s2, b0 += a0, b1 += a1, b2 += a2)
+		{
+			if (e0 < m0 || e1 < m1 || e2 < m2) continue;
+
+			int index = row + x;
+			float z = interpolateDepth(v0, v1, v2, b0, b1, b2);
+			tested++;
+			if constexpr ((F & RF_Overdraw) != 0) {
+				OVERDRAW_ARRAY[index] += OVERDRAW_TEST;
+			}
+			if constexpr ((F & RF_DepthTest) != 0) {
+				if (!(z < DEPTH_ARRAY[index])) continue;
 			}
+			if constexpr ((F & RF_DepthEqual) != 0) {
+				if (z != DEPTH_ARRAY[index]) continue;
+			}
+
+			unsigned int color = shade(b0, b1, b2);
+
+			if constexpr ((F & RF_Blend) != 0) {
+				color = blendOver(SCREEN_ARRAY[index], color);
+			}
+			if constexpr ((F & RF_DepthTest) != 0) {
+				DEPTH_ARRAY[index] = z;
+			}
+			if constexpr ((F & RF_DepthEqual) != 0) {
+				// One step nearer, so later fragments tied at this depth are rejected (the
+				// first one wins, as with the single-pass "less" test)
+				DEPTH_ARRAY[index] = nextafterf(z, -1.0f);
+			}
+			SCREEN_ARRAY[index] = color;
+			shaded++;
+			if constexpr ((F & RF_Overdraw) != 0) {
+				OVERDRAW_ARRAY[index] += OVERDRAW_WRITE;
+			}
+		}
+	}
+	g_RenderStats.pixelsTested += tested;
+	g_RenderStats.pixelsShaded += shaded;
+}
+
+template <size_t... I>
+constexpr std::array<FillTriangleFn, sizeof...(I)> makeFillTriangleTable(std::index_sequence<I...>)
+{
+	return { { &fillTriangleT<static_cast<unsigned int>(I)>... } };
+}
+
+// One instantiation per feature combination, indexed by the mask
+inline const std::array<FillTriangleFn, RF_VariantCount> g_FillTriangleVariants =
+	makeFillTriangleTable(std::make_index_sequence<RF_VariantCount>());
+
+template <size_t... I>
+constexpr std::array<FillTriangleFn, sizeof...(I)> makeMsaaFillTriangleTable(std::index_sequence<I...>)
+{
+	return { { &fillTriangleT<(static_cast<unsigned int>(I) & RF_MsaaFeatures) | RF_Msaa>... } };
+}
+
+// Multisampled variants, indexed like g_FillTriangleVariants (masks that differ only in
+// features MSAA ignores share an instantiation)
+inline const std::array<FillTriangleFn, RF_VariantCount> g_FillTriangleMsaaVariants =
+	makeMsaaFillTriangleTable(std::make_index_sequence<RF_VariantCount>());
+
+// Features of the draw currently recording into the visibility buffer
+inline unsigned int g_VisibilityFeatures = 0;
+
+// Record a triangle's shading inputs as attribute planes, then rasterize its id
+inline void visibilityTriangle(const vertex& v0, const vertex& v1, const vertex& v2, const RasterState& rs)
+{
+	float area = (v1.pos.x - v0.pos.x) * (v2.pos.y - v0.pos.y) - (v1.pos.y - v0.pos.y) * (v2.pos.x - v0.pos.x);
+	RasterState idState = rs;
+	if (area != 0.0f)
+	{
+		// Barycentric planes over pixel coordinates (sampled at pixel centers, like
+		// fillTriangleT), folded into one plane per attribute
+		float invArea = 1.0f / area;
+		float a[3] = { (v1.pos.y - v2.pos.y) * invArea, (v2.pos.y - v0.pos.y) * invArea, (v0.pos.y - v1.pos.y) * invArea };
+		float c[3] = { (v2.pos.x - v1.pos.x) * invArea, (v0.pos.x - v2.pos.x) * invArea, (v1.pos.x - v0.pos.x) * invArea };
+		float k[3] = { (v1.pos.x * v2.pos.y - v2.pos.x * v1.pos.y) * invArea,
+		               (v2.pos.x * v0.pos.y - v0.pos.x * v2.pos.y) * invArea,
+		               (v0.pos.x * v1.pos.y - v1.pos.x * v0.pos.y) * invArea };
+		bool perspective = (g_VisibilityFeatures & RF_Perspective) != 0;
+		float w[3] = { 1.0f, 1.0f, 1.0f };
+		if (perspective)
+		{
+			w[0] = 1.0f / v0.pos.z;
+			w[1] = 1.0f / v1.pos.z;
+			w[2] = 1.0f / v2.pos.z;
+		}
+		float u[3] = { v0.u * w[0], v1.u * w[1], v2.u * w[2] };
+		float t[3] = { v0.v * w[0], v1.v * w[1], v2.v * w[2] };
+
+		VisibilityTriangle tri;
+		for (int p = 0; p < 3; p++)
+		{
+			const float* plane = p == 0 ? a : (p == 1 ? c : k);
+			tri.u[p] = u[0] * plane[0] + u[1] * plane[1] + u[2] * plane[2];
+			tri.v[p] = t[0] * plane[0] + t[1] * plane[1] + t[2] * plane[2];
+			tri.w[p] = w[0] * plane[0] + w[1] * plane[1] + w[2] * plane[2];
+			const vec3* l = rs.vertexLight;
+			tri.light[0][p] = l[0].x * plane[0] + l[1].x * plane[1] + l[2].x * plane[2];
+			tri.light[1][p] = l[0].y * plane[0] + l[1].y * plane[1] + l[2].y * plane[2];
+			tri.light[2][p] = l[0].z * plane[0] + l[1].z * plane[1] + l[2].z * plane[2];
+		}
+		tri.lighting = rs.lighting;
+		bool flatLit = (g_VisibilityFeatures & (RF_Lit | RF_Smooth)) == RF_Lit;
+		tri.flatColor = flatLit ? applyLighting(rs.color, rs.lighting) : rs.color;
+		VisibilityDraw draw;
+		draw.texture = (g_VisibilityFeatures & RF_Textured) ? rs.texture : nullptr;
+		draw.texWidth = rs.texWidth;
+		draw.texHeight = rs.texHeight;
+		draw.color = rs.color;
+		draw.features = g_VisibilityFeatures;
+		tri.draw = g_VisibilityBuffer.addDraw(draw);
+		idState.visibilityId = g_VisibilityBuffer.addTriangle(tri);
+	}
+	if (OVERDRAW_ARRAY) fillTriangleT<RF_Visibility | RF_Overdraw>(v0, v1, v2, idState);
+	else fillTriangleT<RF_Visibility>(v0, v1, v2, idState);
+}
+
+// Stands in for draws the current pass leaves out
+inline void skipTriangle(const vertex&, const vertex&, const vertex&, const RasterState&)
+{
+}
+
+// Pick the raster variant for a draw (once per draw, not per triangle or pixel)
+inline FillTriangleFn selectFillTriangle(unsigned int features)
+{
+	// MSAA pass: every draw goes to the sample buffers (neither the pre-pass nor the
+	// visibility buffer runs inside it)
+	if (g_MsaaBuffer.isActive())
+	{
+		return g_FillTriangleMsaaVariants[features & (RF_VariantCount - 1)];
+	}
+	// Depth pre-pass: opaque draws go z-only, then shade on equal depth. Other draws
+	// (blended or without a depth test) wait for the shading pass.
+	bool opaque = (features & RF_DepthTest) != 0 && (features & RF_Blend) == 0;
+	// Visibility buffer: likewise, only opaque draws are recorded; the rest are drawn
+	// after the resolve (RasterPass::NonOpaque)
+	if (g_VisibilityBuffer.isActive())
+	{
+		if (!opaque)
+		{
+			g_VisibilityBuffer.skipDraw();
+			return &skipTriangle;
 		}
+		g_VisibilityFeatures = features & (RF_Textured | RF_Lit | RF_Perspective | RF_Smooth);
+		return &visibilityTriangle;
+	}
+	if (g_RasterPass == RasterPass::DepthOnly)
+	{
+		return opaque ? &fillTriangleT<RF_DepthOnly> : &skipTriangle;
 	}
+	if (g_RasterPass == RasterPass::NonOpaque && opaque)
+	{
+		return &skipTriangle;
+	}
+	if (g_RasterPass == RasterPass::DepthEqual && opaque)
+	{
+		features = (features & ~RF_DepthTest) | RF_DepthEqual;
+	}
+	if (OVERDRAW_ARRAY) features |= RF_Overdraw;
+	return g_FillTriangleVariants[features & (RF_VariantCount - 1)];
+}
+
+// Default feature set for opaque geometry (smooth: the vertices carry normals)
+inline unsigned int defaultRasterFeatures(const unsigned* texture, bool smooth = false)
+{
+	return (texture ? RF_Textured : 0u) | RF_Lit | RF_DepthTest | RF_Perspective | (smooth ? RF_Smooth : 0u);
 }
 
+void fillTriangle(vertex v0, vertex v1, vertex v2, const unsigned* texture, int texWidth, int texHeight)
+{
+	RasterState rs;
+	rs.texture = texture;
+	rs.texWidth = texWidth;
+	rs.texHeight = texHeight;
+	rs.color = v0.color;
+	selectFillTriangle(defaultRasterFeatures(texture))(v0, v1, v2, rs);
+}
+
+// NDC -> pixels, snapped to the rasterizer's subpixel grid
 vertex toScreen(vertex inp)
 {
-	int x = static_cast<int>((inp.pos.x + 1) * (RASTER_WIDTH / 2));
-	int y = static_cast<int>((1 - inp.pos.y) * (RASTER_HEIGHT / 2));
 	vertex ans;
-	ans.pos.x = static_cast<float>(x);
-	ans.pos.y = static_cast<float>(y);
+	ans.pos.x = snapSubpixel((inp.pos.x + 1) * (RASTER_WIDTH * 0.5f));
+	ans.pos.y = snapSubpixel((1 - inp.pos.y) * (RASTER_HEIGHT * 0.5f));
 	ans.pos.z = inp.pos.z;
 	ans.u = inp.u;
 	ans.v = inp.v;
@@ -277,7 +745,8 @@ bool clipLineNearPlane(vertex& v0, vertex& v1, float nearPlane) {
 	return true;
 }
 
-void drawLine(const vertex& Start, const vertex& End, unsigned color) {
+// World-space line to screen space (near-plane clipped); false when entirely behind the camera
+bool projectLine(const vertex& Start, const vertex& End, vertex& screenStart, vertex& screenEnd) {
 	vertex v0 = Start;
 	vertex v1 = End;
 	
@@ -289,7 +758,7 @@ void drawLine(const vertex& Start, const vertex& End, unsigned color) {
 	
 	// Clip against near plane in view space
 	if (!clipLineNearPlane(v0, v1, SV_NearPlane)) {
-		return; // Line is entirely behind camera
+		return false; // Line is entirely behind camera
 	}
 	
 	// Project to clip space
@@ -309,8 +778,16 @@ void drawLine(const vertex& Start, const vertex& End, unsigned color) {
 	}
 	
 	// Convert to screen space
-	vertex screenStart = toScreen(v0);
-	vertex screenEnd = toScreen(v1);
+	screenStart = toScreen(v0);
+	screenEnd = toScreen(v1);
+	return true;
+}
+
+void drawLine(const vertex& Start, const vertex& End, unsigned color) {
+	vertex screenStart, screenEnd;
+	if (!projectLine(Start, End, screenStart, screenEnd)) {
+		return;
+	}
 	
 	// Apply pixel shader if set
 	Pixel copyColor;
@@ -322,34 +799,336 @@ void drawLine(const vertex& Start, const vertex& End, unsigned color) {
 	LineDrawer(screenStart, screenEnd, copyColor.color);
 }
 
+// Run one corner through the vertex stage: world position (for face lighting) and screen vertex
+inline void transformCorner(const vertex& v, vec4& world, vertex& screen)
+{
+	world = matrixMultiplicationVec(SV_WorldMatrix, v.pos);
+	vertex copy = v;
+	if (VertexShader)
+	{
+		VertexShader(copy);
+	}
+	screen = toScreen(copy);
+}
+
+// Smooth lighting for the corners of one draw: the normal goes to world space and the
+// scene lights are evaluated once per vertex (or read from SV_BakedVertexLight)
+struct VertexLighting
+{
+	bool enabled = false;
+	const vec3* baked = nullptr;
+	matrix3x3 normalMat;
+	vec3 eye;
+
+	// smooth: the draw's vertices carry normals; indexed: baked light can be looked up
+	void begin(bool smooth, bool indexed)
+	{
+		enabled = smooth && g_RasterPass != RasterPass::DepthOnly;
+		baked = indexed ? SV_BakedVertexLight : nullptr;
+		if (!enabled || baked) return;
+		normalMat = normalMatrix(SV_WorldMatrix);
+		eye = cameraWorldPosition();
+	}
+
+	vec3 light(const vertex& v, unsigned int index, const vec4& world) const
+	{
+		if (baked)
+		{
+			g_RenderStats.vertexLightsBaked++;
+			return baked[index];
+		}
+		g_RenderStats.vertexLightings++;
+		vec3 pos = { world.x, world.y, world.z };
+		return calculateVertexLighting(pos, transformNormal(normalMat, v.normal), &eye);
+	}
+};
+
+// Light and rasterize one triangle from transformed corners (light: the corners' smooth
+// lighting, or nullptr for one flat factor from the face normal)
+inline void fillTransformedTriangle(FillTriangleFn fill, RasterState& rs, const vec4 world[3], const vertex screen[3],
+                                    const vec3* light = nullptr)
+{
+	// The depth pre-pass needs no lighting
+	if (g_RasterPass == RasterPass::DepthOnly)
+	{
+		fill(screen[0], screen[1], screen[2], rs);
+		return;
+	}
+	if (light)
+	{
+		rs.vertexLight[0] = light[0];
+		rs.vertexLight[1] = light[1];
+		rs.vertexLight[2] = light[2];
+	}
+	else
+	{
+		// Calculate face normal and lighting in world space
+		vec3 faceNormal = calculateFaceNormal(world[0], world[1], world[2]);
+		rs.lighting = calculateLighting(faceNormal);
+	}
+	fill(screen[0], screen[1], screen[2], rs);
+}
+
+// Transform, light and rasterize one triangle with an already selected variant
+inline void drawTriangleWith(FillTriangleFn fill, RasterState& rs, const VertexLighting& lighting,
+                             const vertex& v0, const vertex& v1, const vertex& v2)
+{
+	vec4 world[3];
+	vertex screen[3];
+	transformCorner(v0, world[0], screen[0]);
+	transformCorner(v1, world[1], screen[1]);
+	transformCorner(v2, world[2], screen[2]);
+	if (lighting.enabled)
+	{
+		vec3 light[3] = { lighting.light(v0, 0, world[0]), lighting.light(v1, 1, world[1]), lighting.light(v2, 2, world[2]) };
+		fillTransformedTriangle(fill, rs, world, screen, light);
+		return;
+	}
+	fillTransformedTriangle(fill, rs, world, screen);
+}
+
+// FIFO post-transform vertex cache for indexed draws: a corner whose index was among
+// the last VERTEX_CACHE_SIZE transformed reuses that result. Index order decides the
+// hit rate (see MeshOptimize.h).
+struct PostTransformCache
+{
+	unsigned int tags[VERTEX_CACHE_SIZE];
+	vec4 world[VERTEX_CACHE_SIZE];
+	vertex screen[VERTEX_CACHE_SIZE];
+	vec3 light[VERTEX_CACHE_SIZE];
+	int next = 0;
+
+	void reset()
+	{
+		for (int i = 0; i < VERTEX_CACHE_SIZE; i++) tags[i] = ~0u;
+		next = 0;
+	}
+
+	// Copies the corner out (a later miss in the same triangle may evict its slot)
+	void fetch(const vertex* vertices, unsigned int index, const VertexLighting& lighting,
+	           vec4& outWorld, vertex& outScreen, vec3& outLight)
+	{
+		for (int i = 0; i < VERTEX_CACHE_SIZE; i++)
+		{
+			if (tags[i] == index)
+			{
+				outWorld = world[i];
+				outScreen = screen[i];
+				outLight = light[i];
+				g_RenderStats.vertexCacheHits++;
+				return;
+			}
+		}
+		transformCorner(vertices[index], world[next], screen[next]);
+		if (lighting.enabled) light[next] = lighting.light(vertices[index], index, world[next]);
+		tags[next] = index;
+		outWorld = world[next];
+		outScreen = screen[next];
+		outLight = light[next];
+		next = (next + 1) % VERTEX_CACHE_SIZE;
+		g_RenderStats.vertexTransforms++;
+	}
+};
+
 void DrawTriangle(vertex& v0, vertex& v1, vertex& v2, const unsigned* texture, int texWidth, int texHeight)
 {
-	vertex copy_v0 = v0;
-	vertex copy_v1 = v1;
-	vertex copy_v2 = v2;
+	RasterState rs;
+	rs.texture = texture;
+	rs.texWidth = texWidth;
+	rs.texHeight = texHeight;
+	rs.color = v0.color;
+	bool smooth = g_SmoothLighting && hasNormal(v0) && hasNormal(v1) && hasNormal(v2);
+	VertexLighting lighting;
+	lighting.begin(smooth, false);
+	drawTriangleWith(selectFillTriangle(defaultRasterFeatures(texture, smooth)), rs, lighting, v0, v1, v2);
+}
+
+// Draw an indexed triangle list with one variant selection for the whole draw
+void DrawTriangles(const vertex* vertices, const unsigned int* indices, size_t indexCount,
+                   const unsigned* texture, int texWidth, int texHeight, unsigned int color)
+{
+	PROFILE_SCOPE("DrawTriangles");
+	RasterState rs;
+	rs.texture = texture;
+	rs.texWidth = texWidth;
+	rs.texHeight = texHeight;
+	rs.color = color;
+	// Decided from the buffer's first vertex, not the first index, so every index range
+	// of one mesh (meshlets, LODs) is lit the same way
+	bool smooth = g_SmoothLighting && indexCount > 0 && hasNormal(vertices[0]);
+	FillTriangleFn fill = selectFillTriangle(defaultRasterFeatures(texture, smooth));
+	VertexLighting lighting;
+	lighting.begin(smooth, true);
 
-	// Transform vertices to world space for lighting calculation
-	vertex world_v0 = v0;
-	vertex world_v1 = v1;
-	vertex world_v2 = v2;
-	world_v0.pos = matrixMultiplicationVec(SV_WorldMatrix, v0.pos);
-	world_v1.pos = matrixMultiplicationVec(SV_WorldMatrix, v1.pos);
-	world_v2.pos = matrixMultiplicationVec(SV_WorldMatrix, v2.pos);
+	PostTransformCache cache;
+	cache.reset();
+	vec4 world[3];
+	vertex screen[3];
+	vec3 light[3];
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		cache.fetch(vertices, indices[i], lighting, world[0], screen[0], light[0]);
+		cache.fetch(vertices, indices[i + 1], lighting, world[1], screen[1], light[1]);
+		cache.fetch(vertices, indices[i + 2], lighting, world[2], screen[2], light[2]);
+		fillTransformedTriangle(fill, rs, world, screen, lighting.enabled ? light : nullptr);
+	}
+}
 
-	// Calculate face normal and lighting
-	vec3 faceNormal = calculateFaceNormal(world_v0.pos, world_v1.pos, world_v2.pos);
-	g_currentLightingFactor = calculateLighting(faceNormal);
+// Shade one row of the visibility buffer: every covered pixel once, with the texture and
+// lighting of the triangle that owns it. Neighboring pixels mostly share a triangle, so
+// its record is looked up once per run.
+inline unsigned int resolveVisibilityRow(int y)
+{
+	const unsigned int* ids = g_VisibilityBuffer.getIds() + y * RASTER_WIDTH;
+	unsigned int* dest = SCREEN_ARRAY + y * RASTER_WIDTH;
+	unsigned int* overdraw = OVERDRAW_ARRAY ? OVERDRAW_ARRAY + y * RASTER_WIDTH : nullptr;
+	float fy = y + 0.5f;
+	unsigned int shaded = 0;
+	unsigned int currentId = 0;
+	const VisibilityTriangle* tri = nullptr;
+	const VisibilityDraw* draw = nullptr;
+	bool textured = false, flatLit = false, smoothLit = false, perspective = false;
+	float uRow = 0.0f, vRow = 0.0f, wRow = 0.0f;
+	vec3 lightRow = { 0.0f, 0.0f, 0.0f };
 
-	if (VertexShader)
+	for (int x = 0; x < RASTER_WIDTH; x++)
 	{
-		VertexShader(copy_v0);
-		VertexShader(copy_v1);
-		VertexShader(copy_v2);
-	}
-	vertex screen_v0 = toScreen(copy_v0);
-	vertex screen_v1 = toScreen(copy_v1);
-	vertex screen_v2 = toScreen(copy_v2);
-	fillTriangle(screen_v0, screen_v1, screen_v2, texture, texWidth, texHeight);
+		unsigned int id = ids[x];
+		if (id == 0) continue;
+		if (id != currentId)
+		{
+			currentId = id;
+			tri = &g_VisibilityBuffer.getTriangle(id);
+			draw = &g_VisibilityBuffer.getDraw(tri->draw);
+			textured = draw->texture != nullptr;
+			flatLit = (draw->features & (RF_Lit | RF_Smooth)) == RF_Lit;
+			smoothLit = (draw->features & (RF_Lit | RF_Smooth)) == (RF_Lit | RF_Smooth);
+			perspective = (draw->features & RF_Perspective) != 0;
+			uRow = tri->u[1] * fy + tri->u[2];
+			vRow = tri->v[1] * fy + tri->v[2];
+			wRow = tri->w[1] * fy + tri->w[2];
+			lightRow = { tri->light[0][1] * fy + tri->light[0][2], tri->light[1][1] * fy + tri->light[1][2],
+			             tri->light[2][1] * fy + tri->light[2][2] };
+		}
+
+		unsigned int color = tri->flatColor;
+		if (textured)
+		{
+			float fx = x + 0.5f;
+			float u = tri->u[0] * fx + uRow;
+			float v = tri->v[0] * fx + vRow;
+			if (perspective)
+			{
+				float invW = 1.0f / (tri->w[0] * fx + wRow);
+				u *= invW;
+				v *= invW;
+			}
+			color = sampleTexture(draw->texture, draw->texWidth, draw->texHeight, u, v);
+			if (flatLit) color = applyLighting(color, tri->lighting);
+		}
+		if (smoothLit)
+		{
+			float fx = x + 0.5f;
+			vec3 l = { tri->light[0][0] * fx + lightRow.x, tri->light[1][0] * fx + lightRow.y, tri->light[2][0] * fx + lightRow.z };
+			color = applyLightingRGB(color, l);
+		}
+		dest[x] = color;
+		shaded++;
+		if (overdraw) overdraw[x] += OVERDRAW_WRITE;
+	}
+	return shaded;
+}
+
+// Shade the visibility buffer into SCREEN_ARRAY (bands of rows across the thread pool)
+// and stop recording
+void ResolveVisibilityBuffer()
+{
+	PROFILE_SCOPE("ResolveVisibilityBuffer");
+	StageTimer stage("Resolve");
+	const int ROWS_PER_BAND = 16;
+	int bands = (RASTER_HEIGHT + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+	std::vector<unsigned int> shaded(bands, 0);
+	g_ThreadPool.parallelFor(bands, [&](int band)
+	{
+		int end = (std::min)((band + 1) * ROWS_PER_BAND, RASTER_HEIGHT);
+		for (int y = band * ROWS_PER_BAND; y < end; y++)
+		{
+			shaded[band] += resolveVisibilityRow(y);
+		}
+	});
+	for (unsigned int n : shaded) g_RenderStats.pixelsShaded += n;
+	g_RenderStats.visibilityTriangles += g_VisibilityBuffer.getTriangleCount();
+	g_VisibilityBuffer.end();
+}
+
+// Average each pixel's samples into SCREEN_ARRAY (samples nothing was drawn into keep
+// what the screen already held), keep the nearest sample depth in DEPTH_ARRAY for later
+// draws, and stop multisampling
+void ResolveMsaaBuffer()
+{
+	PROFILE_SCOPE("ResolveMsaaBuffer");
+	StageTimer stage("MSAA resolve");
+	const int ROWS_PER_BAND = 16;
+	int bands = (RASTER_HEIGHT + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+	const float* sampleDepth = g_MsaaBuffer.getDepth();
+	const unsigned int* sampleColor = g_MsaaBuffer.getColor();
+	const uint8_t* written = g_MsaaBuffer.getWritten();
+	g_ThreadPool.parallelFor(bands, [&](int band)
+	{
+		int begin = band * ROWS_PER_BAND * RASTER_WIDTH;
+		int end = (std::min)((band + 1) * ROWS_PER_BAND, RASTER_HEIGHT) * RASTER_WIDTH;
+		for (int i = begin; i < end; i++)
+		{
+			unsigned int mask = written[i];
+			if (!mask) continue;
+			const unsigned int* samples = sampleColor + i * MSAA_SAMPLES;
+			unsigned int background = SCREEN_ARRAY[i];
+			unsigned int rb = 0, g = 0;
+			for (int s = 0; s < MSAA_SAMPLES; s++)
+			{
+				unsigned int c = (mask >> s) & 1 ? samples[s] : background;
+				rb += c & 0x00FF00FF;
+				g += c & 0x0000FF00;
+			}
+			// Channel sums over MSAA_SAMPLES (the low bits fall out of the masks)
+			SCREEN_ARRAY[i] = 0xFF000000 | ((rb >> MSAA_SAMPLE_SHIFT) & 0x00FF00FF) | ((g >> MSAA_SAMPLE_SHIFT) & 0x0000FF00);
+			const float* depth = sampleDepth + i * MSAA_SAMPLES;
+			float nearest = depth[0];
+			for (int s = 1; s < MSAA_SAMPLES; s++)
+			{
+				nearest = (std::min)(nearest, depth[s]);
+			}
+			DEPTH_ARRAY[i] = nearest;
+		}
+	});
+	g_MsaaBuffer.end();
+}
+
+// Draw through the 4x MSAA sample buffers and resolve
+template <typename F>
+inline void DrawWithMsaa(F&& draw)
+{
+	PROFILE_SCOPE("DrawWithMsaa");
+	g_MsaaBuffer.begin();
+	draw();
+	ResolveMsaaBuffer();
+}
+
+// Draw opaque geometry through the visibility buffer and shade it, then draw what the
+// buffer left out (blended or depth-test-free draws) over the result
+template <typename F>
+inline void DrawWithVisibilityBuffer(F&& draw)
+{
+	PROFILE_SCOPE("DrawWithVisibilityBuffer");
+	g_VisibilityBuffer.begin();
+	draw();
+	ResolveVisibilityBuffer();
+	if (g_VisibilityBuffer.hasSkippedDraws())
+	{
+		g_RasterPass = RasterPass::NonOpaque;
+		draw();
+		g_RasterPass = RasterPass::Single;
+	}
 }
 
 void Blit(const unsigned int* source, int srcWidth, int srcHeight, unsigned int* dest, int destWidth, int destHeight, int cubeFace, float scale)
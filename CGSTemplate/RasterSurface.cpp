@@ -2,6 +2,7 @@
 // Author: L.Norri CD GX1 & GX2, FullSail University
 
 #include "RasterSurface.h"// definitions
+#include "Profiler.h"
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <wingdi.h>
@@ -197,6 +198,7 @@ bool RS_Initialize(	_In_z_ const char* _studentName,
 bool RS_Update(	_In_reads_(_numPixels) const unsigned int *_argbPixels,
 				_In_range_(1, 0xFFFFFFFF) unsigned int _numPixels)
 {
+	PROFILE_SCOPE("RS_Update");
 	// Wait for the drawing surface to intialize
 	if (bitmapAllocator.valid())
 		bitmap = bitmapAllocator.get();// retreive allocated value (blocking)
@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Per-frame rendering counters, filled by the rasterizer and read by the HUD.
+// Counters are written from the render thread only.
+struct RenderStats {
+    static constexpr int MAX_STAGES = 16;
+    
+    struct Stage {
+        const char* name;  // String literal
+        double ms;
+    };
+    
+    // Geometry
+    uint64_t trianglesSubmitted = 0;  // Reached the rasterizer
+    uint64_t trianglesCulled = 0;     // Rejected before any pixel (degenerate or off-screen)
+    uint64_t trianglesDrawn = 0;      // Scan-converted
+    uint64_t vertexTransforms = 0;    // Indexed-draw corners run through the vertex stage
+    uint64_t vertexCacheHits = 0;     // Corners reused from the post-transform cache
+    uint64_t vertexLightings = 0;     // Vertices lit by evaluating the scene lights (smooth lighting)
+    uint64_t vertexLightsBaked = 0;   // ... read from a static mesh's precomputed lighting
+    uint64_t clustersTested = 0;      // Meshlets tested before drawing
+    uint64_t clustersCulled = 0;      // ... rejected whole (frustum or normal cone)
+    uint64_t occlusionTested = 0;     // Bounding boxes tested against the occlusion buffer
+    uint64_t occlusionCulled = 0;     // ... found hidden
+    uint64_t prepassTriangles = 0;    // Scan-converted by the depth pre-pass
+    
+    // Pixels
+    uint64_t pixelsTested = 0;        // Covered samples that reached the depth test
+    uint64_t pixelsShaded = 0;        // Color writes
+    uint64_t prepassPixels = 0;       // Covered samples written depth-only by the pre-pass
+    uint64_t visibilityWrites = 0;    // Triangle ids written into the visibility buffer
+    uint64_t visibilityTriangles = 0; // Triangle records the visibility buffer resolved
+    uint64_t msaaEdgePixels = 0;      // Multisampled fragments covering only some samples
+    uint64_t fxaaPixels = 0;          // Pixels the FXAA pass found on an edge and blended
+    
+    // Resources (persistent, set by whoever owns them)
+    uint64_t textureBytes = 0;
+    int sceneWidth = 0;               // Resolution of the last 3D pass (clearColorBuffer)
+    int sceneHeight = 0;
+    int gpuReadbackLatency = -1;      // Frames GPU pixels reach the screen late (-1: CPU rasterizer)
+    
+    // Timed stages of the current frame, in the order they ran
+    Stage stages[MAX_STAGES] = {};
+    int stageCount = 0;
+    
+    void beginFrame() {
+        trianglesSubmitted = trianglesCulled = trianglesDrawn = 0;
+        vertexTransforms = vertexCacheHits = 0;
+        vertexLightings = vertexLightsBaked = 0;
+        clustersTested = clustersCulled = 0;
+        occlusionTested = occlusionCulled = 0;
+        prepassTriangles = prepassPixels = 0;
+        visibilityWrites = visibilityTriangles = 0;
+        msaaEdgePixels = fxaaPixels = 0;
+        pixelsTested = pixelsShaded = 0;
+        stageCount = 0;
+    }
+    
+    // Accumulate time into a named stage (stages with the same name pointer are merged)
+    void addStageTime(const char* name, double ms) {
+        for (int i = 0; i < stageCount; i++) {
+            if (stages[i].name == name) { stages[i].ms += ms; return; }
+        }
+        if (stageCount < MAX_STAGES) stages[stageCount++] = { name, ms };
+    }
+};
+
+// Global instance
+inline RenderStats g_RenderStats;
+
+// Times the enclosing block into g_RenderStats under the given stage name
+class StageTimer {
+public:
+    explicit StageTimer(const char* stageName) : name(stageName), start(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        g_RenderStats.addStageTime(name, elapsed.count());
+    }
+    
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
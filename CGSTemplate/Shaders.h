@@ -67,9 +67,108 @@ float calculateLighting(vec3 faceNormal) {
     return (lighting > 1.0f) ? 1.0f : lighting;
 }
 
+// ========== SCENE LIGHTS ==========
+// Smooth lighting evaluates these per vertex (see calculateVertexLighting). Light 0
+// starts as the sun (SV_LightDirection, SV_SunColor), so one light gives the same
+// diffuse as flat lighting.
+
+enum LightType { LIGHT_DIRECTIONAL, LIGHT_POINT };
+
+struct Light {
+    LightType type;
+    vec3 direction;  // Directional: unit vector toward the light
+    vec3 position;   // Point: world position
+    vec3 color;
+    float range;     // Point: distance at which it has faded out
+};
+
+constexpr int MAX_LIGHTS = 8;
+Light SV_Lights[MAX_LIGHTS] = {
+    { LIGHT_DIRECTIONAL, vec3Normalize(SV_LightDirection), { 0.0f, 0.0f, 0.0f }, SV_SunColor, 0.0f }
+};
+int SV_LightCount = 1;
+unsigned int SV_LightsVersion = 0;  // Bump after changing lights (static meshes rebake)
+float SV_SpecularStrength = 0.3f;   // Blinn-Phong highlight
+float SV_SpecularPower = 32.0f;
+bool g_SmoothLighting = true;       // Per-vertex lighting for draws whose vertices have normals
+
+// Per-vertex light of the current draw when it is precomputed (static meshes), indexed
+// like the draw's vertices
+const vec3* SV_BakedVertexLight = nullptr;
+
+// Light reaching a surface point, per color channel: ambient (tinted by the sun color, as
+// flat lighting is) plus diffuse and, with an eye position, specular from every light
+vec3 calculateVertexLighting(const vec3& pos, const vec3& normal, const vec3* eye) {
+    vec3 result = { SV_SunColor.x * SV_AmbientLight, SV_SunColor.y * SV_AmbientLight, SV_SunColor.z * SV_AmbientLight };
+    float direct = 1.0f - SV_AmbientLight;
+    for (int i = 0; i < SV_LightCount; i++) {
+        const Light& light = SV_Lights[i];
+        vec3 toLight = light.direction;
+        float attenuation = 1.0f;
+        if (light.type == LIGHT_POINT) {
+            vec3 d = vec3Sub(light.position, pos);
+            float distance = sqrtf(vec3Dot(d, d));
+            if (distance >= light.range || distance <= 0.0f) continue;
+            toLight = { d.x / distance, d.y / distance, d.z / distance };
+            float falloff = 1.0f - distance / light.range;
+            attenuation = falloff * falloff;
+        }
+        
+        float intensity = vec3Dot(normal, toLight);
+        if (intensity <= 0.0f) continue;
+        if (eye) {
+            vec3 toEye = vec3Normalize(vec3Sub(*eye, pos));
+            vec3 halfway = vec3Normalize({ toLight.x + toEye.x, toLight.y + toEye.y, toLight.z + toEye.z });
+            float nh = vec3Dot(normal, halfway);
+            if (nh > 0.0f) intensity += SV_SpecularStrength * powf(nh, SV_SpecularPower);
+        }
+        intensity *= direct * attenuation;
+        result.x += light.color.x * intensity;
+        result.y += light.color.y * intensity;
+        result.z += light.color.z * intensity;
+    }
+    return result;
+}
+
+// Takes object-space normals to world space: inverse transpose of the world 3x3, so
+// normals stay perpendicular under non-uniform scale (transformNormal renormalizes)
+matrix3x3 normalMatrix(const matrix4x4& world) {
+    matrix3x3 m = { world.xx, world.xy, world.xz, world.yx, world.yy, world.yz, world.zx, world.zy, world.zz };
+    matrix3x3 inv = matrix3Inverse(m);
+    matrix3x3 result = { inv.xx, inv.yx, inv.zx, inv.xy, inv.yy, inv.zy, inv.xz, inv.yz, inv.zz };
+    return result;
+}
+
+vec3 transformNormal(const matrix3x3& normalMat, const vec3& n) {
+    return vec3Normalize(matrix3x3MulVec3(normalMat, n));
+}
+
 // Near plane distance for clipping
 float SV_NearPlane = 0.1f;
 
+// Is a world-space sphere at least partly inside the camera frustum (near and side planes)?
+// View space looks down +Z, so a side plane is |x| * projScale = z.
+bool sphereInViewFrustum(const vec3& worldCenter, float radius) {
+    vec4 view = matrixMultiplicationVec(SV_ViewMatrix, vec4{ worldCenter.x, worldCenter.y, worldCenter.z, 1.0f });
+    float xScale = SV_ProjectionMatrix.xx;
+    float yScale = SV_ProjectionMatrix.yy;
+    if (view.z + radius < SV_NearPlane) return false;
+    if (fabsf(view.x) * xScale - view.z > radius * sqrtf(xScale * xScale + 1.0f)) return false;
+    if (fabsf(view.y) * yScale - view.z > radius * sqrtf(yScale * yScale + 1.0f)) return false;
+    return true;
+}
+
+// Camera position in world space (the view matrix is a rigid transform, p * R + t)
+vec3 cameraWorldPosition() {
+    const matrix4x4& v = SV_ViewMatrix;
+    vec3 t = { v.axisW.x, v.axisW.y, v.axisW.z };
+    return {
+        -(t.x * v.axisX.x + t.y * v.axisX.y + t.z * v.axisX.z),
+        -(t.x * v.axisY.x + t.y * v.axisY.y + t.z * v.axisY.z),
+        -(t.x * v.axisZ.x + t.y * v.axisZ.y + t.z * v.axisZ.z)
+    };
+}
+
 // Transform vertex to view space only (for clipping)
 void VS_WorldView(vertex& v) {
     v.pos = matrixMultiplicationVec(SV_WorldMatrix, v.pos);
@@ -2,6 +2,7 @@
 #include "Cubemap.h"
 #include "Defines.h"
 #include "Shaders.h"
+#include "Profiler.h"
 #include <vector>
 #include <cmath>
 
@@ -43,6 +44,7 @@ public:
     // Uses the global SV_ViewMatrix and SV_ProjectionMatrix
     inline void render(unsigned int* screenBuffer, float* depthBuffer, int width, int height) {
         if (!enabled_ || !cubemap_.isLoaded()) return;
+        PROFILE_SCOPE("Skybox::render");
         
         // Extract camera axes from view matrix
         // The view matrix transforms world to camera, so the first 3 columns 
@@ -0,0 +1,77 @@
+#pragma once
+#include "GPUTypes.h"
+#include <vector>
+
+// TextureTable - packs every resident texture into one texel array plus an offset table.
+// GLCompute uploads both as SSBOs so triangles with different textures share a dispatch;
+// sample() performs the exact lookup rasterizer.comp does, for checking without a GPU
+// (checkTextureTable in Benchmark.h runs it on known slots and UVs).
+class TextureTable {
+private:
+    std::vector<unsigned int> texels;
+    std::vector<GPUTextureSlot> slots;
+    std::vector<const unsigned int*> sources;  // Source pointer per slot (identity for reuse)
+    size_t uploadedTexels = 0;                 // Texels already on the GPU
+    size_t uploadedSlots = 0;
+
+public:
+    // Return the slot of a texture, appending it to the table the first time it is seen
+    int acquire(const unsigned int* data, int width, int height) {
+        for (size_t i = 0; i < sources.size(); i++) {
+            if (sources[i] == data && slots[i].width == width && slots[i].height == height) {
+                return (int)i;
+            }
+        }
+        
+        GPUTextureSlot slot;
+        slot.offset = (unsigned int)texels.size();
+        slot.width = width;
+        slot.height = height;
+        slot.pad = 0;
+        texels.insert(texels.end(), data, data + (size_t)width * height);
+        slots.push_back(slot);
+        sources.push_back(data);
+        return (int)slots.size() - 1;
+    }
+    
+    // Drop every texture (e.g. on scene change)
+    void clear() {
+        texels.clear();
+        slots.clear();
+        sources.clear();
+        uploadedTexels = 0;
+        uploadedSlots = 0;
+    }
+    
+    // Same lookup as sampleTexture() in rasterizer.comp: clamp, truncate, fetch
+    unsigned int sample(int slotIndex, float u, float v) const {
+        const GPUTextureSlot& slot = slots[slotIndex];
+        u = (u < 0.0f) ? 0.0f : ((u > 1.0f) ? 1.0f : u);
+        v = (v < 0.0f) ? 0.0f : ((v > 1.0f) ? 1.0f : v);
+        int x = (int)(u * (float)(slot.width - 1));
+        int y = (int)(v * (float)(slot.height - 1));
+        return texels[slot.offset + (unsigned int)(y * slot.width + x)];
+    }
+    
+    // Texel lookup for a triangle vertex as the shader resolves it (texSlot is 1-based)
+    bool sampleForVertex(const GPUVertex& vert, float u, float v, unsigned int& outTexel) const {
+        if (vert.texSlot == 0 || vert.texSlot > slots.size()) return false;
+        outTexel = sample((int)vert.texSlot - 1, u, v);
+        return true;
+    }
+    
+    // Upload bookkeeping (what GLCompute still has to send)
+    bool hasPendingUpload() const { return uploadedTexels != texels.size() || uploadedSlots != slots.size(); }
+    size_t getUploadedTexelCount() const { return uploadedTexels; }
+    void markUploaded() {
+        uploadedTexels = texels.size();
+        uploadedSlots = slots.size();
+    }
+    
+    const std::vector<unsigned int>& getTexels() const { return texels; }
+    const std::vector<GPUTextureSlot>& getSlots() const { return slots; }
+    size_t getTextureCount() const { return slots.size(); }
+    size_t getMemoryBytes() const {
+        return texels.size() * sizeof(unsigned int) + slots.size() * sizeof(GPUTextureSlot);
+    }
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include "Profiler.h"
+
+// ThreadPool - persistent worker threads for data-parallel loops.
+// parallelFor(count, fn) calls fn(i) for every i in [0, count) across the workers and
+// the calling thread, and returns when all calls have finished. Work items are handed
+// out one at a time, so uneven items balance themselves. Nested calls run serially.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex submitMutex;                    // One parallelFor in flight at a time
+    
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextItem{0};
+    int busyWorkers = 0;
+    unsigned int generation = 0;               // Bumped for every job so workers see new work
+    bool stopping = false;
+    bool started = false;
+    std::atomic<long long> busyNs{0};           // Time spent inside items, all threads
+    
+    static bool& insideJob() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+    
+    void runItems() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool ranAny = false;
+        for (int i = nextItem++; i < jobCount; i = nextItem++) {
+            (*job)(i);
+            ranAny = true;
+        }
+        if (ranAny) {
+            busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    
+    void workerLoop() {
+        insideJob() = true;
+        PROFILE_THREAD_NAME("ThreadPool worker");
+        unsigned int seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            
+            runItems();
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) done.notify_one();
+        }
+    }
+    
+public:
+    ThreadPool() {}
+    ~ThreadPool() { stop(); }
+    
+    // Spawn workers (0 = one per hardware thread, minus the caller)
+    void start(int threadCount = 0) {
+        stop();
+        if (threadCount <= 0) {
+            int hw = (int)std::thread::hardware_concurrency();
+            threadCount = (hw > 1) ? hw - 1 : 0;
+        }
+        stopping = false;
+        for (int i = 0; i < threadCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+        started = true;
+    }
+    
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+        workers.clear();
+        started = false;
+    }
+    
+    // Busy time summed over all threads since the last call (divide by wall time * threads for utilization)
+    double takeBusyMs() {
+        return busyNs.exchange(0) / 1000000.0;
+    }
+    
+    // Threads that execute parallelFor items (workers + the caller)
+    int getThreadCount() {
+        if (!started) start();
+        return (int)workers.size() + 1;
+    }
+    
+    void parallelFor(int count, const std::function<void(int)>& fn) {
+        if (count <= 0) return;
+        if (!started) start();
+        
+        if (count == 1 || workers.empty() || insideJob()) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++) fn(i);
+            if (!insideJob()) {
+                busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+            return;
+        }
+        
+        std::lock_guard<std::mutex> submit(submitMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobCount = count;
+            nextItem = 0;
+            busyWorkers = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        
+        insideJob() = true;
+        runItems();
+        insideJob() = false;
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+};
+
+// Global instance (workers start on first use)
+inline ThreadPool g_ThreadPool;
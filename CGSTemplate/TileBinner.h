@@ -0,0 +1,98 @@
+#pragma once
+#include "GPUTypes.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Tile binning shared by GLCompute and binning.comp.
+// binPrimitives() runs the exact logic of binning.comp on the CPU; the benchmark compares
+// it with the bins the GPU wrote (GLCompute::readBins). The shader appends in arbitrary
+// order, hence sameBins().
+
+const int TILE_SIZE = 16;              // Matches rasterizer.comp local_size_x/y and binning.comp
+const int MAX_PRIMS_PER_TILE = 256;    // Tiles over this fall back to the full primitive loop
+const unsigned int TILE_LINE_BIT = 0x80000000u;  // Set on list entries that refer to lines
+const float TILE_LINE_RADIUS = 0.7f;
+
+struct TileBins {
+    int tilesX = 0, tilesY = 0;
+    int maxPerTile = 0;
+    std::vector<unsigned int> counts;  // Primitives touching each tile (may exceed maxPerTile)
+    std::vector<unsigned int> lists;   // tilesX * tilesY * maxPerTile entries
+};
+
+inline void appendToTiles(TileBins& bins, int width, int height,
+                          float minX, float minY, float maxX, float maxY, unsigned int prim)
+{
+    int x0 = (std::max)((int)std::ceil(minX), 0);
+    int y0 = (std::max)((int)std::ceil(minY), 0);
+    int x1 = (std::min)((int)std::floor(maxX), width - 1);
+    int y1 = (std::min)((int)std::floor(maxY), height - 1);
+    if (x0 > x1 || y0 > y1) return;
+    
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) {
+            unsigned int tile = (unsigned int)(ty * bins.tilesX + tx);
+            unsigned int slot = bins.counts[tile]++;
+            if (slot < (unsigned int)bins.maxPerTile) {
+                bins.lists[tile * bins.maxPerTile + slot] = prim;
+            }
+        }
+    }
+}
+
+inline void binPrimitives(const GPUVertex* tris, int numTriangles, const GPUVertex* lines, int numLines,
+                          int width, int height, int maxPerTile, TileBins& bins)
+{
+    bins.tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    bins.tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    bins.maxPerTile = maxPerTile;
+    bins.counts.assign((size_t)bins.tilesX * bins.tilesY, 0u);
+    bins.lists.assign(bins.counts.size() * maxPerTile, 0u);
+    
+    for (int t = 0; t < numTriangles; t++) {
+        const GPUVertex& a = tris[t * 3 + 0];
+        const GPUVertex& b = tris[t * 3 + 1];
+        const GPUVertex& c = tris[t * 3 + 2];
+        
+        // Backface culled triangles are never binned
+        float signedArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (signedArea >= 0.0f) continue;
+        
+        appendToTiles(bins, width, height,
+                      (std::min)((std::min)(a.x, b.x), c.x), (std::min)((std::min)(a.y, b.y), c.y),
+                      (std::max)((std::max)(a.x, b.x), c.x), (std::max)((std::max)(a.y, b.y), c.y),
+                      (unsigned int)t);
+    }
+    
+    for (int l = 0; l < numLines; l++) {
+        const GPUVertex& a = lines[l * 2 + 0];
+        const GPUVertex& b = lines[l * 2 + 1];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        if (dx * dx + dy * dy < 0.001f) continue;
+        
+        appendToTiles(bins, width, height,
+                      (std::min)(a.x, b.x) - TILE_LINE_RADIUS, (std::min)(a.y, b.y) - TILE_LINE_RADIUS,
+                      (std::max)(a.x, b.x) + TILE_LINE_RADIUS, (std::max)(a.y, b.y) + TILE_LINE_RADIUS,
+                      (unsigned int)l | TILE_LINE_BIT);
+    }
+}
+
+// Compare two binnings ignoring the order of entries inside each tile list. Overflowing
+// tiles are compared by count only: which primitives got the slots depends on that order.
+inline bool sameBins(const TileBins& a, const TileBins& b)
+{
+    if (a.tilesX != b.tilesX || a.tilesY != b.tilesY || a.maxPerTile != b.maxPerTile) return false;
+    if (a.counts != b.counts) return false;
+    
+    for (size_t tile = 0; tile < a.counts.size(); tile++) {
+        if (a.counts[tile] > (unsigned int)a.maxPerTile) continue;
+        size_t n = a.counts[tile];
+        std::vector<unsigned int> la(a.lists.begin() + tile * a.maxPerTile, a.lists.begin() + tile * a.maxPerTile + n);
+        std::vector<unsigned int> lb(b.lists.begin() + tile * b.maxPerTile, b.lists.begin() + tile * b.maxPerTile + n);
+        std::sort(la.begin(), la.end());
+        std::sort(lb.begin(), lb.end());
+        if (la != lb) return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "Defines.h"
+#include <cstdint>
+#include <vector>
+
+// ========== VISIBILITY BUFFER ==========
+// Deferred texturing for the CPU rasterizer. Opaque triangles are rasterized with depth
+// and an id only; each id names a per-frame triangle record, and the record names its
+// draw (texture, color, raster features). ResolveVisibilityBuffer (RasterHelper.h) then
+// shades every covered pixel exactly once, in parallel over rows, so raster cost no
+// longer depends on material cost.
+
+inline bool g_VisibilityBufferMode = false;  // Opaque CPU draws go through the buffer
+
+// Shading state shared by a run of triangles
+struct VisibilityDraw {
+    const unsigned* texture = nullptr;
+    int texWidth = 0;
+    int texHeight = 0;
+    unsigned int color = 0xFFFFFFFF;
+    unsigned int features = 0;  // RasterFeature mask the draw was selected with
+};
+
+// Screen-space attribute planes (value = a*x + b*y + c at pixel x, y)
+struct VisibilityTriangle {
+    float u[3], v[3];    // UV (divided by z when perspective-correct)
+    float w[3];          // 1/z (perspective-correct draws)
+    float light[3][3];   // Red, green, blue light (smooth lighting)
+    float lighting;      // Face light factor (flat lighting)
+    unsigned int flatColor;  // Vertex color, already lit when flat
+    unsigned int draw;
+};
+
+class VisibilityBuffer {
+public:
+    // Start recording a frame: no pixel covered yet
+    void begin() {
+        ids.assign(NUM_PIXELS, 0u);
+        draws.clear();
+        triangles.clear();
+        skippedDraws = 0;
+        active = true;
+    }
+    
+    void end() { active = false; }
+    bool isActive() const { return active; }
+    
+    // Draws left out while recording (blended or without a depth test); they are drawn
+    // after the resolve, which would otherwise overwrite them
+    void skipDraw() { skippedDraws++; }
+    bool hasSkippedDraws() const { return skippedDraws != 0; }
+    
+    // Index of a draw with this state (consecutive triangles of a draw share one record)
+    unsigned int addDraw(const VisibilityDraw& d) {
+        if (!draws.empty()) {
+            const VisibilityDraw& last = draws.back();
+            if (last.texture == d.texture && last.color == d.color && last.features == d.features &&
+                last.texWidth == d.texWidth && last.texHeight == d.texHeight) {
+                return (unsigned int)draws.size() - 1;
+            }
+        }
+        draws.push_back(d);
+        return (unsigned int)draws.size() - 1;
+    }
+    
+    // Id to write into covered pixels (0 stays "empty")
+    unsigned int addTriangle(const VisibilityTriangle& t) {
+        triangles.push_back(t);
+        return (unsigned int)triangles.size();
+    }
+    
+    unsigned int* getIds() { return ids.data(); }
+    const VisibilityTriangle& getTriangle(unsigned int id) const { return triangles[id - 1]; }
+    const VisibilityDraw& getDraw(unsigned int index) const { return draws[index]; }
+    size_t getTriangleCount() const { return triangles.size(); }
+    size_t getDrawCount() const { return draws.size(); }
+
+private:
+    std::vector<unsigned int> ids;  // Per pixel, next to DEPTH_ARRAY
+    std::vector<VisibilityDraw> draws;
+    std::vector<VisibilityTriangle> triangles;
+    unsigned int skippedDraws = 0;
+    bool active = false;
+};
+
+// Global visibility buffer (begun by whoever draws the opaque pass)
+inline VisibilityBuffer g_VisibilityBuffer;
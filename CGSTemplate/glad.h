@@ -9,6 +9,8 @@
 typedef char GLchar;
 typedef ptrdiff_t GLsizeiptr;
 typedef ptrdiff_t GLintptr;
+typedef struct __GLsync* GLsync;
+typedef unsigned long long GLuint64;
 
 // OpenGL constants
 #define GL_COMPUTE_SHADER                 0x91B9
@@ -20,6 +22,7 @@ typedef ptrdiff_t GLintptr;
 #define GL_DYNAMIC_READ                   0x88E9
 #define GL_STREAM_READ                    0x88E1
 #define GL_STREAM_DRAW                    0x88E0
+#define GL_DYNAMIC_COPY                   0x88EA
 #define GL_STATIC_DRAW                    0x88E4
 #define GL_READ_ONLY                      0x88B8
 #define GL_WRITE_ONLY                     0x88B9
@@ -31,7 +34,25 @@ typedef ptrdiff_t GLintptr;
 #define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
 #define GL_BUFFER_UPDATE_BARRIER_BIT      0x00000200
 #define GL_SHADER_STORAGE_BARRIER_BIT     0x00002000
+#define GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT 0x00004000
 #define GL_ALL_BARRIER_BITS               0xFFFFFFFF
+#define GL_MAP_PERSISTENT_BIT             0x0040
+#define GL_MAP_COHERENT_BIT               0x0080
+#define GL_DYNAMIC_STORAGE_BIT            0x0100
+#define GL_CLIENT_STORAGE_BIT             0x0200
+#define GL_COPY_READ_BUFFER               0x8F36
+#define GL_COPY_WRITE_BUFFER              0x8F37
+#define GL_PIXEL_PACK_BUFFER              0x88EB
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#define GL_R32F                           0x822E
+#define GL_R32UI                          0x8236
+#define GL_RED_INTEGER                    0x8D94
+#define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+#define GL_ALREADY_SIGNALED               0x911A
+#define GL_TIMEOUT_EXPIRED                0x911B
+#define GL_CONDITION_SATISFIED            0x911C
+#define GL_WAIT_FAILED                    0x911D
 
 // Function pointer types
 typedef GLuint(APIENTRY* PFNGLCREATESHADERPROC)(GLenum type);
@@ -65,6 +86,14 @@ typedef void (APIENTRY* PFNGLUNIFORM3FPROC)(GLint location, GLfloat v0, GLfloat
 typedef void (APIENTRY* PFNGLUNIFORM4FPROC)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
 typedef void (APIENTRY* PFNGLUNIFORMMATRIX4FVPROC)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
 typedef GLint(APIENTRY* PFNGLGETUNIFORMLOCATIONPROC)(GLuint program, const GLchar* name);
+typedef void (APIENTRY* PFNGLBINDBUFFERRANGEPROC)(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+typedef void* (APIENTRY* PFNGLMAPBUFFERRANGEPROC)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef void (APIENTRY* PFNGLCOPYBUFFERSUBDATAPROC)(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+typedef GLsync(APIENTRY* PFNGLFENCESYNCPROC)(GLenum condition, GLbitfield flags);
+typedef GLenum(APIENTRY* PFNGLCLIENTWAITSYNCPROC)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRY* PFNGLDELETESYNCPROC)(GLsync sync);
+typedef void (APIENTRY* PFNGLCLEARBUFFERDATAPROC)(GLenum target, GLenum internalformat, GLenum format, GLenum type, const void* data);
+typedef void (APIENTRY* PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
 
 // Function pointers
 extern PFNGLCREATESHADERPROC glCreateShader;
@@ -98,6 +127,14 @@ extern PFNGLUNIFORM3FPROC glUniform3f;
 extern PFNGLUNIFORM4FPROC glUniform4f;
 extern PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv;
 extern PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+extern PFNGLBINDBUFFERRANGEPROC glBindBufferRange;
+extern PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+extern PFNGLCOPYBUFFERSUBDATAPROC glCopyBufferSubData;
+extern PFNGLFENCESYNCPROC glFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+extern PFNGLDELETESYNCPROC glDeleteSync;
+extern PFNGLCLEARBUFFERDATAPROC glClearBufferData;
+extern PFNGLBUFFERSTORAGEPROC glBufferStorage;  // GL 4.4, may be null (see GLCompute fallback)
 
 // Initialize OpenGL functions - call after creating GL context
 inline bool gladLoadGL() {
@@ -140,6 +177,16 @@ inline bool gladLoadGL() {
     LOAD_GL_FUNC(glUniform4f);
     LOAD_GL_FUNC(glUniformMatrix4fv);
     LOAD_GL_FUNC(glGetUniformLocation);
+    LOAD_GL_FUNC(glBindBufferRange);
+    LOAD_GL_FUNC(glMapBufferRange);
+    LOAD_GL_FUNC(glCopyBufferSubData);
+    LOAD_GL_FUNC(glFenceSync);
+    LOAD_GL_FUNC(glClientWaitSync);
+    LOAD_GL_FUNC(glDeleteSync);
+    LOAD_GL_FUNC(glClearBufferData);
+    
+    // Optional (GL 4.4)
+    glBufferStorage = (PFNGLBUFFERSTORAGEPROC)wglGetProcAddress_ptr("glBufferStorage");
     
     #undef LOAD_GL_FUNC
     return true;
@@ -178,4 +225,12 @@ PFNGLUNIFORM3FPROC glUniform3f = nullptr;
 PFNGLUNIFORM4FPROC glUniform4f = nullptr;
 PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv = nullptr;
 PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = nullptr;
+PFNGLBINDBUFFERRANGEPROC glBindBufferRange = nullptr;
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange = nullptr;
+PFNGLCOPYBUFFERSUBDATAPROC glCopyBufferSubData = nullptr;
+PFNGLFENCESYNCPROC glFenceSync = nullptr;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync = nullptr;
+PFNGLDELETESYNCPROC glDeleteSync = nullptr;
+PFNGLCLEARBUFFERDATAPROC glClearBufferData = nullptr;
+PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
 #endif
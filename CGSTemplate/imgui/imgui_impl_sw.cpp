@@ -4,13 +4,48 @@
 #include "imgui_impl_sw.h"
 #include "imgui.h"
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <algorithm>
+#include <vector>
+#include "../ThreadPool.h"
+#include "../Profiler.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define IMGUI_SW_SSE2 1
+#endif
 
 // Font texture data
 static unsigned char* g_FontTexture = nullptr;
 static int g_FontTextureWidth = 0;
 static int g_FontTextureHeight = 0;
 
+// Retained UI layer: premultiplied ARGB, transparent where no UI was drawn.
+// Only regions whose draw lists changed since last frame are re-rasterized.
+struct SWRect {
+    int minX, minY, maxX, maxY;  // Inclusive
+};
+
+struct SWListState {
+    unsigned long long hash;
+    SWRect bounds;
+    bool empty;
+};
+
+static bool g_RetainedLayer = true;
+static std::vector<unsigned int> g_Layer;
+static int g_LayerWidth = 0;
+static int g_LayerHeight = 0;
+static bool g_LayerValid = false;
+static std::vector<SWListState> g_LayerLists;  // Draw list hashes/bounds from the last frame
+static int g_LastDirtyPixels = 0;
+
+// Regions are split into horizontal bands rendered in parallel; every band replays all
+// commands in order, so the output is identical to rendering the region serially
+static bool g_Multithreaded = true;
+static const int MIN_BAND_ROWS = 16;
+
 bool ImGui_ImplSW_Init()
 {
     ImGuiIO& io = ImGui::GetIO();
@@ -25,6 +60,10 @@ void ImGui_ImplSW_Shutdown()
         delete[] g_FontTexture;
         g_FontTexture = nullptr;
     }
+    
+    g_Layer.clear();
+    g_LayerLists.clear();
+    g_LayerValid = false;
 }
 
 void ImGui_ImplSW_CreateFontsTexture()
@@ -43,6 +82,30 @@ void ImGui_ImplSW_CreateFontsTexture()
     
     // Set texture ID
     io.Fonts->SetTexID((ImTextureID)(intptr_t)g_FontTexture);
+    
+    // Cached glyphs refer to the old atlas
+    ImGui_ImplSW_InvalidateLayer();
+}
+
+void ImGui_ImplSW_SetRetainedLayer(bool enabled)
+{
+    g_RetainedLayer = enabled;
+    g_LayerValid = false;
+}
+
+void ImGui_ImplSW_InvalidateLayer()
+{
+    g_LayerValid = false;
+}
+
+void ImGui_ImplSW_SetMultithreaded(bool enabled)
+{
+    g_Multithreaded = enabled;
+}
+
+int ImGui_ImplSW_GetLastDirtyPixels()
+{
+    return g_LastDirtyPixels;
 }
 
 // Helper: clamp value to range
@@ -68,48 +131,59 @@ static unsigned int sampleTexture(const unsigned char* tex, int texW, int texH,
     return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
+// Exact x / 255 for x in [0, 65535] without a divide
+static inline unsigned int div255(unsigned int x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
 // Alpha blend two colors
-static unsigned int alphaBlend(unsigned int dst, unsigned int src)
+static inline unsigned int alphaBlend(unsigned int dst, unsigned int src)
 {
     unsigned int srcA = (src >> 24) & 0xFF;
     if (srcA == 0) return dst;
     if (srcA == 255) return src;
     
-    unsigned int srcR = (src >> 16) & 0xFF;
-    unsigned int srcG = (src >> 8) & 0xFF;
-    unsigned int srcB = src & 0xFF;
-    
-    unsigned int dstA = (dst >> 24) & 0xFF;
-    unsigned int dstR = (dst >> 16) & 0xFF;
-    unsigned int dstG = (dst >> 8) & 0xFF;
-    unsigned int dstB = dst & 0xFF;
-    
     unsigned int invA = 255 - srcA;
-    unsigned int outR = (srcR * srcA + dstR * invA) / 255;
-    unsigned int outG = (srcG * srcA + dstG * invA) / 255;
-    unsigned int outB = (srcB * srcA + dstB * invA) / 255;
-    unsigned int outA = srcA + (dstA * invA) / 255;
+    unsigned int outR = div255(((src >> 16) & 0xFF) * srcA + ((dst >> 16) & 0xFF) * invA);
+    unsigned int outG = div255(((src >> 8) & 0xFF) * srcA + ((dst >> 8) & 0xFF) * invA);
+    unsigned int outB = div255((src & 0xFF) * srcA + (dst & 0xFF) * invA);
+    unsigned int outA = srcA + div255(((dst >> 24) & 0xFF) * invA);
     
     return (outA << 24) | (outR << 16) | (outG << 8) | outB;
 }
 
 // Multiply vertex color with texture color
-static unsigned int multiplyColors(unsigned int texColor, unsigned int vtxColor)
+static inline unsigned int multiplyColors(unsigned int texColor, unsigned int vtxColor)
 {
-    unsigned int texA = (texColor >> 24) & 0xFF;
-    unsigned int texR = (texColor >> 16) & 0xFF;
-    unsigned int texG = (texColor >> 8) & 0xFF;
-    unsigned int texB = texColor & 0xFF;
-    
-    unsigned int vtxA = (vtxColor >> 24) & 0xFF;
-    unsigned int vtxR = (vtxColor >> 16) & 0xFF;
-    unsigned int vtxG = (vtxColor >> 8) & 0xFF;
-    unsigned int vtxB = vtxColor & 0xFF;
-    
-    return ((texA * vtxA / 255) << 24) |
-           ((texR * vtxR / 255) << 16) |
-           ((texG * vtxG / 255) << 8) |
-           (texB * vtxB / 255);
+    return (div255((texColor >> 24) * (vtxColor >> 24)) << 24) |
+           (div255(((texColor >> 16) & 0xFF) * ((vtxColor >> 16) & 0xFF)) << 16) |
+           (div255(((texColor >> 8) & 0xFF) * ((vtxColor >> 8) & 0xFF)) << 8) |
+           div255((texColor & 0xFF) * (vtxColor & 0xFF));
+}
+
+// Blend a constant color over a run of pixels
+static void fillSpan(unsigned int* row, int x0, int x1, unsigned int src)
+{
+    unsigned int srcA = src >> 24;
+    if (srcA == 0) return;
+    if (srcA == 255) {
+        std::fill(row + x0, row + x1, src);
+        return;
+    }
+    
+    // Pre-multiply once; per pixel only the destination term remains
+    unsigned int invA = 255 - srcA;
+    unsigned int preR = ((src >> 16) & 0xFF) * srcA;
+    unsigned int preG = ((src >> 8) & 0xFF) * srcA;
+    unsigned int preB = (src & 0xFF) * srcA;
+    for (int x = x0; x < x1; x++) {
+        unsigned int dst = row[x];
+        row[x] = ((srcA + div255((dst >> 24) * invA)) << 24) |
+                 (div255(preR + ((dst >> 16) & 0xFF) * invA) << 16) |
+                 (div255(preG + ((dst >> 8) & 0xFF) * invA) << 8) |
+                 div255(preB + (dst & 0xFF) * invA);
+    }
 }
 
 // Convert ImGui color to ARGB
@@ -123,151 +197,476 @@ static unsigned int imguiColorToARGB(ImU32 col)
     return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-// Render a single triangle with texture
+// Scissor rectangle in framebuffer pixels (inclusive, like the triangle bounding boxes)
+struct SWClip {
+    int minX, minY, maxX, maxY;
+};
+
+// Render an axis-aligned quad (ImGui rect: corners a,b,c,d with a/c diagonal) as spans.
+// Handles solid fills (constant UV) and glyphs/images (UV linear in x and y) with a single
+// vertex color; returns false for anything else so the caller falls back to triangles.
+static bool renderRect(
+    unsigned int* pixels, int fbWidth,
+    const ImDrawVert& a, const ImDrawVert& b, const ImDrawVert& c, const ImDrawVert& d,
+    const unsigned char* texture, int texWidth, int texHeight, const SWClip& clip)
+{
+    if (a.col != b.col || a.col != c.col || a.col != d.col) return false;
+    if (a.pos.x == c.pos.x || a.pos.y == c.pos.y) return false;
+    
+    // b and d must be the two remaining corners, with matching UVs
+    bool bOnRow = (b.pos.y == a.pos.y && b.pos.x == c.pos.x && d.pos.x == a.pos.x && d.pos.y == c.pos.y);
+    bool bOnCol = (b.pos.x == a.pos.x && b.pos.y == c.pos.y && d.pos.y == a.pos.y && d.pos.x == c.pos.x);
+    if (!bOnRow && !bOnCol) return false;
+    const ImDrawVert& rowV = bOnRow ? b : d;  // Shares y with a
+    const ImDrawVert& colV = bOnRow ? d : b;  // Shares x with a
+    if (rowV.uv.y != a.uv.y || rowV.uv.x != c.uv.x || colV.uv.x != a.uv.x || colV.uv.y != c.uv.y) return false;
+    
+    // Pixels whose centers lie inside the rect (edges inclusive)
+    float x0 = a.pos.x, y0 = a.pos.y, x1 = c.pos.x, y1 = c.pos.y;
+    float u0 = a.uv.x, v0 = a.uv.y, u1 = c.uv.x, v1 = c.uv.y;
+    if (x0 > x1) { std::swap(x0, x1); std::swap(u0, u1); }
+    if (y0 > y1) { std::swap(y0, y1); std::swap(v0, v1); }
+    int minX = std::max((int)std::ceil(x0 - 0.5f), clip.minX);
+    int maxX = std::min((int)std::floor(x1 - 0.5f), clip.maxX);
+    int minY = std::max((int)std::ceil(y0 - 0.5f), clip.minY);
+    int maxY = std::min((int)std::floor(y1 - 0.5f), clip.maxY);
+    if (minX > maxX || minY > maxY) return true;
+    
+    unsigned int vtxColor = imguiColorToARGB(a.col);
+    
+    // Solid fill: one texture fetch for the whole rect (ImGui points these at the white texel)
+    if (!texture || (u0 == u1 && v0 == v1)) {
+        unsigned int src = texture ? multiplyColors(sampleTexture(texture, texWidth, texHeight, u0, v0), vtxColor) : vtxColor;
+        for (int py = minY; py <= maxY; py++) {
+            fillSpan(pixels + py * fbWidth, minX, maxX + 1, src);
+        }
+        return true;
+    }
+    
+    // Glyph/image: UVs step linearly, texel alpha scales the vertex color
+    float dudx = (u1 - u0) / (x1 - x0);
+    float dvdy = (v1 - v0) / (y1 - y0);
+    unsigned int vtxA = vtxColor >> 24;
+    unsigned int vtxRGB = vtxColor & 0x00FFFFFF;
+    for (int py = minY; py <= maxY; py++) {
+        float v = v0 + (py + 0.5f - y0) * dvdy;
+        float u = u0 + (minX + 0.5f - x0) * dudx;
+        int ty = clamp_int((int)(clamp_float(v, 0.0f, 1.0f) * (texHeight - 1)), 0, texHeight - 1);
+        const unsigned char* texRow = texture + (size_t)ty * texWidth * 4;
+        unsigned int* row = pixels + py * fbWidth;
+        
+        for (int px = minX; px <= maxX; px++, u += dudx) {
+            int tx = clamp_int((int)(clamp_float(u, 0.0f, 1.0f) * (texWidth - 1)), 0, texWidth - 1);
+            const unsigned char* texel = texRow + tx * 4;
+            unsigned int texA = texel[3];
+            if (texA == 0) continue;
+            
+            if (texel[0] == 255 && texel[1] == 255 && texel[2] == 255) {
+                // Alpha-mask blit (font atlas texels are white; only alpha varies)
+                row[px] = alphaBlend(row[px], (div255(texA * vtxA) << 24) | vtxRGB);
+            } else {
+                unsigned int texColor = (texA << 24) | ((unsigned int)texel[0] << 16) | ((unsigned int)texel[1] << 8) | texel[2];
+                row[px] = alphaBlend(row[px], multiplyColors(texColor, vtxColor));
+            }
+        }
+    }
+    return true;
+}
+
+// Render a single triangle with texture (incremental edge functions, one row at a time)
 static void renderTriangle(
-    unsigned int* pixels, int fbWidth, int fbHeight,
+    unsigned int* pixels, int fbWidth,
     const ImDrawVert& v0, const ImDrawVert& v1, const ImDrawVert& v2,
-    const unsigned char* texture, int texWidth, int texHeight,
-    int clipMinX, int clipMinY, int clipMaxX, int clipMaxY)
+    const unsigned char* texture, int texWidth, int texHeight, const SWClip& clip)
 {
     // Get vertex positions
     float x0 = v0.pos.x, y0 = v0.pos.y;
     float x1 = v1.pos.x, y1 = v1.pos.y;
     float x2 = v2.pos.x, y2 = v2.pos.y;
     
-    // Compute bounding box
-    int minX = (int)std::floor(std::min({x0, x1, x2}));
-    int maxX = (int)std::ceil(std::max({x0, x1, x2}));
-    int minY = (int)std::floor(std::min({y0, y1, y2}));
-    int maxY = (int)std::ceil(std::max({y0, y1, y2}));
-    
-    // Clip to scissor rect
-    minX = std::max(minX, clipMinX);
-    maxX = std::min(maxX, clipMaxX);
-    minY = std::max(minY, clipMinY);
-    maxY = std::min(maxY, clipMaxY);
-    
-    // Clip to framebuffer
-    minX = std::max(minX, 0);
-    maxX = std::min(maxX, fbWidth - 1);
-    minY = std::max(minY, 0);
-    maxY = std::min(maxY, fbHeight - 1);
-    
-    // Compute edge equation constants
-    float dx01 = x0 - x1, dy01 = y0 - y1;
-    float dx12 = x1 - x2, dy12 = y1 - y2;
-    float dx20 = x2 - x0, dy20 = y2 - y0;
-    
     // Triangle area (2x)
-    float area = dx01 * (y2 - y0) - dy01 * (x2 - x0);
+    float area = (x0 - x1) * (y2 - y0) - (y0 - y1) * (x2 - x0);
     if (std::abs(area) < 0.001f) return; // Degenerate triangle
+    
+    // Compute bounding box, clipped to the scissor rect (already inside the framebuffer)
+    int minX = std::max((int)std::floor(std::min({x0, x1, x2})), clip.minX);
+    int maxX = std::min((int)std::ceil(std::max({x0, x1, x2})), clip.maxX);
+    int minY = std::max((int)std::floor(std::min({y0, y1, y2})), clip.minY);
+    int maxY = std::min((int)std::ceil(std::max({y0, y1, y2})), clip.maxY);
+    if (minX > maxX || minY > maxY) return;
+    
+    // Orient edges so inside is always >= 0, and pre-scale them into barycentrics
+    float sign = (area > 0) ? 1.0f : -1.0f;
     float invArea = 1.0f / area;
+    float e0dx = -(y1 - y2) * sign;
+    float e1dx = -(y2 - y0) * sign;
+    float e2dx = -(y0 - y1) * sign;
+    float fx = minX + 0.5f;
     
     // Get vertex colors
     unsigned int c0 = imguiColorToARGB(v0.col);
     unsigned int c1 = imguiColorToARGB(v1.col);
     unsigned int c2 = imguiColorToARGB(v2.col);
     
+    // Constant color and UV (solid fills, anti-aliasing fringes): one fetch for the whole triangle
+    bool flat = (c0 == c1 && c0 == c2 && v0.uv.x == v1.uv.x && v0.uv.x == v2.uv.x && v0.uv.y == v1.uv.y && v0.uv.y == v2.uv.y);
+    unsigned int flatColor = c0;
+    if (flat && texture) flatColor = multiplyColors(sampleTexture(texture, texWidth, texHeight, v0.uv.x, v0.uv.y), c0);
+    
+    // Per-channel vertex values for interpolation
+    float ch0[4], ch1[4], ch2[4];
+    for (int k = 0; k < 4; k++) {
+        ch0[k] = (float)((c0 >> (24 - 8 * k)) & 0xFF);
+        ch1[k] = (float)((c1 >> (24 - 8 * k)) & 0xFF);
+        ch2[k] = (float)((c2 >> (24 - 8 * k)) & 0xFF);
+    }
+    float s = sign * invArea;  // Edge value -> barycentric weight
+    
     // Rasterize
     for (int py = minY; py <= maxY; py++) {
-        for (int px = minX; px <= maxX; px++) {
-            float fx = px + 0.5f;
-            float fy = py + 0.5f;
-            
-            // Barycentric coordinates
-            float w0 = (x1 - x2) * (fy - y2) - (y1 - y2) * (fx - x2);
-            float w1 = (x2 - x0) * (fy - y0) - (y2 - y0) * (fx - x0);
-            float w2 = (x0 - x1) * (fy - y1) - (y0 - y1) * (fx - x1);
-            
+        unsigned int* row = pixels + py * fbWidth;
+        
+        // Row start is evaluated directly (not stepped from minY) so results do not depend
+        // on where the clip rect or render band starts
+        float fy = py + 0.5f;
+        float e0 = ((x1 - x2) * (fy - y2) - (y1 - y2) * (fx - x2)) * sign;
+        float e1 = ((x2 - x0) * (fy - y0) - (y2 - y0) * (fx - x0)) * sign;
+        float e2 = ((x0 - x1) * (fy - y1) - (y0 - y1) * (fx - x1)) * sign;
+        
+        for (int px = minX; px <= maxX; px++, e0 += e0dx, e1 += e1dx, e2 += e2dx) {
             // Check if inside triangle
-            bool inside = (area > 0) ? (w0 >= 0 && w1 >= 0 && w2 >= 0) : (w0 <= 0 && w1 <= 0 && w2 <= 0);
-            if (!inside) continue;
+            if (e0 < 0 || e1 < 0 || e2 < 0) continue;
             
-            // Normalize barycentric coords
-            w0 *= invArea;
-            w1 *= invArea;
-            w2 *= invArea;
+            if (flat) {
+                row[px] = alphaBlend(row[px], flatColor);
+                continue;
+            }
             
-            // Interpolate UV
-            float u = w0 * v0.uv.x + w1 * v1.uv.x + w2 * v2.uv.x;
-            float v = w0 * v0.uv.y + w1 * v1.uv.y + w2 * v2.uv.y;
+            // Barycentric coordinates
+            float w0 = e0 * s, w1 = e1 * s, w2 = e2 * s;
             
             // Interpolate color
-            unsigned int a = (unsigned int)(w0 * ((c0 >> 24) & 0xFF) + w1 * ((c1 >> 24) & 0xFF) + w2 * ((c2 >> 24) & 0xFF));
-            unsigned int r = (unsigned int)(w0 * ((c0 >> 16) & 0xFF) + w1 * ((c1 >> 16) & 0xFF) + w2 * ((c2 >> 16) & 0xFF));
-            unsigned int g = (unsigned int)(w0 * ((c0 >> 8) & 0xFF) + w1 * ((c1 >> 8) & 0xFF) + w2 * ((c2 >> 8) & 0xFF));
-            unsigned int b = (unsigned int)(w0 * (c0 & 0xFF) + w1 * (c1 & 0xFF) + w2 * (c2 & 0xFF));
+            unsigned int a = (unsigned int)(w0 * ch0[0] + w1 * ch1[0] + w2 * ch2[0]);
+            unsigned int r = (unsigned int)(w0 * ch0[1] + w1 * ch1[1] + w2 * ch2[1]);
+            unsigned int g = (unsigned int)(w0 * ch0[2] + w1 * ch1[2] + w2 * ch2[2]);
+            unsigned int b = (unsigned int)(w0 * ch0[3] + w1 * ch1[3] + w2 * ch2[3]);
             unsigned int vtxColor = (a << 24) | (r << 16) | (g << 8) | b;
             
-            // Sample texture
-            unsigned int texColor = 0xFFFFFFFF;
+            // Sample texture and multiply with vertex color
+            unsigned int srcColor = vtxColor;
             if (texture) {
-                texColor = sampleTexture(texture, texWidth, texHeight, u, v);
+                float u = w0 * v0.uv.x + w1 * v1.uv.x + w2 * v2.uv.x;
+                float v = w0 * v0.uv.y + w1 * v1.uv.y + w2 * v2.uv.y;
+                srcColor = multiplyColors(sampleTexture(texture, texWidth, texHeight, u, v), vtxColor);
             }
             
-            // Multiply texture and vertex color
-            unsigned int srcColor = multiplyColors(texColor, vtxColor);
-            
             // Alpha blend to framebuffer
-            int idx = py * fbWidth + px;
-            pixels[idx] = alphaBlend(pixels[idx], srcColor);
+            row[px] = alphaBlend(row[px], srcColor);
         }
     }
 }
 
-void ImGui_ImplSW_RenderDrawData(ImDrawData* draw_data, unsigned int* pixels, int width, int height)
+// Rasterize one draw list, with every command's scissor rect further clipped to region
+static void renderDrawList(const ImDrawList* cmd_list, unsigned int* pixels, int width,
+                           const ImVec2& fbScale, const SWRect& region)
 {
-    if (!draw_data) return;
+    const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
+    const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
     
-    // Get framebuffer scale
-    float fbScaleX = draw_data->FramebufferScale.x;
-    float fbScaleY = draw_data->FramebufferScale.y;
-    
-    // Render each command list
-    for (int n = 0; n < draw_data->CmdListsCount; n++) {
-        const ImDrawList* cmd_list = draw_data->CmdLists[n];
-        const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
-        const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+        const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
         
-        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
-            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+        if (pcmd->UserCallback) {
+            pcmd->UserCallback(cmd_list, pcmd);
+            continue;
+        }
+        
+        // Get scissor rect, clamped to the region (which lies inside the framebuffer)
+        SWClip clip;
+        clip.minX = std::max((int)(pcmd->ClipRect.x * fbScale.x), region.minX);
+        clip.minY = std::max((int)(pcmd->ClipRect.y * fbScale.y), region.minY);
+        clip.maxX = std::min((int)(pcmd->ClipRect.z * fbScale.x), region.maxX);
+        clip.maxY = std::min((int)(pcmd->ClipRect.w * fbScale.y), region.maxY);
+        
+        if (clip.minX >= clip.maxX || clip.minY >= clip.maxY)
+            continue;
+        
+        // Get texture
+        const unsigned char* texture = (const unsigned char*)pcmd->GetTexID();
+        int texWidth = g_FontTextureWidth;
+        int texHeight = g_FontTextureHeight;
+        
+        // Render triangles, taking quads (0,1,2 + 0,2,3) through the rect fast path
+        const ImDrawIdx* idx = idx_buffer + pcmd->IdxOffset;
+        for (unsigned int i = 0; i < pcmd->ElemCount; i += 3) {
+            const ImDrawVert& v0 = vtx_buffer[idx[i + 0] + pcmd->VtxOffset];
+            const ImDrawVert& v1 = vtx_buffer[idx[i + 1] + pcmd->VtxOffset];
+            const ImDrawVert& v2 = vtx_buffer[idx[i + 2] + pcmd->VtxOffset];
             
-            if (pcmd->UserCallback) {
-                pcmd->UserCallback(cmd_list, pcmd);
-                continue;
+            if (i + 6 <= pcmd->ElemCount && idx[i + 3] == idx[i] && idx[i + 4] == idx[i + 2]) {
+                const ImDrawVert& v3 = vtx_buffer[idx[i + 5] + pcmd->VtxOffset];
+                if (renderRect(pixels, width, v0, v1, v2, v3, texture, texWidth, texHeight, clip)) {
+                    i += 3;
+                    continue;
+                }
             }
             
-            // Get scissor rect
-            int clipMinX = (int)(pcmd->ClipRect.x * fbScaleX);
-            int clipMinY = (int)(pcmd->ClipRect.y * fbScaleY);
-            int clipMaxX = (int)(pcmd->ClipRect.z * fbScaleX);
-            int clipMaxY = (int)(pcmd->ClipRect.w * fbScaleY);
+            renderTriangle(pixels, width, v0, v1, v2, texture, texWidth, texHeight, clip);
+        }
+    }
+}
+
+// Hash a byte range 8 bytes at a time (FNV-style mixing)
+static unsigned long long hashBytes(unsigned long long h, const void* data, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    while (size >= 8) {
+        unsigned long long k;
+        memcpy(&k, p, 8);
+        h = (h ^ k) * 0x100000001B3ULL;
+        h ^= h >> 29;
+        p += 8;
+        size -= 8;
+    }
+    while (size--) h = (h ^ *p++) * 0x100000001B3ULL;
+    return h;
+}
+
+// Hash a draw list and find the screen area it can touch (vertex bounds inside its scissor rects)
+static SWListState describeDrawList(const ImDrawList* cmd_list, const ImVec2& fbScale, int width, int height)
+{
+    SWListState state;
+    state.hash = 0xCBF29CE484222325ULL;
+    state.hash = hashBytes(state.hash, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+    state.hash = hashBytes(state.hash, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+    
+    float vMinX = 1e30f, vMinY = 1e30f, vMaxX = -1e30f, vMaxY = -1e30f;
+    for (int i = 0; i < cmd_list->VtxBuffer.Size; i++) {
+        const ImVec2& p = cmd_list->VtxBuffer.Data[i].pos;
+        vMinX = std::min(vMinX, p.x); vMaxX = std::max(vMaxX, p.x);
+        vMinY = std::min(vMinY, p.y); vMaxY = std::max(vMaxY, p.y);
+    }
+    
+    float cMinX = 1e30f, cMinY = 1e30f, cMaxX = -1e30f, cMaxY = -1e30f;
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+        const ImDrawCmd& cmd = cmd_list->CmdBuffer[cmd_i];
+        state.hash = hashBytes(state.hash, &cmd.ClipRect, sizeof(cmd.ClipRect));
+        ImTextureID tex = cmd.GetTexID();
+        state.hash = hashBytes(state.hash, &tex, sizeof(tex));
+        unsigned int ranges[3] = { cmd.VtxOffset, cmd.IdxOffset, cmd.ElemCount };
+        state.hash = hashBytes(state.hash, ranges, sizeof(ranges));
+        if (cmd.ElemCount == 0) continue;
+        cMinX = std::min(cMinX, cmd.ClipRect.x); cMaxX = std::max(cMaxX, cmd.ClipRect.z);
+        cMinY = std::min(cMinY, cmd.ClipRect.y); cMaxY = std::max(cMaxY, cmd.ClipRect.w);
+    }
+    
+    if (cmd_list->VtxBuffer.Size == 0 || cMinX > cMaxX) {
+        state.bounds.minX = state.bounds.minY = 0;
+        state.bounds.maxX = state.bounds.maxY = -1;
+        state.empty = true;
+        return state;
+    }
+    
+    // Triangle bounding boxes round outwards by a pixel, so pad the vertex bounds too
+    state.bounds.minX = std::max((int)(std::max(vMinX, cMinX) * fbScale.x) - 1, 0);
+    state.bounds.minY = std::max((int)(std::max(vMinY, cMinY) * fbScale.y) - 1, 0);
+    state.bounds.maxX = std::min((int)(std::min(vMaxX, cMaxX) * fbScale.x) + 1, width - 1);
+    state.bounds.maxY = std::min((int)(std::min(vMaxY, cMaxY) * fbScale.y) + 1, height - 1);
+    state.empty = (state.bounds.minX > state.bounds.maxX || state.bounds.minY > state.bounds.maxY);
+    return state;
+}
+
+static bool rectsOverlap(const SWRect& a, const SWRect& b)
+{
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+static SWRect rectUnion(const SWRect& a, const SWRect& b)
+{
+    SWRect r = { std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY) };
+    return r;
+}
+
+// Add a dirty rect, merging it with any it overlaps so regions are never rendered twice
+static void addDirtyRect(std::vector<SWRect>& dirty, SWRect rect)
+{
+    const size_t MAX_DIRTY_RECTS = 16;
+    
+    for (size_t i = 0; i < dirty.size(); ) {
+        if (rectsOverlap(dirty[i], rect)) {
+            rect = rectUnion(rect, dirty[i]);
+            dirty.erase(dirty.begin() + i);
+            i = 0;  // The grown rect may now overlap earlier ones
+        } else {
+            i++;
+        }
+    }
+    dirty.push_back(rect);
+    
+    if (dirty.size() > MAX_DIRTY_RECTS) {
+        for (size_t i = 1; i < dirty.size(); i++) dirty[0] = rectUnion(dirty[0], dirty[i]);
+        dirty.resize(1);
+    }
+}
+
+// Rounded x / 255 (composite only; identical in the SIMD and scalar paths)
+static inline unsigned int div255Round(unsigned int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Draw the premultiplied layer over the framebuffer: dst = layer + dst * (1 - layerAlpha)
+static void compositeLayer(unsigned int* pixels, int width, const SWRect& area)
+{
+    for (int y = area.minY; y <= area.maxY; y++) {
+        const unsigned int* src = g_Layer.data() + (size_t)y * width;
+        unsigned int* dst = pixels + (size_t)y * width;
+        int x = area.minX;
+        
+#ifdef IMGUI_SW_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c255 = _mm_set1_epi16(255);
+        const __m128i c128 = _mm_set1_epi16(128);
+        for (; x + 4 <= area.maxX + 1; x += 4) {
+            __m128i l = _mm_loadu_si128((const __m128i*)(src + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(l, zero)) == 0xFFFF) continue;  // Nothing drawn here
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
             
-            // Clamp to screen
-            clipMinX = std::max(clipMinX, 0);
-            clipMinY = std::max(clipMinY, 0);
-            clipMaxX = std::min(clipMaxX, width);
-            clipMaxY = std::min(clipMaxY, height);
+            __m128i lLo = _mm_unpacklo_epi8(l, zero), lHi = _mm_unpackhi_epi8(l, zero);
+            __m128i dLo = _mm_unpacklo_epi8(d, zero), dHi = _mm_unpackhi_epi8(d, zero);
             
-            if (clipMinX >= clipMaxX || clipMinY >= clipMaxY)
-                continue;
+            // Broadcast each pixel's alpha (16-bit lane 3) across its four channels
+            __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lLo, 0xFF), 0xFF);
+            __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lHi, 0xFF), 0xFF);
             
-            // Get texture
-            const unsigned char* texture = (const unsigned char*)pcmd->GetTexID();
-            int texWidth = g_FontTextureWidth;
-            int texHeight = g_FontTextureHeight;
+            __m128i tLo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(c255, aLo)), c128);
+            __m128i tHi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(c255, aHi)), c128);
+            tLo = _mm_srli_epi16(_mm_add_epi16(tLo, _mm_srli_epi16(tLo, 8)), 8);
+            tHi = _mm_srli_epi16(_mm_add_epi16(tHi, _mm_srli_epi16(tHi, 8)), 8);
             
-            // Render triangles
-            for (unsigned int i = 0; i < pcmd->ElemCount; i += 3) {
-                unsigned int idx0 = idx_buffer[pcmd->IdxOffset + i + 0] + pcmd->VtxOffset;
-                unsigned int idx1 = idx_buffer[pcmd->IdxOffset + i + 1] + pcmd->VtxOffset;
-                unsigned int idx2 = idx_buffer[pcmd->IdxOffset + i + 2] + pcmd->VtxOffset;
-                
-                renderTriangle(pixels, width, height,
-                    vtx_buffer[idx0], vtx_buffer[idx1], vtx_buffer[idx2],
-                    texture, texWidth, texHeight,
-                    clipMinX, clipMinY, clipMaxX, clipMaxY);
+            __m128i out = _mm_packus_epi16(_mm_add_epi16(tLo, lLo), _mm_add_epi16(tHi, lHi));
+            _mm_storeu_si128((__m128i*)(dst + x), out);
+        }
+#endif
+        
+        for (; x <= area.maxX; x++) {
+            unsigned int l = src[x];
+            if (l == 0) continue;
+            unsigned int d = dst[x];
+            unsigned int invA = 255 - (l >> 24);
+            dst[x] = (((l >> 24) + div255Round((d >> 24) * invA)) << 24) |
+                     ((((l >> 16) & 0xFF) + div255Round(((d >> 16) & 0xFF) * invA)) << 16) |
+                     ((((l >> 8) & 0xFF) + div255Round(((d >> 8) & 0xFF) * invA)) << 8) |
+                     ((l & 0xFF) + div255Round((d & 0xFF) * invA));
+        }
+    }
+}
+
+// Split a region into horizontal bands and run fn(band) for each, in parallel when worthwhile
+template<class Fn>
+static void forEachBand(const SWRect& region, bool parallel, Fn fn)
+{
+    int rows = region.maxY - region.minY + 1;
+    int bandCount = 1;
+    if (parallel && g_Multithreaded) {
+        bandCount = std::min(g_ThreadPool.getThreadCount() * 4, rows / MIN_BAND_ROWS);
+    }
+    
+    if (bandCount <= 1) {
+        fn(region);
+        return;
+    }
+    
+    g_ThreadPool.parallelFor(bandCount, [&](int b) {
+        SWRect band = region;
+        band.minY = region.minY + rows * b / bandCount;
+        band.maxY = region.minY + rows * (b + 1) / bandCount - 1;
+        fn(band);
+    });
+}
+
+void ImGui_ImplSW_RenderDrawData(ImDrawData* draw_data, unsigned int* pixels, int width, int height)
+{
+    if (!draw_data || width <= 0 || height <= 0) return;
+    PROFILE_SCOPE("ImGui_ImplSW_RenderDrawData");
+    
+    ImVec2 fbScale = draw_data->FramebufferScale;
+    SWRect screen = { 0, 0, width - 1, height - 1 };
+    
+    // User callbacks may draw straight into the framebuffer, so they bypass the layer
+    bool hasCallbacks = false;
+    for (int n = 0; n < draw_data->CmdListsCount && !hasCallbacks; n++) {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+            if (cmd_list->CmdBuffer[cmd_i].UserCallback) { hasCallbacks = true; break; }
+        }
+    }
+    bool retained = g_RetainedLayer && !hasCallbacks;
+    
+    if (!retained) {
+        // Callbacks must run exactly once, so any callback keeps the frame on one thread
+        forEachBand(screen, !hasCallbacks, [&](const SWRect& band) {
+            for (int n = 0; n < draw_data->CmdListsCount; n++) {
+                renderDrawList(draw_data->CmdLists[n], pixels, width, fbScale, band);
             }
+        });
+        g_LayerValid = false;
+        g_LastDirtyPixels = width * height;
+        return;
+    }
+    
+    if (g_LayerWidth != width || g_LayerHeight != height) {
+        g_Layer.assign((size_t)width * height, 0u);
+        g_LayerWidth = width;
+        g_LayerHeight = height;
+        g_LayerValid = false;
+    }
+    
+    // Compare every draw list with last frame's; changed ones dirty both their old and new area
+    std::vector<SWListState> lists(draw_data->CmdListsCount);
+    std::vector<SWRect> dirty;
+    SWRect layerArea = { width, height, -1, -1 };
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        lists[n] = describeDrawList(draw_data->CmdLists[n], fbScale, width, height);
+        if (!lists[n].empty) layerArea = rectUnion(layerArea, lists[n].bounds);
+    }
+    
+    if (!g_LayerValid) {
+        dirty.push_back(screen);
+    } else {
+        size_t count = std::max(lists.size(), g_LayerLists.size());
+        for (size_t n = 0; n < count; n++) {
+            const SWListState* cur = (n < lists.size()) ? &lists[n] : nullptr;
+            const SWListState* old = (n < g_LayerLists.size()) ? &g_LayerLists[n] : nullptr;
+            if (cur && old && cur->hash == old->hash) continue;
+            if (old && !old->empty) addDirtyRect(dirty, old->bounds);
+            if (cur && !cur->empty) addDirtyRect(dirty, cur->bounds);
         }
     }
+    
+    // Clear and re-rasterize only the dirty regions (every list, clipped to the region)
+    g_LastDirtyPixels = 0;
+    for (size_t r = 0; r < dirty.size(); r++) {
+        const SWRect& rect = dirty[r];
+        forEachBand(rect, true, [&](const SWRect& band) {
+            for (int y = band.minY; y <= band.maxY; y++) {
+                std::fill(g_Layer.begin() + (size_t)y * width + band.minX, g_Layer.begin() + (size_t)y * width + band.maxX + 1, 0u);
+            }
+            for (int n = 0; n < draw_data->CmdListsCount; n++) {
+                if (!lists[n].empty && rectsOverlap(lists[n].bounds, band)) {
+                    renderDrawList(draw_data->CmdLists[n], g_Layer.data(), width, fbScale, band);
+                }
+            }
+        });
+        g_LastDirtyPixels += (rect.maxX - rect.minX + 1) * (rect.maxY - rect.minY + 1);
+    }
+    g_LayerLists.swap(lists);
+    g_LayerValid = true;
+    
+    if (layerArea.minX <= layerArea.maxX && layerArea.minY <= layerArea.maxY) {
+        forEachBand(layerArea, true, [&](const SWRect& band) {
+            compositeLayer(pixels, width, band);
+        });
+    }
 }
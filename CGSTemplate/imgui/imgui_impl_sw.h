@@ -17,3 +17,17 @@ void ImGui_ImplSW_CreateFontsTexture();
 // pixels: ARGB format uint32_t array
 // width, height: dimensions of the pixel buffer
 void ImGui_ImplSW_RenderDrawData(ImDrawData* draw_data, unsigned int* pixels, int width, int height);
+
+// Retained UI layer (on by default): the UI is kept in a cached premultiplied layer and
+// only draw lists whose vertex/index/command data changed are re-rasterized each frame.
+// The layer is then composited over the pixel buffer.
+void ImGui_ImplSW_SetRetainedLayer(bool enabled);
+
+// Force a full re-rasterization on the next frame (e.g. after changing a texture in place)
+void ImGui_ImplSW_InvalidateLayer();
+
+// Pixels re-rasterized by the last ImGui_ImplSW_RenderDrawData call
+int ImGui_ImplSW_GetLastDirtyPixels();
+
+// Render in horizontal bands on g_ThreadPool (on by default; output matches single-threaded)
+void ImGui_ImplSW_SetMultithreaded(bool enabled);
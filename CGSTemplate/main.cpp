@@ -2,13 +2,44 @@
 #include "RasterHelper.h"
 #include "RasterSurface.h"
 #include "XTime.h"
+#include "GLCompute.h"
 #include "celestial.h"
+#include "Profiler.h"
+#include "PerfHud.h"
+#include "GameLoop.h"
+#include "Benchmark.h"
+#include "Fxaa.h"
+#include "DynamicResolution.h"
+#include <cstring>
 
-int main() {
+// Flip `flag` on the frame `key` goes down (`latch` remembers the previous state).
+// GetAsyncKeyState sees keys pressed in any window, so only the focused window reacts.
+static void toggleOnPress(int key, bool& latch, bool& flag) {
+    bool down = GetForegroundWindow() == (HWND)RS_GetWindowHandle() && (GetAsyncKeyState(key) & 0x8000) != 0;
+    if (down && !latch) flag = !flag;
+    latch = down;
+}
+
+int main(int argc, char** argv) {
+    PROFILE_THREAD_NAME("Main");
+    
+    // Allocate the screen/depth buffers at desktop resolution (the present buffer; the
+    // 3D pass may render below it, see DynamicResolution.h)
+    InitScreenBuffers();
+    
+    // "--bench" runs the scene benchmarks and exits without opening a window
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return game::RunBenchmarks();
+    }
+    
     // Set up the timer
     XTime timer(10, 0.75);
     timer.Restart();
 
+    // Simulation runs at a fixed 60 Hz; frames are paced to 120 Hz
+    FixedTimestep fixedStep(1.0 / 60.0);
+    FrameLimiter limiter(120.0);
+
     // Initialize transformation matrices
     matrix4x4 cube = MatrixIdentity();
     matrix4x4 grid = MatrixIdentity();
@@ -36,74 +67,209 @@ int main() {
 
     // Initialize the raster surface
     RS_Initialize("Ryan Curphey", RASTER_WIDTH, RASTER_HEIGHT);
+    
+    // Performance overlay
+    game::g_PerfHud.init();
+    game::g_PerfHud.setFrameLimiter(&limiter);
+    g_RenderStats.textureBytes = (uint64_t)celestial_width * celestial_height * sizeof(unsigned int);
+
+    // Debug toggles, one function key each
+    bool overdrawView = false;
+    bool gpuRaster = false;         // Grid and cube through the compute-shader rasterizer
+    bool gpuAsyncReadback = true;   // Present GPU pixels one frame late instead of stalling
+    struct KeyToggle {
+        int key;
+        bool* flag;
+        bool latch;
+    };
+    KeyToggle toggles[] = {
+        { VK_F2, &overdrawView, false },                 // Overdraw heatmap (per-pixel depth complexity)
+        { VK_F3, &g_DepthPrepass, false },               // Depth pre-pass
+        { VK_F4, &g_VisibilityBufferMode, false },       // Visibility buffer
+        { VK_F5, &g_SmoothLighting, false },             // Smooth (per-vertex) lighting
+        { VK_F6, &g_MsaaMode, false },                   // 4x MSAA
+        { VK_F7, &g_FxaaEnabled, false },                // FXAA post pass
+        { VK_F8, &g_DynamicResolutionEnabled, false },   // Dynamic resolution
+        { VK_F9, &g_DynamicResolutionSharpen, false },   // Sharpening of the upscaled scene
+        { VK_F10, &gpuRaster, false },                   // GPU rasterizer (GLCompute.h)
+        { VK_F11, &gpuAsyncReadback, false },            // GPU readback latency 1 or 0
+    };
+    std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
 
-    float timeElapsed = 0;
-    cube.wy += 0.25;
+    // Cube spin (degrees), simulated per fixed step and interpolated for rendering
+    const float cubeSpinSpeed = 0.9f;  // Degrees per second
+    float cubeAngle = 0.0f;
+    float prevCubeAngle = 0.0f;
+    matrix4x4 cubeBase = MatrixIdentity();
+    cubeBase.wy += 0.25;
 
     do {
+        PROFILE_SCOPE("Frame");
+        g_RenderStats.beginFrame();
+        
+        // Fixed-step simulation
+        timer.Signal();
+        for (int step = fixedStep.advance(timer.Delta()); step > 0; step--) {
+            prevCubeAngle = cubeAngle;
+            cubeAngle += cubeSpinSpeed * (float)fixedStep.getStep();
+        }
+        float alpha = fixedStep.getAlpha();
+        
+        for (KeyToggle& toggle : toggles) {
+            toggleOnPress(toggle.key, toggle.latch, *toggle.flag);
+        }
+        EnableOverdrawCounters(overdrawView);  // Allocates or frees only when F2 changed it
+        
+        // The GPU context is created the first time F10 is pressed
+        if (gpuRaster && !g_GLCompute.isInitialized()) {
+            gpuRaster = GPU_Init();
+            if (!gpuRaster) std::cerr << "GPU rasterizer unavailable, staying on the CPU\n";
+        }
+        if (gpuRaster && g_GLCompute.getReadbackLatency() != (gpuAsyncReadback ? 1 : 0)) {
+            g_GLCompute.setReadbackLatency(gpuAsyncReadback ? 1 : 0);
+        }
+        g_RenderStats.gpuReadbackLatency = gpuRaster ? g_GLCompute.getReadbackLatency() : -1;
+        
+        // The 3D pass renders at the dynamic resolution, up to the HUD (the GPU rasterizer
+        // always fills the native buffer)
+        if (!gpuRaster) g_DynamicResolution.beginScene();
+        if (gpuRaster) GPU_BeginFrame();
+        
         // Clear the color buffer to space (stars)
-        clearColorBuffer(0xFF000000);
+        {
+            StageTimer stage("Clear");
+            clearColorBuffer(0xFF000000);
+        }
+        {
+            StageTimer stage("Grid");
 
-        // Set the PixelShader for cyan holographic grid
-        PixelShader = nullptr; // Use the vertex color directly
+            // Set the PixelShader for cyan holographic grid
+            PixelShader = nullptr; // Use the vertex color directly
 
-        // Draw the grid lines with cyan sci-fi color
-        SV_WorldMatrix = grid;
-        // Note: drawLine now handles transformations internally with proper clipping
+            // Draw the grid lines with cyan sci-fi color
+            SV_WorldMatrix = grid;
+            // Note: drawLine now handles transformations internally with proper clipping
 
-        unsigned int gridColor = 0xFF00FFFF; // Cyan
-        unsigned int gridColorDim = 0xFF008888; // Dimmer cyan for alternating
+            unsigned int gridColor = 0xFF00FFFF; // Cyan
+            unsigned int gridColorDim = 0xFF008888; // Dimmer cyan for alternating
         
-        // Large grid for 3D engine - extends well beyond camera view
-        float gridExtent = 5.0f;  // Large grid
-        int gridLines = 50;       // Many lines for detail
-        float gridStep = (gridExtent * 2.0f) / gridLines;
+            // Large grid for 3D engine - extends well beyond camera view
+            float gridExtent = 5.0f;  // Large grid
+            int gridLines = 50;       // Many lines for detail
+            float gridStep = (gridExtent * 2.0f) / gridLines;
+            
+            auto gridLine = [&](const vertex& start, const vertex& end, unsigned int color) {
+                vertex screenStart, screenEnd;
+                if (!gpuRaster) {
+                    drawLine(start, end, color);
+                } else if (projectLine(start, end, screenStart, screenEnd)) {
+                    GPU_AddLine(screenStart, screenEnd, color);
+                }
+            };
         
-        // Draw horizontal lines (along X axis)
-        for (int i = 0; i <= gridLines; i++) {
-            float z = -gridExtent + gridStep * i;
-            unsigned int lineColor = (i % 5 == 0) ? gridColor : gridColorDim; // Every 5th line brighter
-            vertex lineStart({ -gridExtent, 0.0f, z, 1.0f }, lineColor);
-            vertex lineEnd({ gridExtent, 0.0f, z, 1.0f }, lineColor);
-            drawLine(lineStart, lineEnd, lineColor);
-        }
+            // Draw horizontal lines (along X axis)
+            for (int i = 0; i <= gridLines; i++) {
+                float z = -gridExtent + gridStep * i;
+                unsigned int lineColor = (i % 5 == 0) ? gridColor : gridColorDim; // Every 5th line brighter
+                vertex lineStart({ -gridExtent, 0.0f, z, 1.0f }, lineColor);
+                vertex lineEnd({ gridExtent, 0.0f, z, 1.0f }, lineColor);
+                gridLine(lineStart, lineEnd, lineColor);
+            }
         
-        // Draw vertical lines (along Z axis)
-        for (int i = 0; i <= gridLines; i++) {
-            float x = -gridExtent + gridStep * i;
-            unsigned int lineColor = (i % 5 == 0) ? gridColor : gridColorDim; // Every 5th line brighter
-            vertex lineStart({ x, 0.0f, -gridExtent, 1.0f }, lineColor);
-            vertex lineEnd({ x, 0.0f, gridExtent, 1.0f }, lineColor);
-            drawLine(lineStart, lineEnd, lineColor);
+            // Draw vertical lines (along Z axis)
+            for (int i = 0; i <= gridLines; i++) {
+                float x = -gridExtent + gridStep * i;
+                unsigned int lineColor = (i % 5 == 0) ? gridColor : gridColorDim; // Every 5th line brighter
+                vertex lineStart({ x, 0.0f, -gridExtent, 1.0f }, lineColor);
+                vertex lineEnd({ x, 0.0f, gridExtent, 1.0f }, lineColor);
+                gridLine(lineStart, lineEnd, lineColor);
+            }
         }
 
-        // Set the world matrix for the cube
-        SV_WorldMatrix = cube;
+        {
+            StageTimer stage("Cube");
 
-        // Update the cube rotation based on the timer
-        timer.Signal();
-        timeElapsed += timer.Delta();
-        if (timeElapsed > 0.03f) {
-            timeElapsed = 0;
-            cube = matrixRotationY(cube, 0.027f);
+            // Set the world matrix for the cube (interpolated between the last two steps)
+            cube = matrixRotationY(cubeBase, prevCubeAngle + (cubeAngle - prevCubeAngle) * alpha);
+            SV_WorldMatrix = cube;
+
+            // Draw the cube triangles with texture (queued in screen space for the GPU)
+            auto cubeTriangle = [&](vertex& v0, vertex& v1, vertex& v2) {
+                if (!gpuRaster) {
+                    DrawTriangle(v0, v1, v2, celestial_pixels, celestial_width, celestial_height);
+                    return;
+                }
+                vec4 world;
+                vertex s0, s1, s2;
+                transformCorner(v0, world, s0);
+                transformCorner(v1, world, s1);
+                transformCorner(v2, world, s2);
+                GPU_AddTexturedTriangle(s0, s1, s2);
+            };
+            auto drawCube = [&]() {
+                cubeTriangle(topLeftFrontVert, topRightFrontVert, topRightBackVert); // Front
+                cubeTriangle(topLeftFrontVert, topRightBackVert, topLeftBackVert); // Front
+                cubeTriangle(botLeftFrontVert, botRightFrontVert, botRightBackVert); // Back
+                cubeTriangle(botLeftFrontVert, botRightBackVert, botLeftBackVert); // Back
+                cubeTriangle(topLeftFrontVert, botLeftFrontVert, botRightFrontVert); // Top
+                cubeTriangle(topLeftFrontVert, botRightFrontVert, topRightFrontVert); // Top
+                cubeTriangle(topLeftBackVert, botLeftBackVert, botRightBackVert); // Bottom
+                cubeTriangle(topLeftBackVert, botRightBackVert, topRightBackVert); // Bottom
+                cubeTriangle(topLeftFrontVert, botLeftFrontVert, botLeftBackVert); // Left
+                cubeTriangle(topLeftFrontVert, botLeftBackVert, topLeftBackVert); // Left
+                cubeTriangle(topRightFrontVert, botRightFrontVert, botRightBackVert); // Right
+                cubeTriangle(topRightFrontVert, botRightBackVert, topRightBackVert); // Right
+            };
+            if (gpuRaster) {
+                GPU_UploadTexture(celestial_pixels, celestial_width, celestial_height);
+                drawCube();
+            } else if (g_MsaaMode) {
+                DrawWithMsaa(drawCube);
+            } else if (g_VisibilityBufferMode) {
+                DrawWithVisibilityBuffer(drawCube);
+            } else {
+                DrawWithDepthPrepass(drawCube);
+            }
         }
 
-        // Draw the cube triangles with texture
-        DrawTriangle(topLeftFrontVert, topRightFrontVert, topRightBackVert, celestial_pixels, celestial_width, celestial_height); // Front
-        DrawTriangle(topLeftFrontVert, topRightBackVert, topLeftBackVert, celestial_pixels, celestial_width, celestial_height); // Front
-        DrawTriangle(botLeftFrontVert, botRightFrontVert, botRightBackVert, celestial_pixels, celestial_width, celestial_height); // Back
-        DrawTriangle(botLeftFrontVert, botRightBackVert, botLeftBackVert, celestial_pixels, celestial_width, celestial_height); // Back
-        DrawTriangle(topLeftFrontVert, botLeftFrontVert, botRightFrontVert, celestial_pixels, celestial_width, celestial_height); // Top
-        DrawTriangle(topLeftFrontVert, botRightFrontVert, topRightFrontVert, celestial_pixels, celestial_width, celestial_height); // Top
-        DrawTriangle(topLeftBackVert, botLeftBackVert, botRightBackVert, celestial_pixels, celestial_width, celestial_height); // Bottom
-        DrawTriangle(topLeftBackVert, botRightBackVert, topRightBackVert, celestial_pixels, celestial_width, celestial_height); // Bottom
-        DrawTriangle(topLeftFrontVert, botLeftFrontVert, botLeftBackVert, celestial_pixels, celestial_width, celestial_height); // Left
-        DrawTriangle(topLeftFrontVert, botLeftBackVert, topLeftBackVert, celestial_pixels, celestial_width, celestial_height); // Left
-        DrawTriangle(topRightFrontVert, botRightFrontVert, botRightBackVert, celestial_pixels, celestial_width, celestial_height); // Right
-        DrawTriangle(topRightFrontVert, botRightBackVert, topRightBackVert, celestial_pixels, celestial_width, celestial_height); // Right
+        // Rasterize the queued lines and triangles; with async readback this presents the
+        // previous frame's pixels instead of waiting for these
+        if (gpuRaster) {
+            StageTimer stage("GPU");
+            GPU_Dispatch(SCREEN_ARRAY);
+        }
+
+        if (g_FxaaEnabled) {
+            ApplyFxaa(SCREEN_ARRAY, RASTER_WIDTH, RASTER_HEIGHT);
+        }
 
+        if (overdrawView) {
+            DrawOverdrawHeatmap(SCREEN_ARRAY);
+        }
+
+        // Upscale into the present buffer
+        if (!gpuRaster) g_DynamicResolution.endScene();
+        
+        // Performance overlay (drawn last, over the scene, at native resolution)
+        {
+            StageTimer stage("HUD");
+            game::g_PerfHud.render(SCREEN_ARRAY, RASTER_WIDTH, RASTER_HEIGHT);
+        }
+        
+        // Next frame's scale from this frame's work: everything since the last release,
+        // including the previous present, but not the pacing wait
+        g_DynamicResolution.update(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        {
+            StageTimer stage("Pace");
+            limiter.wait();
+        }
+        frameStart = std::chrono::steady_clock::now();
+        game::g_PerfHud.endFrame();
     } while (RS_Update(SCREEN_ARRAY, NUM_PIXELS));
 
+    GPU_Shutdown();
+    game::g_PerfHud.shutdown();
     RS_Shutdown();
+    PROFILE_DUMP("profile_trace.json");
     return 0;
 }